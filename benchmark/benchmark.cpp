@@ -0,0 +1,308 @@
+#include <benchmark/benchmark.h>
+#include <vector>
+#include <string>
+#include "helper.h"
+#include "ladybug_stream.h"
+#include "protobuf_helper.h"
+#include "trace.h"
+#include "render_pipeline.h"
+
+/*
+* Microbenchmarks of the hot path kernels on synthetic Ladybug5 frames,
+* no camera or Ladybug context is needed.
+*/
+
+static const int CAMERA_COLS = 2448;        /* full resolution of one camera */
+static const int CAMERA_ROWS = 2048;
+static const int PANO_COLS = 4096;
+static const int PANO_ROWS = 2048;
+static const unsigned int JPEG_CHANNEL_SIZE = 300 * 1024; /* typical JPEG8 channel of a color separated frame */
+
+/* Deterministic image with gradients and noise, compresses like a real scene rather than a flat color */
+static std::vector<unsigned char> synthetic_image(int width, int height, int pixel_size){
+    std::vector<unsigned char> image(width * height * pixel_size);
+    unsigned int seed = 12345;
+    for(int y = 0; y < height; ++y){
+        for(int x = 0; x < width; ++x){
+            seed = seed * 1103515245 + 12345;
+            unsigned char noise = (seed >> 16) & 0x0f;
+            unsigned char* pixel = &image[(y * width + x) * pixel_size];
+            pixel[0] = (unsigned char)(x * 255 / width) + noise;
+            pixel[1] = (unsigned char)(y * 255 / height) + noise;
+            pixel[2] = (unsigned char)((x + y) / 16) + noise;
+            if(pixel_size == 4) pixel[3] = 255;
+        }
+    }
+    return image;
+}
+
+static unsigned int big_endian(unsigned int i){
+    return ((i & 0xff) << 24) | ((i & 0xff00) << 8) | ((i >> 8) & 0xff00) | (i >> 24);
+}
+
+/* LadybugImage in the layout of the camera, pData points into buffer */
+static void synthetic_ladybug_image(LadybugImage* image, std::vector<unsigned char>& buffer, LadybugDataFormat format){
+    memset(image, 0, sizeof(LadybugImage));
+    image->dataFormat = format;
+    image->stippledFormat = LADYBUG_BGGR;
+    image->uiFullCols = CAMERA_COLS;
+    image->uiFullRows = CAMERA_ROWS;
+    image->uiCols = CAMERA_COLS;
+    image->uiRows = CAMERA_ROWS;
+    image->imageInfo.ulSerialNum = 15140000;
+    image->imageHeader.accelerometer.x = 0.1f;
+    image->imageHeader.compass.y = 0.2f;
+    image->imageHeader.gyroscope.z = 0.3f;
+    image->imageHeader.uiTemperature = 300;
+    image->timeStamp.ulSeconds = 1400000000;
+    image->timeStamp.ulCycleSeconds = 42;
+
+    if(isColorSeparated(image)){
+        /* table of big endian offset and size of the 24 JPEG channels at 0x0340 */
+        unsigned int channels = getImageCount(image);
+        unsigned int header = 0x0340 + channels * 8;
+        buffer.assign(header + channels * JPEG_CHANNEL_SIZE, 0x55);
+        for(unsigned int i = 0; i < channels; ++i){
+            unsigned int offset = big_endian(header + i * JPEG_CHANNEL_SIZE);
+            unsigned int size = big_endian(JPEG_CHANNEL_SIZE);
+            memcpy(&buffer[0x0340 + i * 8], &offset, sizeof(offset));
+            memcpy(&buffer[0x0340 + i * 8 + 4], &size, sizeof(size));
+        }
+    }else{
+        buffer.assign(LADYBUG_NUM_CAMERAS * CAMERA_COLS * CAMERA_ROWS * getDataBitDepth(image) / 8, 0x55);
+    }
+    image->pData = &buffer[0];
+    image->uiDataSizeBytes = buffer.size();
+}
+
+/* Header of a processed frame: 6 BGRA cameras and the panorama */
+static void synthetic_header(ladybug5_network::pbMessage* message, LadybugImage& image){
+    prefill_sensordata(*message, image);
+    for(unsigned int camera = 0; camera < LADYBUG_NUM_CAMERAS; ++camera){
+        ladybug5_network::pbImage* image_msg = message->add_images();
+        image_msg->set_type((ladybug5_network::ImageType) (1 << camera));
+        image_msg->set_name(enumToString(image_msg->type()));
+        image_msg->set_width(CAMERA_COLS / 2);
+        image_msg->set_height(CAMERA_ROWS / 2);
+        image_msg->set_packages(1);
+        image_msg->set_bayer_encoding("BGRA8");
+    }
+    ladybug5_network::pbImage* pano = message->add_images();
+    pano->set_type(ladybug5_network::LADYBUG_PANORAMIC);
+    pano->set_name(enumToString(pano->type()));
+    pano->set_width(PANO_COLS);
+    pano->set_height(PANO_ROWS);
+    pano->set_packages(1);
+}
+
+//-----------------------------------------------
+// JPEG compression
+//-----------------------------------------------
+
+/* args: width, height, TJPF, quality */
+static void BM_compressBufferToZmqMsg(benchmark::State& state){
+    int width = state.range(0);
+    int height = state.range(1);
+    TJPF color = (TJPF)state.range(2);
+    int quality = state.range(3);
+    int pixel_size = tjPixelSize[color];
+    std::vector<unsigned char> image = synthetic_image(width, height, pixel_size);
+
+    size_t compressed = 0;
+    for(auto _ : state){
+        zmq::message_t msg = compressBufferToZmqMsg(&image[0], width, height, color, quality);
+        compressed = msg.size();
+        benchmark::DoNotOptimize(msg.data());
+    }
+    state.SetBytesProcessed(state.iterations() * image.size());
+    state.counters["ratio"] = (double)image.size() / compressed;
+}
+static void compression_args(benchmark::internal::Benchmark* b){
+    const int qualities[] = { 60, 85, 95 };
+    for(int q = 0; q < 3; ++q){
+        b->Args({ CAMERA_COLS / 2, CAMERA_ROWS / 2, TJPF_RGBA, qualities[q] }); // DOWNSAMPLE4 camera
+        b->Args({ CAMERA_COLS, CAMERA_ROWS, TJPF_RGBA, qualities[q] });         // full resolution camera
+        b->Args({ PANO_COLS, PANO_ROWS, TJPF_RGB, qualities[q] });              // panorama
+        b->Args({ PANO_COLS, PANO_ROWS, TJPF_BGR, qualities[q] });
+    }
+    b->ArgNames({ "width", "height", "tjpf", "quality" });
+}
+BENCHMARK(BM_compressBufferToZmqMsg)->Apply(compression_args)->Unit(benchmark::kMillisecond);
+
+/* The compressionThread path: image size from the header, quality 85 */
+static void BM_compressImageToZmqMsg(benchmark::State& state){
+    std::vector<unsigned char> buffer;
+    LadybugImage image;
+    synthetic_ladybug_image(&image, buffer, LADYBUG_DATAFORMAT_COLOR_SEP_JPEG8);
+    ladybug5_network::pbMessage message;
+    synthetic_header(&message, image);
+
+    std::vector<unsigned char> bgra = synthetic_image(CAMERA_COLS / 2, CAMERA_ROWS / 2, 4);
+    zmq::message_t raw(bgra.size());
+    memcpy(raw.data(), &bgra[0], bgra.size());
+
+    for(auto _ : state){
+        zmq::message_t msg = compressImageToZmqMsg(&message, &raw, 0, TJPF_RGBA);
+        benchmark::DoNotOptimize(msg.data());
+    }
+    state.SetBytesProcessed(state.iterations() * bgra.size());
+}
+BENCHMARK(BM_compressImageToZmqMsg)->Unit(benchmark::kMillisecond);
+
+//-----------------------------------------------
+// Channel extraction of the grabbed frame
+//-----------------------------------------------
+
+/* arg: LadybugDataFormat */
+static void BM_getImagePointer(benchmark::State& state){
+    std::vector<unsigned char> buffer;
+    LadybugImage image;
+    synthetic_ladybug_image(&image, buffer, (LadybugDataFormat)state.range(0));
+    unsigned int channels = isColorSeparated(&image) ? getImageCount(&image) : LADYBUG_NUM_CAMERAS;
+
+    for(auto _ : state){
+        for(unsigned int i = 0; i < channels; ++i){
+            unsigned int size;
+            benchmark::DoNotOptimize(getImagePointer(&image, i, size));
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * channels);
+}
+BENCHMARK(BM_getImagePointer)->Arg(LADYBUG_DATAFORMAT_COLOR_SEP_JPEG8)->Arg(LADYBUG_DATAFORMAT_RAW8);
+
+/* Extraction and the copy into the zmq message as in the direct send path, arg: LadybugDataFormat */
+static void BM_extractImageToMsg(benchmark::State& state){
+    std::vector<unsigned char> buffer;
+    LadybugImage image;
+    synthetic_ladybug_image(&image, buffer, (LadybugDataFormat)state.range(0));
+    unsigned int channels = isColorSeparated(&image) ? getImageCount(&image) : LADYBUG_NUM_CAMERAS;
+
+    size_t bytes = 0;
+    for(auto _ : state){
+        for(unsigned int i = 0; i < channels; ++i){
+            char* data = NULL;
+            unsigned int size;
+            extractImageToMsg(&image, i, &data, size);
+            zmq::message_t msg(size);
+            memcpy(msg.data(), data, size);
+            benchmark::DoNotOptimize(msg.data());
+            bytes += size;
+        }
+    }
+    state.SetBytesProcessed(bytes);
+}
+BENCHMARK(BM_extractImageToMsg)->Arg(LADYBUG_DATAFORMAT_COLOR_SEP_JPEG8)->Arg(LADYBUG_DATAFORMAT_RAW8);
+
+//-----------------------------------------------
+// Header serialization
+//-----------------------------------------------
+
+static void BM_prefill_sensordata(benchmark::State& state){
+    std::vector<unsigned char> buffer;
+    LadybugImage image;
+    synthetic_ladybug_image(&image, buffer, LADYBUG_DATAFORMAT_COLOR_SEP_JPEG8);
+    ladybug5_network::pbMessage message;
+
+    for(auto _ : state){
+        prefill_sensordata(message, image);
+        benchmark::DoNotOptimize(message.sensors().temperature());
+    }
+}
+BENCHMARK(BM_prefill_sensordata);
+
+/* pb_send and pb_recv of the frame header with calibration hash and trace over inproc */
+static void BM_pb_send_recv(benchmark::State& state){
+    std::vector<unsigned char> buffer;
+    LadybugImage image;
+    synthetic_ladybug_image(&image, buffer, LADYBUG_DATAFORMAT_COLOR_SEP_JPEG8);
+    ladybug5_network::pbMessage message;
+    synthetic_header(&message, image);
+    ladybug5_network::pbMessageExtension extension;
+    extension.set_calibration_hash(0x0123456789abcdefULL);
+    trace_stage(extension.mutable_trace(), ladybug5_network::TRACE_GRAB);
+    trace_stage(extension.mutable_trace(), ladybug5_network::TRACE_CONVERT);
+
+    zmq::context_t context(1);
+    zmq::socket_t out(context, ZMQ_PAIR);
+    zmq::socket_t in(context, ZMQ_PAIR);
+    out.bind("inproc://benchmark_header");
+    in.connect("inproc://benchmark_header");
+
+    ladybug5_network::pbMessage received;
+    for(auto _ : state){
+        pb_send(&out, &message, &extension);
+        pb_recv(&in, &received);
+        benchmark::DoNotOptimize(received.images_size());
+    }
+    state.counters["bytes"] = message.ByteSize() + extension.ByteSize();
+}
+BENCHMARK(BM_pb_send_recv);
+
+//-----------------------------------------------
+// Transport of a processed frame: 6x BGRA multipart
+//-----------------------------------------------
+
+/* arg: 0 inproc, 1 tcp over loopback */
+static void BM_multipart_6xBGRA(benchmark::State& state){
+    bool tcp = state.range(0) == 1;
+    unsigned int size = (CAMERA_COLS / 2) * (CAMERA_ROWS / 2) * 4;
+    std::vector<unsigned char> bgra = synthetic_image(CAMERA_COLS / 2, CAMERA_ROWS / 2, 4);
+
+    zmq::context_t context(1);
+    zmq::socket_t out(context, ZMQ_PUSH);
+    zmq::socket_t in(context, ZMQ_PULL);
+    int val = 6; // same buffer as the capture loop
+    out.setsockopt(ZMQ_SNDHWM, &val, sizeof(val));
+    in.setsockopt(ZMQ_RCVHWM, &val, sizeof(val));
+    const char* endpoint = tcp ? "tcp://127.0.0.1:28899" : "inproc://benchmark_frames";
+    out.bind(endpoint);
+    in.connect(endpoint);
+
+    int more;
+    size_t more_size = sizeof(more);
+    for(auto _ : state){
+        for(unsigned int camera = 0; camera < LADYBUG_NUM_CAMERAS; ++camera){
+            zmq::message_t part(size);
+            memcpy(part.data(), &bgra[0], size);
+            out.send(part, camera == LADYBUG_NUM_CAMERAS - 1 ? 0 : ZMQ_SNDMORE);
+        }
+        do{
+            zmq::message_t part;
+            in.recv(&part);
+            in.getsockopt(ZMQ_RCVMORE, &more, &more_size);
+        }while(more);
+    }
+    state.SetBytesProcessed(state.iterations() * size * LADYBUG_NUM_CAMERAS);
+}
+BENCHMARK(BM_multipart_6xBGRA)->Arg(0)->Arg(1)->ArgName("tcp")->Unit(benchmark::kMillisecond);
+
+//-----------------------------------------------
+// Panoramic rendering with the mock backend (no graphics card)
+//-----------------------------------------------
+
+/* arg: pipeline depth, 1 converts, renders and encodes each frame in turn */
+static void BM_RenderPipeline(benchmark::State& state){
+    unsigned int depth = (unsigned int)state.range(0);
+    unsigned int plane_size = (CAMERA_COLS / 2) * (CAMERA_ROWS / 2) * 4;
+    MockRenderBackend backend(1024, 512, plane_size);
+    std::vector<unsigned char> buffer;
+    LadybugImage image;
+    synthetic_ladybug_image(&image, buffer, LADYBUG_DATAFORMAT_COLOR_SEP_JPEG8);
+    ladybug5_network::pbMessage message;
+    synthetic_header(&message, image);
+
+    ladybug5_network::pbMessage finished_message;
+    zmq::message_t finished_pano;
+    LadybugError error;
+    RenderPipeline pipeline(&backend, plane_size, depth, true);
+    for(auto _ : state){
+        while(pipeline.finished(&finished_message, &finished_pano, &error, pipeline.full() ? -1 : 0)){
+            benchmark::DoNotOptimize(finished_pano.size());
+        }
+        pipeline.submit(&image, message);
+    }
+    while(pipeline.finished(&finished_message, &finished_pano, &error, 100)){} // the frames in flight
+}
+BENCHMARK(BM_RenderPipeline)->Arg(1)->Arg(3)->ArgName("depth")->Unit(benchmark::kMillisecond)->UseRealTime();
+
+BENCHMARK_MAIN();
@@ -144,7 +144,8 @@ void main( int argc, char* argv[] )
 {
     SetThreadExecutionState(ES_CONTINUOUS | ES_SYSTEM_REQUIRED | ES_AWAYMODE_REQUIRED);
     std::string status = "Init";
-    double t_now = clock();
+    double t_now = monotonic_us();
+    Metrics::enabled = true; // timing summary at the end
 
     initConfig(argc, argv);
     std::cout << std::endl << "Number of Cores: " << boost::thread::hardware_concurrency() << std::endl;  
@@ -168,7 +169,7 @@ void main( int argc, char* argv[] )
     double t_loopstart = t_now;
 
     for(unsigned int camera = 5; camera < LADYBUG_NUM_CAMERAS; ++camera){
-        double t_current_loop = clock();
+        double t_current_loop = monotonic_us();
         error = lady.getCameraCalibration(camera, &calibration);
         std::cout << "Camera: " << camera << std::endl;
 
@@ -260,6 +261,8 @@ void main( int argc, char* argv[] )
     }
     status = "Total time in loop";
     t_now=t_loopstart;
+    _TIME
+    Metrics::instance().snapshot().print();
     cv::waitKey();
 	return;
 }
@@ -143,7 +143,8 @@ void createCalibrationMaps(unsigned int h, unsigned int w, unsigned int camera,
 void main( int argc, char* argv[] ){   
 	SetThreadExecutionState(ES_CONTINUOUS | ES_SYSTEM_REQUIRED | ES_AWAYMODE_REQUIRED);
 	std::string status = "Init";
-	double t_now = clock();
+	double t_now = monotonic_us();
+	Metrics::enabled = true; // timing summary at the end
 	//initConfig(0, argv);
 	//std::cout << std::endl << "Number of Cores: " << boost::thread::hardware_concurrency() << std::endl;  
 	printf("Starting ladybug calibration exporter...\n");
@@ -264,6 +265,7 @@ void main( int argc, char* argv[] ){
 	status = "Total time in loop";
 	t_now=t_loopstart;
 	_TIME
+	Metrics::instance().snapshot().print();
 		/*if(show_images){ 
 			cv::waitKey();
 		}*/
@@ -0,0 +1,121 @@
+// fake_process.cpp : Stands in for a capture process under the watchdog
+// service, without a camera. It beats and reports its health like the
+// capture processes, the scenario decides how healthy it is, so the SLO
+// checks, the restarts and the standby promotion can be tried locally.
+//
+//   fake_process_x64_Release.exe scenarios\slow.ini
+//
+// The scenario is merged over config.ini like the other tools. Started as
+// warm standby (LADYBUG_STANDBY) it waits to be promoted first, the
+// [fake_process] section of watchdog.ini runs it with its SLOs.
+
+#include "timing.h"
+#include "client.h"
+#include <windows.h>
+#include <boost/property_tree/ini_parser.hpp>
+
+const char* PATH_FAKE_FPS = "Fake.Fps";
+const char* PATH_FAKE_LATENCY = "Fake.Latency";
+const char* PATH_FAKE_DROP_RATE = "Fake.DropRate";
+const char* PATH_FAKE_LEAK = "Fake.Leak";
+const char* PATH_FAKE_STALL_AFTER = "Fake.StallAfter";
+const char* PATH_FAKE_EXIT_AFTER = "Fake.ExitAfter";
+
+struct FakeScenario{
+    double fps;                 /* frames per second */
+    unsigned int latency_ms;    /* grab to send latency of every frame */
+    double drop_rate;           /* share of the grabbed frames counted as drops.pool */
+    unsigned int leak_kb;       /* leaked per frame */
+    unsigned int stall_after;   /* s until the loop stops beating, 0 never */
+    unsigned int exit_after;    /* s until the process crashes, 0 never */
+};
+
+/* The capture loop: counts its frames like thread_ladybug_full and beats once per frame */
+void fakeLoop(zmq::context_t* zmq_context, FakeScenario scenario){
+    zmq::socket_t socket_watchdog(*zmq_context, ZMQ_PUSH);
+    socket_watchdog.connect(WATCHDOG_ENDPOINT);
+    unsigned int frames_grabbed = Metrics::instance().counter("frames.grabbed");
+    unsigned int frames_sent = Metrics::instance().counter("frames.sent");
+    unsigned int frames_delivered = Metrics::instance().counter("frames.delivered");
+    unsigned int drops_pool = Metrics::instance().counter("drops.pool");
+    unsigned int frame_latency = Metrics::instance().stage(HEALTH_LATENCY_STAGE);
+    std::vector<char*> leaked;
+    double dropped = 0;
+    bool stalled = false;
+
+    watchdog_starting(&socket_watchdog); // no deadline until the first frame, like the camera start
+    unsigned long long start = monotonic_us();
+    unsigned long long period_us = (unsigned long long)(1000000 / scenario.fps);
+    for(unsigned long long nr = 0; ; ++nr){
+        unsigned long long elapsed_s = (monotonic_us() - start) / 1000000;
+        if(scenario.exit_after > 0 && elapsed_s >= scenario.exit_after){
+            printf("Fake: crashing after %u s\n", scenario.exit_after);
+            exit(EXIT_FAILURE);
+        }
+        if(scenario.stall_after > 0 && elapsed_s >= scenario.stall_after){
+            if(!stalled) printf("Fake: stalled after %u s\n", scenario.stall_after);
+            stalled = true;
+            Sleep(100); // alive, but no heartbeats
+            continue;
+        }
+
+        Metrics::instance().count(frames_grabbed);
+        dropped += scenario.drop_rate;
+        if(dropped >= 1){
+            dropped -= 1;
+            Metrics::instance().count(drops_pool);
+        }else{
+            Metrics::instance().count(frames_sent);
+            Metrics::instance().count(frames_delivered);
+            Metrics::instance().record(frame_latency, scenario.latency_ms * 1000ULL);
+        }
+        if(scenario.leak_kb > 0){
+            char* leak = new char[scenario.leak_kb * 1024];
+            memset(leak, 0, scenario.leak_kb * 1024); // resident, not only reserved
+            leaked.push_back(leak);
+        }
+        zmq::message_t msg_watchdog;
+        socket_watchdog.send(msg_watchdog, ZMQ_NOBLOCK);
+
+        unsigned long long next = start + (nr + 1) * period_us;
+        unsigned long long now = monotonic_us();
+        if(next > now) Sleep((DWORD)((next - now) / 1000));
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    initConfig(argc, argv);
+
+    boost::property_tree::ptree pt;
+    try{
+        boost::property_tree::ini_parser::read_ini(argc > 1 ? argv[1] : cfg_configFile.c_str(), pt);
+    }catch(std::exception){
+        printf("No [Fake] settings, using the defaults\n");
+    }
+    FakeScenario scenario;
+    scenario.fps = pt.get<double>(PATH_FAKE_FPS, 10);
+    scenario.latency_ms = pt.get<unsigned int>(PATH_FAKE_LATENCY, 20);
+    scenario.drop_rate = pt.get<double>(PATH_FAKE_DROP_RATE, 0);
+    scenario.leak_kb = pt.get<unsigned int>(PATH_FAKE_LEAK, 0);
+    scenario.stall_after = pt.get<unsigned int>(PATH_FAKE_STALL_AFTER, 0);
+    scenario.exit_after = pt.get<unsigned int>(PATH_FAKE_EXIT_AFTER, 0);
+    if(scenario.fps <= 0) scenario.fps = 10;
+    if(cfg_watchdog_service.empty()){
+        printf("Warning: no Watchdog.Service, the heartbeats stay in the process\n");
+    }
+
+    zmq::context_t* zmq_context = new zmq::context_t(1);
+    ProcessWatchdog watchdog(zmq_context, cfg_watchdog_service, cfg_heartbeat_timeout, cfg_health_interval);
+    Standby* standby = Standby::create(zmq_context, cfg_watchdog_service);
+    if(standby != NULL){
+        standby->wait();
+        delete standby;
+    }
+
+    printf("Fake: %.1f fps, latency %u ms, drop rate %.2f, leak %u KB per frame, stall after %u s, crash after %u s\n",
+        scenario.fps, scenario.latency_ms, scenario.drop_rate, scenario.leak_kb, scenario.stall_after, scenario.exit_after);
+    boost::thread loop(boost::bind(fakeLoop, zmq_context, scenario));
+    watchdog.run();
+    return 0;
+}
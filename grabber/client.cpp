@@ -12,41 +12,53 @@ void main( int argc, char* argv[] ){
 
     std::cout << std::endl << "Number of Cores: " << boost::thread::hardware_concurrency() << std::endl;  
     zmq::context_t* zmq_context = new zmq::context_t(2);
-    zmq::socket_t* socket_watchdog = NULL;
-    socket_watchdog = new zmq::socket_t(*zmq_context, ZMQ_PULL);
-    int val = 1;
-	socket_watchdog->setsockopt(ZMQ_RCVHWM, &val, sizeof(val));  //prevent buffer get overfilled
-	socket_watchdog->setsockopt(ZMQ_SNDHWM, &val, sizeof(val));
-    socket_watchdog->bind("inproc://watchdog");
+    ProcessWatchdog watchdog(zmq_context, cfg_watchdog_service, cfg_heartbeat_timeout, cfg_health_interval);
+    Standby* standby = Standby::create(zmq_context, cfg_watchdog_service); // started as warm standby: the first init waits to be promoted
     
     //Test
     GrabSend* grabSend = NULL;
     //boost::thread* ladybug_grabber = NULL;
 	boost::shared_ptr<boost::thread> ladybug_grabber = NULL; //(new boost::thread(&do_work));
 
-    zmq::message_t msg;
+    Recovery recovery(cfg_grab_retries, cfg_max_backoff); // the context tier, GrabSend retries and restarts the camera itself
     while(true){
         try{
-            if(!socket_watchdog->recv(&msg, ZMQ_NOBLOCK) || grabSend == NULL || grabSend->stop){
+            /* Wakes on every heartbeat of the loop, a missing one is noticed after Watchdog.HeartbeatTimeout */
+            if(grabSend == NULL || !watchdog.wait() || grabSend->stop){
                  if( ladybug_grabber != NULL){
 					grabSend->stop = true;
-					ladybug_grabber->join();
+					if(!ladybug_grabber->timed_join(boost::posix_time::milliseconds(cfg_heartbeat_timeout))){
+						/* stuck in the driver, the watchdog service starts a new process at once */
+						std::printf("The grabber does not stop, exiting\n");
+						exit(EXIT_FAILURE);
+					}
                 }
+				watchdog.starting();
 
+				bool restart = grabSend != NULL;
 				if( grabSend != NULL ){
                     delete grabSend;
+                    recovery.begin(RECOVER_CONTEXT);
                 }
                
-				Sleep(3000);
+                unsigned int backoff = recovery.backoff_ms();
+                if(backoff > 0){
+				    Sleep(backoff);
+                }
                 grabSend = new GrabSend();
-				grabSend->init(zmq_context);
+				grabSend->init(zmq_context, restart, standby);
+				if(standby != NULL){
+					delete standby;
+					standby = NULL;
+				}
 
 				ladybug_grabber = boost::shared_ptr<boost::thread>(new boost::thread(&GrabSend::loop, grabSend));
+            }else{
+                recovery.recovered(); // the grabber is alive
             }
 		}catch(...){
 			std::printf("Catched unknown Exception, restarting!\n\n");
         }
-        Sleep(500);
     }
 
 	std::printf("<PRESS ANY KEY TO EXIT>");
@@ -0,0 +1,24 @@
+#pragma once
+#include <stddef.h>
+#include <boost/atomic.hpp>
+
+/* zmq::message_t up to this size are stored in the message, ZMQ_MAX_VSM_SIZE - 1 */
+#define ZMQ_INLINE_MESSAGE_SIZE 29
+
+/*
+* Opt-in allocation accounting (Metrics.Allocations).
+* Built with ALLOCATION_HOOKS the global operator new counts the allocations
+* of the calling thread, without it only the external ones are counted.
+* _TIME attributes them to the stage it ends, like the time. Buffers that
+* libzmq and TurboJPEG allocate with malloc are added with external().
+*/
+class Allocations{
+public:
+    static boost::atomic<bool> enabled; /* read relaxed, also in operator new */
+    /* Allocation of a library that does not go through operator new */
+    static void external(size_t bytes);
+    /* Buffer of a zmq::message_t of this size */
+    static void zmq_message(size_t size);
+    /* Allocations of the calling thread since its last call */
+    static void since_last(unsigned long long& count, unsigned long long& bytes);
+};
@@ -0,0 +1,32 @@
+#pragma once
+#include <string>
+#include "zmq.hpp"
+#include "imageMessage.pb.h"
+#include "pipelineMessage.pb.h"
+
+/*
+* Latched calibration channel.
+* The camera calibration does not change during a session, it is published
+* once on its own XPUB socket and again for every new subscriber (e.g. a
+* restarted ROS node). Frame headers only carry the calibration hash.
+*/
+class CalibrationChannel{
+public:
+    CalibrationChannel(zmq::context_t* zmq_context, std::string connection);
+    /* Sets the calibration of the session, publishes it and returns its hash */
+    unsigned long long set(ladybug5_network::pbCalibration& calibration);
+    /* Resends the calibration for every new subscription, only call from the thread owning the channel */
+    void update();
+    unsigned long long hash();
+    ~CalibrationChannel();
+private:
+    void publish();
+    zmq::socket_t* socket;
+    std::string serialized;
+    unsigned long long _hash;
+};
+
+/* Adds the position and distortion of one camera to the calibration */
+void add_camera_calibration(ladybug5_network::pbCalibration* calibration, unsigned int camera, const ladybug5_network::pbPosition& position, const ladybug5_network::pbDisortion& disortion);
+/* FNV-1a over the serialized calibration without the hash field */
+unsigned long long calibration_hash(const ladybug5_network::pbCalibration& calibration);
@@ -0,0 +1,53 @@
+#pragma once
+#include <boost/atomic.hpp>
+#include <boost/function.hpp>
+#include <boost/thread/mutex.hpp>
+
+/*
+* Sizes the encode workers to the load. The encodes of a frame are tasks
+* of the TaskScheduler, the pool sets how many of its workers take them;
+* the compressionThread that waits for the tasks of its frame encodes
+* too and counts as one worker. The encode tasks report their time, the
+* capture loop reports every grabbed frame. Every COMPRESSION_TUNE_FRAMES
+* frames the pool computes the cores busy with encoding and keeps workers
+* for them with some headroom: more are activated at once, surplus ones
+* park one at a time after a calm period and leave their cores to
+* co-located processes. Without auto tuning max_workers run all the time.
+* Published as the gauge compression.workers.
+*/
+class CompressionPool{
+public:
+    /* Starts the compressionThread of the given generation */
+    typedef boost::function<void(unsigned int generation)> Spawn;
+
+    static CompressionPool& instance();
+    void configure(unsigned int min_workers, unsigned int max_workers, bool auto_tune);
+    /* Starts the compressionThread of a new generation and the first workers, the thread of an older one leaves */
+    void start(Spawn spawn);
+    /* Before the threads of the generation are dropped (restart of the capture loop) */
+    void stop();
+    /* An encode task took encode_us */
+    void report_encode(unsigned long long encode_us);
+    /* The capture loop grabbed a frame, runs the controller */
+    void report_frame();
+    /* false: the compressionThread of generation has to leave */
+    bool keep(unsigned int generation);
+    unsigned int workers();
+private:
+    CompressionPool();
+    void resize(unsigned int wanted);
+
+    boost::mutex mutex;
+    Spawn spawn;
+    boost::atomic<unsigned int> generation;
+    boost::atomic<unsigned int> target; /* encode workers wanted, the compressionThread included */
+    unsigned int min_workers;
+    unsigned int max_workers;
+    bool auto_tune;
+
+    boost::atomic<unsigned long long> busy_us;  /* encode time since the last decision */
+    unsigned long long window_start_us;         /* of the last decision */
+    unsigned int frames;
+    unsigned int calm;                  /* evaluations in a row with surplus workers */
+    unsigned int gauge;
+};
@@ -14,6 +14,39 @@
 class Configuration{
 public:
     std::string cfg_ros_master;
+    std::string cfg_calibration;
+    std::string cfg_sensors;
+    unsigned int cfg_metrics_interval;
+    std::string cfg_stats;
+    unsigned int cfg_stats_interval;
+    std::string cfg_spans;
+    unsigned int cfg_span_events;
+    bool cfg_allocations;
+    unsigned int cfg_compression_threads;
+    unsigned int cfg_min_compression_threads;
+    bool cfg_compression_autotune;
+    unsigned int cfg_task_threads;
+    unsigned int cfg_hwm;
+    bool cfg_latest_only;
+    unsigned int cfg_inflight_frames;
+    bool cfg_huge_pages;
+    std::string cfg_render_backend;
+    unsigned int cfg_pipeline_depth;
+    std::string cfg_processing_cache;
+    unsigned int cfg_memory_budget;
+    SheddingPolicy cfg_shedding_policy;
+    unsigned int cfg_admission_wait;
+    unsigned int cfg_shed_target_lag;
+    unsigned int cfg_shed_essential;
+    unsigned int cfg_shed_scale;
+    unsigned int cfg_grab_retries;
+    unsigned int cfg_max_backoff;
+    std::string cfg_watchdog_service;
+    unsigned int cfg_heartbeat_timeout;
+    unsigned int cfg_health_interval;
+    unsigned long long cfg_thread_cores[THREAD_ROLES];
+    ThreadPriority cfg_thread_priority[THREAD_ROLES];
+    bool cfg_reserve_cores;
     std::string cfg_configFile;
     std::string cfg_fileStream;
     bool cfg_panoramic;
@@ -26,6 +59,7 @@ public:
     LadybugColorProcessingMethod cfg_ladybug_colorProcessing;
     LadybugAutoShutterRange cfg_ladybug_autoShutterRange;
     LadybugAutoExposureMode cfg_ladybug_autoExposureMode;
+    std::vector<OutputProfile> cfg_output_profiles;
 
     Configuration(std::string filename="config.ini");
     void load(std::string filename="config.ini");
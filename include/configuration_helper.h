@@ -20,11 +20,23 @@
 #include <ladybugstream.h>
 #define __WINDOWS__ true
 
+#include "output_profile.h"
+#include "memory_budget.h"
+#include "thread_affinity.h"
+
 /* */
 extern const char* zmq_uncompressed;
 extern const char* zmq_compressed;
 
 extern std::string cfg_ros_master;
+extern std::string cfg_calibration;
+extern std::string cfg_sensors; /* empty disables the sensor channel */
+extern unsigned int cfg_metrics_interval; /* seconds between the stage statistics on the console, 0 disables */
+extern std::string cfg_stats; /* stats channel, empty disables */
+extern unsigned int cfg_stats_interval; /* ms */
+extern std::string cfg_spans; /* Chrome trace file, empty disables the span recording */
+extern unsigned int cfg_span_events; /* spans kept per thread */
+extern bool cfg_allocations; /* count allocations per stage, adds a counter update to every new */
 extern std::string cfg_configFile;
 //extern bool cfg_threading;
 extern bool cfg_panoramic;
@@ -32,7 +44,31 @@ extern bool cfg_transfer_compressed;
 extern std::string cfg_fileStream;
 extern bool cfg_postprocessing;
 //extern bool cfg_full_img_msg;
-//extern unsigned int cfg_compression_threads; 
+extern unsigned int cfg_compression_threads; /* threads encoding at most, 0: cfg_task_threads */
+extern unsigned int cfg_min_compression_threads; /* lower bound of the auto tuning */
+extern bool cfg_compression_autotune; /* workers sized to the encode load, cfg_compression_threads is the upper bound */
+extern unsigned int cfg_task_threads; /* workers of the TaskScheduler, 0: one per compression core */
+extern unsigned int cfg_hwm; /* frames queued per socket of the image path */
+extern bool cfg_latest_only; /* mailboxes instead of queues between capture, compression and sending */
+extern unsigned int cfg_inflight_frames; /* frame buffers for the processing, frames are dropped when all are in flight */
+extern bool cfg_huge_pages; /* frame buffers from large pages if the system allows it */
+extern std::string cfg_render_backend; /* ladybug or mock (no GPU) */
+extern unsigned int cfg_pipeline_depth; /* panoramas in flight in the RenderPipeline, 1: sequential */
+extern std::string cfg_processing_cache; /* directory of the ProcessingCache, empty: no cache */
+extern unsigned int cfg_memory_budget; /* MiB of image data in flight, 0: no limit */
+extern SheddingPolicy cfg_shedding_policy; /* frames over the budget */
+extern unsigned int cfg_admission_wait; /* ms, SHED_WAIT only */
+extern unsigned int cfg_shed_target_lag; /* ms grab to send before the load shedding starts, 0 disables */
+extern unsigned int cfg_shed_essential; /* cameras kept by SHED_CAMERAS, PROFILE_* bits */
+extern unsigned int cfg_shed_scale; /* downscale of SHED_RESOLUTION */
+extern unsigned int cfg_grab_retries; /* transient grab errors in a row before the camera is restarted */
+extern unsigned int cfg_max_backoff; /* ms, longest wait between two context rebuilds */
+extern std::string cfg_watchdog_service; /* heartbeats to the watchdog service, empty: no service */
+extern unsigned int cfg_heartbeat_timeout; /* ms without a heartbeat of the capture loop until it counts as stalled */
+extern unsigned int cfg_health_interval; /* ms between the health reports to the watchdog service, 0: none */
+extern unsigned long long cfg_thread_cores[THREAD_ROLES]; /* core mask per ThreadRole, 0: floating */
+extern ThreadPriority cfg_thread_priority[THREAD_ROLES];
+extern bool cfg_reserve_cores; /* capture and I/O cores are not used by compression and sending */
 /* The size of the stitched image */
 extern unsigned int cfg_pano_width;
 extern unsigned int cfg_pano_hight;
@@ -40,11 +76,43 @@ extern LadybugDataFormat cfg_ladybug_dataformat;
 extern LadybugColorProcessingMethod cfg_ladybug_colorProcessing;
 extern LadybugAutoShutterRange cfg_ladybug_autoShutterRange;
 extern LadybugAutoExposureMode cfg_ladybug_autoExposureMode;
+extern std::vector<OutputProfile> cfg_output_profiles;
 
 /* Settings paths */
 extern const char* PATH_ROS_MASTER;
+extern const char* PATH_CALIBRATION;
+extern const char* PATH_SENSORS;
+extern const char* PATH_METRICS_INTERVAL;
+extern const char* PATH_STATS;
+extern const char* PATH_STATS_INTERVAL;
+extern const char* PATH_SPANS;
+extern const char* PATH_SPAN_EVENTS;
+extern const char* PATH_ALLOCATIONS;
 //extern const char* PATH_THREADING;
-//extern const char* PATH_NR_THREADS; 
+extern const char* PATH_NR_THREADS; 
+extern const char* PATH_MIN_THREADS;
+extern const char* PATH_AUTOTUNE;
+extern const char* PATH_TASK_THREADS;
+extern const char* PATH_HWM;
+extern const char* PATH_LATEST_ONLY;
+extern const char* PATH_INFLIGHT_FRAMES;
+extern const char* PATH_HUGE_PAGES;
+extern const char* PATH_RENDER_BACKEND;
+extern const char* PATH_PIPELINE_DEPTH;
+extern const char* PATH_PROCESSING_CACHE;
+extern const char* PATH_MEMORY_BUDGET;
+extern const char* PATH_SHEDDING;
+extern const char* PATH_ADMISSION_WAIT;
+extern const char* PATH_SHED_TARGET_LAG;
+extern const char* PATH_SHED_ESSENTIAL;
+extern const char* PATH_SHED_SCALE;
+extern const char* PATH_GRAB_RETRIES;
+extern const char* PATH_MAX_BACKOFF;
+extern const char* PATH_WATCHDOG_SERVICE;
+extern const char* PATH_HEARTBEAT_TIMEOUT;
+extern const char* PATH_HEALTH_INTERVAL;
+extern const char* PATH_THREADS;
+extern const char* PATH_RESERVE_CORES;
 //extern const char* PATH_BATCH_THREAD;
 extern const char* PATH_POST_PROCESS;      
 extern const char* PATH_LADYBUG_STREAMFILE;
@@ -75,5 +143,7 @@ extern const lex_type ladybugAutoExposureModeMap;
 void printTree (boost::property_tree::ptree &pt, int level);
 void createDefaultIni(boost::property_tree::ptree *pt);
 void loadConfigsFromPtree(boost::property_tree::ptree *pt);
+void putThreadConfig(boost::property_tree::ptree& pt, const unsigned long long* cores, const ThreadPriority* priorities, bool reserve);
+void getThreadConfig(const boost::property_tree::ptree& pt, unsigned long long* cores, ThreadPriority* priorities, bool& reserve);
 void createOptionsFile();
 void initConfig(int argc, char* argv[]);
@@ -9,7 +9,6 @@
 	printf( "Error! While %s. Ladybug library reported %s\n", status.c_str(), \
 	::ladybugErrorToString( error ) ); \
 	printf( "\n\n\nRestarting...\n\n\n");\
-	Sleep(500);\
 	goto _EXIT; \
 	}
 
@@ -19,6 +18,5 @@
 	printf( "Error! While %s. Ladybug library reported %s\n", status.c_str(), \
 	::ladybugErrorToString( lady->error ) ); \
 	printf( "\n\n\nRestarting...\n\n\n");\
-	Sleep(500);\
 	goto _EXIT; \
 	}
\ No newline at end of file
@@ -0,0 +1,64 @@
+#pragma once
+#include <vector>
+#include <boost/atomic.hpp>
+#include <boost/thread/mutex.hpp>
+#include "zmq.hpp"
+
+#define FRAME_POOL_ALIGNMENT 64     /* cache line, also enough for AVX-512 loads */
+#define FRAME_POOL_PLANES 6         /* LADYBUG_NUM_CAMERAS */
+
+/*
+* One contiguous allocation, aligned to FRAME_POOL_ALIGNMENT and touched
+* once so the pages are mapped before the first frame.
+* With huge_pages the slab comes from large pages if the system allows it
+* (Windows: SeLockMemoryPrivilege), otherwise from normal pages.
+*/
+class Slab{
+public:
+    Slab(size_t size, bool huge_pages = false);
+    ~Slab();
+    unsigned char* data;
+    size_t size;
+    bool large_pages;
+private:
+    size_t mapped;
+};
+
+/*
+* Frame buffers for ladybugConvertImage: one slab per frame, carved into
+* aligned camera planes. The planes go out as zero copy zmq messages and
+* the frame returns to the pool when the last plane is freed, normally by
+* a compressionThread. Frames in flight are charged to the MemoryBudget.
+* The pool outlives the restarts of the capture loop,
+* the slabs are only reallocated when the plane size changes.
+*/
+class FramePool{
+public:
+    static FramePool& instance();
+    /* frames is the number of frames in flight, keeps the slabs if nothing changed */
+    void configure(unsigned int plane_size, unsigned int frames, bool huge_pages);
+    /* Messages over the planes of a free frame and their data, false if all frames are in flight */
+    bool acquire(zmq::message_t* planes, unsigned char** buffers);
+    unsigned int plane_size();
+    unsigned int in_flight();
+private:
+    FramePool();
+    struct Frame{
+        FramePool* pool;
+        Slab* slab;
+        unsigned int generation;
+        unsigned long long bytes;   /* charged to the MemoryBudget while in flight */
+        boost::atomic<int> references;
+    };
+    static void free_plane(void* data, void* hint);
+    void release(Frame* frame);
+
+    boost::mutex mutex;
+    std::vector<Frame*> free_frames;
+    unsigned int frames;        /* frames of the current generation, free and in flight */
+    unsigned int wanted_frames;
+    unsigned int _plane_size;
+    unsigned int stride;
+    unsigned int generation;
+    bool huge_pages;
+};
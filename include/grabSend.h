@@ -5,20 +5,38 @@
 class GrabSend{
 public:
     GrabSend();
-	void init(zmq::context_t* zmq_context);
+	/* restart: main rebuilds the grabber after a failure, for the time to first frame.
+	standby: the sockets connect, then it waits to be promoted before the camera is opened */
+	void init(zmq::context_t* zmq_context, bool restart = false, Standby* standby = NULL);
     int loop();
     ~GrabSend();
     bool stop;
 private:
 	void msg_sensordata();
+	/* The sockets, they do not need the camera and are set up while it initializes */
+	void init_network();
+	std::string network_error;
+	FirstFrameClock first_frame;
     unsigned int nr;
     double t_now;
     zmq::message_t msg_watchdog;
     zmq::socket_t* socket;
     zmq::socket_t* socket_watchdog;
+    CalibrationChannel* calibration;
+    SensorPublisher* sensors;
+    boost::thread* stats_thread;
     zmq::context_t* zmq_context;
+    Subscriptions subscribers;
+    bool paused;
+    unsigned int frames_grabbed;
+    unsigned int frames_skipped;
+    unsigned int frames_sent;
+    unsigned int frames_paused;
+    unsigned int frames_delivered;
+    unsigned int frame_latency;
 
 	Configuration config;
+    Recovery recovery;  /* retries and camera restarts, the context is rebuilt by recreating the GrabSend */
     Ladybug *lady;
     unsigned int uiRawCols;
 	unsigned int uiRawRows;
@@ -34,6 +52,8 @@ private:
 	std::string color_encoding;
 
     ladybug5_network::pbMessage message;
+    ladybug5_network::pbMessageExtension header_extension;
+    CycleTimeMapping cycle_time;
     ladybug5_network::pbPosition position[LADYBUG_NUM_CAMERAS];
     ladybug5_network::pbDisortion disortion[LADYBUG_NUM_CAMERAS];
 };
\ No newline at end of file
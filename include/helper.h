@@ -5,14 +5,17 @@
 #include <iostream>
 #include <fstream>
 #include "protobuf_helper.h"
+#include "memory_budget.h"
 
 /*Helper*/
-unsigned int initBuffers(unsigned char** arpBuffers, unsigned int number, unsigned int width, unsigned int height, unsigned int dimensions = 4);
 void initBuffersWitPicture(unsigned char** arpBuffers, long unsigned int* size);
 void jpegEncode(unsigned char* _compressedImage, unsigned long *_jpegSize, unsigned char* srcBuffer, int JPEG_QUALITY, int _width, int _height );
 void writeToFile(std::string filename, char* data, size_t size);
 
 void compressImageToMsg(ladybug5_network::pbMessage *message, zmq::message_t* zmq_msg, int i, TJPF color = TJPF_BGRA);
 zmq::message_t compressImageToZmqMsg(ladybug5_network::pbMessage *message, zmq::message_t* zmq_msg, int i, TJPF color = TJPF_BGRA);
+zmq::message_t compressBufferToZmqMsg(unsigned char* buffer, int width, int height, TJPF color = TJPF_BGRA, int jpeg_quality = 85);
+/* Box filter downscale by an integer factor, dst needs (width/scale)*(height/scale)*pixel_size bytes */
+void scaleImage(const unsigned char* src, int width, int height, int pixel_size, unsigned int scale, unsigned char* dst);
 void addImageToMessage(ladybug5_network::pbMessage *message,  unsigned char* uncompressedBGRImageBuffer, TJPF color, ladybug5_network::LadybugTimeStamp *timestamp, ladybug5_network::ImageType img_type, int _width, int _height);
 
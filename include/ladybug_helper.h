@@ -10,6 +10,8 @@
 LadybugError initCamera( LadybugContext context);
 LadybugError configureLadybugForPanoramic(LadybugContext context);
 LadybugError startLadybug(LadybugContext context);
+/* Stops and starts the camera on the same context, keeps everything that was configured */
+LadybugError restartLadybug(LadybugContext context);
 LadybugError saveImages(LadybugContext context, int i);
 void ladybugImagetoDisk(LadybugImage *image, std::string filename);
 void extractCalibration(LadybugContext context, LadybugImage *image);
\ No newline at end of file
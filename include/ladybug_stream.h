@@ -5,6 +5,7 @@
 #include <sstream>
 #include "helper.h"
 #include <assert.h>
+#include <stdexcept>
 
 unsigned int getDataBitDepth(LadybugImage* image);
 unsigned int getImageCount(LadybugImage* image);
@@ -0,0 +1,52 @@
+#pragma once
+#include <string>
+#include <boost/atomic.hpp>
+
+/* What is shed, every level includes the ones before */
+enum ShedLevel{
+    SHED_NONE = 0,
+    SHED_PANORAMA,      /* no panoramic rendering */
+    SHED_RESOLUTION,    /* camera images downscaled by the compressionThread */
+    SHED_CAMERAS,       /* only the essential cameras */
+    SHED_FRAMES         /* every second frame */
+};
+
+/*
+* Decides once per frame at the head of the pipeline what to shed, from
+* the measured downstream lag: the grab to send latency reported by the
+* sendingThread and the fill level of the MemoryBudget. Under lag the
+* level rises one step at a time, after a calm period it falls one step,
+* so a short spike costs the panorama and not random frames.
+*/
+class LoadShedder{
+public:
+    static LoadShedder& instance();
+    /* target_lag_ms 0 disables, essential_cameras is a PROFILE_* bit mask, scale the downscale of SHED_RESOLUTION */
+    void configure(unsigned int target_lag_ms, unsigned int essential_cameras, unsigned int scale);
+    /* Grab to send latency of a frame, called by the sendingThread */
+    void report_lag(unsigned long long lag_us);
+    /*
+    * Called by the capture loop once per frame: updates the level and
+    * returns the images that may enter the pipeline (0 drops the frame).
+    * scale is set to the downscale of the camera images.
+    */
+    unsigned int apply(unsigned int wanted, unsigned int* scale);
+    ShedLevel level();
+private:
+    LoadShedder();
+    bool overloaded(unsigned long long now_us);
+    bool relaxed(unsigned long long now_us);
+
+    boost::atomic<unsigned long long> lag_us;       /* moving average */
+    boost::atomic<unsigned long long> reported_us;  /* time of the last report */
+    unsigned long long target_us;
+    unsigned int essential_cameras;
+    unsigned int scale;
+    ShedLevel _level;
+    unsigned int frames_at_level;
+    unsigned int frames;        /* for SHED_FRAMES, frames_at_level restarts while the level holds */
+    unsigned int level_gauge;
+    unsigned int counters[SHED_FRAMES + 1];
+};
+
+std::string shedLevelToString(ShedLevel level);
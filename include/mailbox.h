@@ -0,0 +1,44 @@
+#pragma once
+#include <vector>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include "zmq.hpp"
+
+/* The parts of one multipart message, owned by whoever holds the vector */
+typedef std::vector<zmq::message_t*> Parts;
+void free_parts(Parts& parts);
+
+/*
+* Latest-frame-wins hand over between two pipeline stages
+* (Network.LatestOnly). Every slot holds at most one frame: the producer
+* replaces a waiting frame, which is dropped, and the consumer takes the
+* frame. So a frame never waits behind an older one and the latency stays
+* at about one frame period however slow the consumer is. Frames carry
+* their id (pbMessage.id): a frame that finishes after a newer one of
+* the same slot is dropped instead of replacing it.
+* One slot per output profile, so profiles do not replace each other.
+*/
+class Mailbox{
+public:
+    Mailbox(unsigned int slots = 1);
+    /* Takes the parts of frame id, the older of it and a frame still waiting in the slot is dropped */
+    void put(unsigned int slot, Parts& parts, unsigned long long id);
+    /* Waits up to timeout_ms (-1 forever) for a frame, false on timeout. Interruption point */
+    bool take(Parts& parts, unsigned int* slot = NULL, int timeout_ms = -1);
+    ~Mailbox();
+private:
+    Mailbox(const Mailbox&);
+    Mailbox& operator=(const Mailbox&);
+    boost::mutex mutex;
+    boost::condition_variable filled;
+    std::vector<Parts> slots;
+    std::vector<unsigned long long> ids;    /* of the waiting frames */
+    unsigned int next;          /* round robin over the slots */
+    unsigned int drops;
+};
+
+/* The mailboxes of the compressed pipeline, NULL uses the zmq queues */
+struct Mailboxes{
+    Mailbox* uncompressed;      /* capture -> compressionThreads */
+    Mailbox* compressed;        /* compressionThreads -> sendingThread, one slot per profile */
+};
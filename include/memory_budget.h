@@ -0,0 +1,53 @@
+#pragma once
+#include <string>
+#include <boost/atomic.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include "zmq.hpp"
+
+enum SheddingPolicy{
+    SHED_DROP,      /* skip the new frame at once */
+    SHED_WAIT       /* wait up to the admission wait for the budget, then skip */
+};
+
+/*
+* Bytes of image data in flight in the whole pipeline, from the grab to
+* the moment zmq frees the last copy (sent, dropped or compressed).
+* The data is charged where it is allocated and released by the zmq free
+* function, in whatever thread frees the message. Only the grab loop asks
+* for admission, so the budget bounds the frames entering the pipeline;
+* data derived from an admitted frame (jpeg, panorama) is charged without
+* asking and may overshoot the budget by one frame.
+* Published as the gauge inflight.bytes.
+*/
+class MemoryBudget{
+public:
+    static MemoryBudget& instance();
+    /* limit_bytes 0: no limit, only counting */
+    void configure(unsigned long long limit_bytes, SheddingPolicy policy, unsigned int wait_ms);
+    /* true if a frame of bytes fits in the budget now, applies the shedding policy otherwise */
+    bool admit(unsigned long long bytes);
+    void charge(unsigned long long bytes);
+    void release(unsigned long long bytes);
+    /* Message over malloc'ed size bytes, charged until zmq frees it */
+    void message(zmq::message_t* msg, size_t size);
+    /* Message over data allocated by TurboJPEG, freed with tjFree and charged until zmq frees it */
+    void jpeg_message(zmq::message_t* msg, unsigned char* data, size_t size);
+    unsigned long long in_use();
+    unsigned long long limit();
+private:
+    MemoryBudget();
+    static void free_message(void* data, void* hint);
+    static void free_jpeg(void* data, void* hint);
+
+    boost::atomic<unsigned long long> used;
+    unsigned long long _limit;
+    SheddingPolicy policy;
+    unsigned int wait_ms;
+    unsigned int gauge;
+    boost::mutex mutex;
+    boost::condition_variable released;
+};
+
+SheddingPolicy sheddingPolicyFromString(const std::string& name);
+std::string sheddingPolicyToString(SheddingPolicy policy);
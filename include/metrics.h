@@ -0,0 +1,111 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <boost/atomic.hpp>
+#include <boost/thread.hpp>
+
+#define METRICS_MAX_STAGES 256
+#define METRICS_MAX_COUNTERS 64
+#define METRICS_MAX_GAUGES 32
+#define METRICS_LINEAR 16           /* values below are counted exactly */
+#define METRICS_SUB_BUCKETS 8       /* per power of two, ~12% resolution */
+#define METRICS_BUCKETS (METRICS_LINEAR + 36 * METRICS_SUB_BUCKETS)
+
+/*
+* HDR style histogram of microsecond values.
+* Written by one thread only, read by the aggregation without locks.
+*/
+class Histogram{
+public:
+    Histogram();
+    void record(unsigned long long value);
+    /* Allocations made during the recorded values, Metrics.Allocations */
+    void allocated(unsigned long long allocations, unsigned long long bytes);
+    static unsigned int bucket(unsigned long long value);
+    static unsigned long long bucket_value(unsigned int bucket);
+    boost::atomic<unsigned long long> counts[METRICS_BUCKETS];
+    boost::atomic<unsigned long long> count;
+    boost::atomic<unsigned long long> sum;
+    boost::atomic<unsigned long long> max;
+    boost::atomic<unsigned long long> allocations;
+    boost::atomic<unsigned long long> allocated_bytes;
+};
+
+/* Merged histogram of all threads */
+class HistogramSnapshot{
+public:
+    HistogramSnapshot();
+    void add(const Histogram& histogram);
+    void subtract(const HistogramSnapshot& earlier);
+    unsigned long long percentile(double p) const;
+    double mean() const;
+    std::vector<unsigned long long> counts;
+    unsigned long long count;
+    unsigned long long sum;
+    unsigned long long max;     /* since start, not per interval */
+    unsigned long long allocations;
+    unsigned long long allocated_bytes;
+};
+
+class MetricsSnapshot{
+public:
+    std::vector<std::string> stage_names;
+    std::vector<HistogramSnapshot> stages;
+    std::vector<std::string> counter_names;
+    std::vector<unsigned long long> counters;
+    std::vector<std::string> gauge_names;
+    std::vector<long long> gauges;
+    unsigned long long time_us;
+    /* The values between earlier and this snapshot, gauges keep the current value */
+    MetricsSnapshot since(const MetricsSnapshot& earlier) const;
+    void print() const;
+    /* All stage allocations divided by frames.grabbed, 0 without either */
+    double allocations_per_frame() const;
+};
+
+/*
+* Named stages (histograms), counters and gauges (e.g. bytes in flight,
+* one thread adds and another subtracts).
+* Every thread records into its own set, so the hot path takes no lock and
+* writes no console output. Threads that exit hand their set to the next
+* new thread, the values are kept.
+*/
+class Metrics{
+public:
+    static Metrics& instance();
+    /* Registers a name once, the returned id is used on the hot path */
+    unsigned int stage(const std::string& name);
+    unsigned int counter(const std::string& name);
+    unsigned int gauge(const std::string& name);
+    void record(unsigned int stage, unsigned long long value_us, unsigned long long allocations = 0, unsigned long long allocated_bytes = 0);
+    void count(unsigned int counter, unsigned long long n = 1);
+    void add(unsigned int gauge, long long delta);
+    MetricsSnapshot snapshot();
+    /* Prints the interval statistics every interval_sec, 0 disables. Only the first call starts the thread */
+    void start_reporting(unsigned int interval_sec);
+    /* false until something consumes the metrics, recording is skipped then. Read relaxed */
+    static boost::atomic<bool> enabled;
+private:
+    Metrics();
+    struct ThreadMetrics{
+        ThreadMetrics();
+        boost::atomic<Histogram*> stages[METRICS_MAX_STAGES];
+        boost::atomic<unsigned long long> counters[METRICS_MAX_COUNTERS];
+        boost::atomic<long long> gauges[METRICS_MAX_GAUGES];
+    };
+    ThreadMetrics* local();
+    static void release(ThreadMetrics* metrics);
+    void report(unsigned int interval_sec);
+
+    boost::mutex mutex;
+    std::vector<std::string> stage_names;
+    std::vector<std::string> counter_names;
+    std::vector<std::string> gauge_names;
+    std::vector<ThreadMetrics*> threads;
+    std::vector<ThreadMetrics*> unused;
+    boost::thread_specific_ptr<ThreadMetrics> _local;
+    boost::thread* reporter;
+};
+
+/* Stage of a _TIME call site, registered in stage once */
+unsigned int metrics_stage(boost::once_flag& once, unsigned int& stage, const char* function, int line);
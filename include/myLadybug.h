@@ -6,6 +6,8 @@
 #include <string>
 #include <stdio.h>
 #include "configuration.h"
+#include "frame_pool.h"
+#include "processing_cache.h"
 
 #ifndef _ERROR
 #define _ERROR \
@@ -60,6 +62,8 @@ public:
     unsigned int dimmensions;
     unsigned int nrBuffers;
     unsigned char* buffers[ LADYBUG_NUM_CAMERAS ];
+private:
+    Slab* slab; /* all cameras, aligned planes */
 };
 
 class Ladybug{
@@ -68,9 +72,12 @@ public:
 	void init(Configuration* config = NULL, bool init_processing = true);
     ~Ladybug();
     LadybugError grabImage(LadybugImage* image);
+    /* Stops and starts the live camera on this context, the configuration and the processing setup stay */
+    LadybugError restart();
     LadybugError grabProcessedImage(LadybugProcessedImage* image, LadybugOutputImage imageType);
     LadybugCameraInfo caminfo;
     Configuration* config;
+    /* From the cache, all cameras are read at the first call and again after the rectified size changed */
     LadybugError getCameraCalibration(unsigned int camera_index, CameraCalibration* calibration);
     LadybugError initProcessing(unsigned int cols = 0, unsigned int rows = 0);
     ArpBuffer* getBuffer();
@@ -88,6 +95,9 @@ private:
     ArpBuffer* _buffer;
     LadybugImage _raw_image;
     bool images_processed;
+    CameraCalibration calibrations[ LADYBUG_NUM_CAMERAS ];
+    bool calibrations_read;
+    LadybugError readCameraCalibrations();
     LadybugError start(bool init_processing = true);
     LadybugError initCamera();
     LadybugError Ladybug::initStream(std::string path_streamfile);
@@ -0,0 +1,80 @@
+#pragma once
+#include <string>
+#include <vector>
+/* Boost */
+#include <boost/property_tree/ptree.hpp>
+/* Ladybug */
+#include <ladybug.h>
+
+#include "subscriptions.h"
+
+/* Settings paths */
+extern const char* PATH_OUTPUT_PROFILES;
+extern const char* PATH_PROFILE_PREFIX;
+
+/* Bit of the panoramic image in OutputProfile::images, bits 0-5 are the cameras */
+#define PROFILE_PANORAMIC (1 << LADYBUG_NUM_CAMERAS)
+#define PROFILE_ALL_IMAGES ((1 << (LADYBUG_NUM_CAMERAS + 1)) - 1)
+
+/*
+* One output of the processing pipeline, e.g. full quality to the logging
+* node and reduced size/quality to an operator station.
+*
+* [Output]
+* Profiles=default,operator
+* [Profile_operator]
+* Endpoint=tcp://10.1.1.2:28882
+* Cameras=0,1,2,3,4,5,PANO
+* Scale=2
+* Quality=60
+* RateDivisor=3
+*/
+class OutputProfile{
+public:
+    OutputProfile(std::string name = "default", std::string endpoint = "");
+    std::string name;
+    std::string endpoint;
+    unsigned int images;        /* bit mask of the sent images, see PROFILE_PANORAMIC */
+    unsigned int scale;         /* 1 full size, 2 half width and height, ... */
+    int jpeg_quality;
+    unsigned int rate_divisor;  /* send every n-th frame */
+
+    bool wants_frame(unsigned int frame_nr) const;
+    bool wants_image(unsigned int image_bit) const;
+    void load(const boost::property_tree::ptree& pt);
+    std::string get_cameras() const;
+    void set_cameras(std::string cameras);
+private:
+    std::string path(const char* key) const;
+};
+
+/* "0,1,2,PANO" <-> bit mask of PROFILE_PANORAMIC and the camera bits, owner names the setting in warnings */
+std::string imagesToString(unsigned int images);
+unsigned int imagesFromString(const std::string& cameras, const std::string& owner);
+
+/* Profiles listed in Output.Profiles, without the section one full quality profile "default" on default_endpoint (Network.ROS_MASTER) */
+std::vector<OutputProfile> loadOutputProfiles(const boost::property_tree::ptree& pt, std::string default_endpoint);
+
+/*
+* The runtime side of the profiles: the subscriptions of every profile
+* endpoint, owned by the sendingThread and read by the capture and
+* compression threads.
+*/
+class Outputs{
+public:
+    Outputs(const std::vector<OutputProfile>& profiles);
+    std::vector<OutputProfile> profiles;
+    unsigned int size();
+    Subscriptions* subscribers(unsigned int profile);
+    /* true if any profile has subscribers */
+    bool has_subscribers();
+    /* true if the profile has subscribers and wants the frame */
+    bool active(unsigned int profile, unsigned int frame_nr);
+    /* bit mask of the images any active profile wants for this frame, 0 if nobody needs the frame */
+    unsigned int wanted_images(unsigned int frame_nr);
+    ~Outputs();
+private:
+    Outputs(const Outputs&);
+    Outputs& operator=(const Outputs&);
+    std::vector<Subscriptions*> _subscribers;
+};
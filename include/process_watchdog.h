@@ -0,0 +1,80 @@
+#pragma once
+#include <string>
+#include "zmq.hpp"
+
+class MetricsSnapshot;
+
+/* The capture loops report on this socket: an empty message per frame, WATCHDOG_STARTING before a slow (re)start */
+#define WATCHDOG_ENDPOINT "inproc://watchdog"
+#define WATCHDOG_STARTING "starting"
+
+/* Grab to send latency of every frame, reported to the watchdog service as p99 */
+#define HEALTH_LATENCY_STAGE "frame latency"
+
+/* Set by the watchdog service for a warm standby instance: the endpoint it is promoted on */
+#define STANDBY_ENVIRONMENT "LADYBUG_STANDBY"
+
+enum HeartbeatState{
+    HEARTBEAT_RUNNING = 0,  /* frames go through, the deadline of the service runs */
+    HEARTBEAT_STARTING,     /* the camera starts, no deadline until the next running heartbeat */
+    HEARTBEAT_STANDBY       /* initialized without the camera, ready to be promoted */
+};
+
+/* What a capture process sends to the watchdog service (Watchdog.Service) */
+struct HeartbeatMessage{
+    unsigned int process_id;
+    unsigned int state;     /* HeartbeatState */
+};
+
+/* Sent every Watchdog.HealthInterval ms with the heartbeats, the service tells both apart by the size */
+struct HealthMessage{
+    unsigned int process_id;
+    unsigned int p99_latency_us;    /* HEALTH_LATENCY_STAGE in the interval, 0 without frames */
+    float fps;                      /* frames.delivered and frames.paused per second */
+    float drop_rate;                /* dropped frames / frames.grabbed */
+    unsigned long long rss_bytes;   /* resident memory */
+};
+
+/*
+* The watchdog of a capture process. Waits for the heartbeats of the
+* capture loop with a deadline of Watchdog.HeartbeatTimeout ms instead of
+* looking every 500 ms, and forwards them to the watchdog service, which
+* replaces the process when they stop.
+* After WATCHDOG_STARTING the loop initializes the camera, wait() has no
+* deadline until its next heartbeat.
+* Missed deadlines are counted as watchdog.missed.
+* Every health_interval_ms a HealthMessage from the metrics of the
+* interval follows a heartbeat, the service checks it against the SLOs of
+* the program. It enables the metrics.
+*/
+class ProcessWatchdog{
+public:
+    /* Binds WATCHDOG_ENDPOINT on zmq_context, service empty: no watchdog service, health_interval_ms 0: no health reports */
+    ProcessWatchdog(zmq::context_t* zmq_context, const std::string& service, unsigned int timeout_ms, unsigned int health_interval_ms = 0);
+    ~ProcessWatchdog();
+    /* Waits for the next heartbeat of the loop and forwards it, false when the deadline passed without one */
+    bool wait();
+    /* The process rebuilds its capture loop itself, the service waits for the next heartbeat */
+    void starting();
+    /* Forwards heartbeats until the process exits, for the processes running the loop in main */
+    void run();
+private:
+    void report(HeartbeatState state);
+    void report_health();
+    void send(const void* data, size_t size);
+
+    zmq::socket_t* loop;        /* PULL from the capture loop */
+    zmq::socket_t* service;     /* PUSH to the watchdog service, NULL without */
+    unsigned int timeout_ms;
+    bool holding;               /* the loop is starting */
+    unsigned int missed;        /* counter watchdog.missed */
+    unsigned int health_interval_ms;
+    unsigned long long last_health_us;
+    MetricsSnapshot* last_metrics; /* NULL without health reports */
+    unsigned int latency_stage;
+};
+
+/* Tells the watchdog that the loop (re)starts the camera, blocks until it is queued */
+void watchdog_starting(zmq::socket_t* socket_watchdog);
+/* The id the watchdog service knows this process by */
+unsigned int current_process_id();
@@ -0,0 +1,55 @@
+#pragma once
+#include <map>
+#include <string>
+#include <ladybug.h>
+
+/*
+* On-disk cache of what the Ladybug SDK derives on the first start of the
+* processing. ladybugInitializeAlphaMasks generates the alpha masks and
+* writes them to the working directory, which takes minutes. The cache
+* keeps those files per camera serial, resolution, color processing and
+* panorama size in Processing.CacheDir/<key>/ with a manifest of their
+* sizes and FNV-1a checksums:
+* restore() validates the entry (memory mapped, no copy) and puts its
+* files back into the working directory so the SDK loads instead of
+* generating them, store() collects the alpha masks (*.pgm) the
+* initialization created or changed, other files of the working directory
+* are never cached. A file that does not match the manifest drops the entry.
+*/
+class ProcessingCache{
+public:
+    ProcessingCache(const std::string& directory, const std::string& key);
+    static std::string key(unsigned int serial, unsigned int cols, unsigned int rows,
+        LadybugColorProcessingMethod color_processing, unsigned int pano_width, unsigned int pano_height);
+    /* true if a valid entry was restored. Remembers the working directory for store() */
+    bool restore();
+    /* Adds the alpha masks written since restore() to the entry */
+    void store();
+    /* The camera serial and size of the last initialization in directory */
+    static void remember(const std::string& directory, unsigned int serial, unsigned int cols, unsigned int rows);
+    static bool last(const std::string& directory, unsigned int* serial, unsigned int* cols, unsigned int* rows);
+private:
+    struct Artifact{
+        unsigned long long size;
+        unsigned long long checksum;
+    };
+    typedef std::map<std::string, Artifact> Manifest;
+    bool read_manifest(Manifest* manifest);
+    bool write_manifest(const Manifest& manifest);
+    void invalidate();
+    static bool checksum(const std::string& path, Artifact* artifact);
+    /* A file name of the SDK's alpha masks, without a directory */
+    static bool is_alpha_mask(const std::string& name);
+
+    std::string entry;  /* directory of this key */
+    std::map<std::string, std::pair<unsigned long long, long long> > before; /* size and time of the working directory files */
+};
+
+/* ladybugInitializeAlphaMasks through the ProcessingCache of cache_directory, empty: without cache */
+LadybugError initializeAlphaMasksCached(LadybugContext context, const std::string& cache_directory, unsigned int serial,
+    unsigned int cols, unsigned int rows, LadybugColorProcessingMethod color_processing, unsigned int pano_width, unsigned int pano_height);
+
+/* Without the camera: restores the entry of the last initialization and returns its
+* size, false if there is none. A warm standby prepares with it before it is promoted */
+bool prepareAlphaMasksCached(const std::string& cache_directory, LadybugColorProcessingMethod color_processing,
+    unsigned int pano_width, unsigned int pano_height, unsigned int* cols, unsigned int* rows);
@@ -1,20 +1,32 @@
 #pragma once
 #include "imageMessage.pb.h"
+#include "pipelineMessage.pb.h"
 #include "google/protobuf/io/coded_stream.h"
 #include "google/protobuf/io/zero_copy_stream_impl.h"
 #include <zmq.hpp>
 #include "error.h"
 #include "timing.h"
+#include "allocations.h"
 #include "ladybug_stream.h"
 
 /*Protobuff*/
 /* Serialize the ladybug5_network::pbMessage object and send it over the socket */
 bool pb_send(zmq::socket_t* socket, const ladybug5_network::pbMessage* pb_message, int flag = 0);
+/* Same with the extension (e.g. calibration hash) appended to the serialized header */
+bool pb_send(zmq::socket_t* socket, const ladybug5_network::pbMessage* pb_message, const ladybug5_network::pbMessageExtension* extension, int flag = 0);
 /* Recieve and deserialize the request to a ladybug5_network::pbMessage object*/
 bool pb_recv(zmq::socket_t* socket, ladybug5_network::pbMessage* pb_message);
+/* Same with the extension of the header (trace, scale) */
+bool pb_recv(zmq::socket_t* socket, ladybug5_network::pbMessage* pb_message, ladybug5_network::pbMessageExtension* extension);
+/* The header with its extension as one message and back, for hand overs without a socket */
+void pb_serialize(zmq::message_t* msg, const ladybug5_network::pbMessage* pb_message, const ladybug5_network::pbMessageExtension* extension);
+bool pb_parse(zmq::message_t& msg, ladybug5_network::pbMessage* pb_message, ladybug5_network::pbMessageExtension* extension);
 
 std::string enumToString(ladybug5_network::ImageType type);
 
 void prefill_sensordata( ladybug5_network::pbMessage& message, LadybugImage &image);
+/* Copy the gyro, accelerometer, compass and environment data of the image header */
+void fill_sensordata( ladybug5_network::pbSensor* sensor, LadybugImage &image);
+void fill_timestamp( ladybug5_network::LadybugTimeStamp* timestamp, LadybugImage &image);
 
 void send_image( unsigned int index, LadybugImage *image, zmq::socket_t *socket, int flag);
@@ -0,0 +1,55 @@
+#pragma once
+#include <string>
+#include <ladybug.h>
+
+/* Camera restarts without a grabbed frame between, before the context is rebuilt */
+#define RECOVERY_CAMERA_RESTARTS 3
+
+/* How much of the capture state is rebuilt after an error, every tier includes the ones before */
+enum RecoveryTier{
+    RECOVER_RETRY = 0,  /* transient, grab the next frame */
+    RECOVER_SOCKET,     /* the output socket failed, only it is reconnected */
+    RECOVER_CAMERA,     /* the device stopped, ladybugStop and ladybugStart on the same context */
+    RECOVER_CONTEXT,    /* a new Ladybug context, the alpha masks are read back from disk */
+    RECOVERY_TIERS
+};
+
+/* The first tier to try for an error of the Ladybug library */
+RecoveryTier recoveryTier(LadybugError error);
+std::string recoveryTierToString(RecoveryTier tier);
+
+/*
+* Tiered recovery of a capture loop, instead of rebuilding everything
+* after every error. Transient grab errors are retried up to
+* Recovery.GrabRetries times in a row, then the camera is restarted,
+* a failed restart, or RECOVERY_CAMERA_RESTARTS restarts without a frame,
+* rebuild the context. Restarts and rebuilds in a row back off, up to
+* Recovery.MaxBackoff ms.
+* Counted per tier (recovery.retry, recovery.socket, recovery.camera,
+* recovery.context), the time from the error to the next grabbed frame
+* is the stage "recovery <tier>".
+* Lives outside the _RESTART of the loop.
+*/
+class Recovery{
+public:
+    Recovery(unsigned int retries, unsigned int max_backoff_ms);
+    /* The tier for a grab error, escalates transient errors that do not go away */
+    RecoveryTier escalate(LadybugError error);
+    /* Counts a recovery of tier and starts its clock, a higher tier of the same error takes over */
+    void begin(RecoveryTier tier);
+    /* A frame was grabbed, ends a running recovery */
+    void recovered();
+    /* Wait before a camera restart or context rebuild: none for the first, then doubling for the ones without a frame between */
+    unsigned int backoff_ms();
+private:
+    unsigned int retries;
+    unsigned int max_backoff_ms;
+    unsigned int failures;      /* transient errors in a row */
+    unsigned int restarts;      /* camera restarts without a frame between */
+    unsigned int rebuilds;      /* context rebuilds without a frame between */
+    bool recovering;
+    RecoveryTier tier;
+    unsigned long long begin_us;
+    unsigned int counters[RECOVERY_TIERS];
+    unsigned int stages[RECOVERY_TIERS];
+};
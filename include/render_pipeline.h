@@ -0,0 +1,144 @@
+#pragma once
+#include <deque>
+#include <vector>
+#include <boost/thread.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <ladybug.h>
+#include <ladybugrenderer.h>
+#include "zmq.hpp"
+#include "imageMessage.pb.h"
+#include "frame_pool.h"
+
+/*
+* The steps of the panoramic rendering, behind an interface so the
+* pipeline runs and can be benchmarked without a GPU (MockRenderBackend).
+*/
+class RenderBackend{
+public:
+    virtual ~RenderBackend(){}
+    /* Called first on the render thread, before the first upload */
+    virtual LadybugError setup(){ return LADYBUG_OK; }
+    /* Color processing of image into the six BGRU planes */
+    virtual LadybugError convert(LadybugImage* image, unsigned char** planes) = 0;
+    /* The planes to the textures of the graphics card */
+    virtual LadybugError upload(unsigned char** planes) = 0;
+    /* Stitches the uploaded textures, pano->pData is valid until the next render */
+    virtual LadybugError render(LadybugProcessedImage* pano) = 0;
+};
+
+/*
+* The Ladybug SDK. A context must not be used by two threads at once:
+* with a separate convert_context (same configuration) the convert runs
+* in parallel to the render, with the same context the calls take turns.
+* The offscreen rendering is OpenGL, its state belongs to the thread that
+* created it: setup (configureLadybugForPanoramic), upload and render all
+* run on the render thread. The capture thread touches the context again
+* only after RenderPipeline::drain or the end of the pipeline.
+*/
+class LadybugRenderBackend : public RenderBackend{
+public:
+    LadybugRenderBackend(LadybugContext render_context, LadybugContext convert_context);
+    /* Prints the graphics card and configures the panoramic output */
+    LadybugError setup();
+    LadybugError convert(LadybugImage* image, unsigned char** planes);
+    LadybugError upload(unsigned char** planes);
+    LadybugError render(LadybugProcessedImage* pano);
+private:
+    LadybugContext render_context;
+    LadybugContext convert_context;
+    boost::mutex convert_mutex;
+    boost::mutex& render_mutex; /* convert_mutex if both use the same context */
+    boost::mutex own_render_mutex;
+};
+
+/*
+* Stands in for the SDK and the graphics card: convert keeps a core busy
+* for convert_us, upload and render wait like the CPU waits for the GPU
+* and render returns a synthetic BGR panorama.
+*/
+class MockRenderBackend : public RenderBackend{
+public:
+    MockRenderBackend(unsigned int pano_width, unsigned int pano_height, unsigned int plane_size,
+        unsigned int convert_us = 8000, unsigned int upload_us = 3000, unsigned int render_us = 12000);
+    LadybugError convert(LadybugImage* image, unsigned char** planes);
+    LadybugError upload(unsigned char** planes);
+    LadybugError render(LadybugProcessedImage* pano);
+private:
+    std::vector<unsigned char> pano;
+    unsigned int pano_width;
+    unsigned int pano_height;
+    unsigned int plane_size;
+    unsigned int convert_us;
+    unsigned int upload_us;
+    unsigned int render_us;
+    unsigned int frame;
+};
+
+/*
+* Panoramic frames in three overlapping stages (Processing.PipelineDepth):
+* the capture thread converts frame N+1 (submit) while the render thread
+* uploads and renders frame N and the encode thread compresses frame N-1.
+* The capture thread also sends the finished frames, the socket stays in
+* one thread. depth frames are in flight, 1 is the sequential loop.
+*/
+class RenderPipeline{
+public:
+    /* Returns after the setup of the backend on the render thread */
+    RenderPipeline(RenderBackend* backend, unsigned int plane_size, unsigned int depth, bool compressed, int jpeg_quality = 99);
+    ~RenderPipeline();
+    /* The error of the backend setup, no frame can be rendered after one */
+    LadybugError started();
+    /* true if every slot is in flight, finished has to free one before the next submit */
+    bool full();
+    /* Converts image in the calling thread and hands it to the render thread */
+    LadybugError submit(LadybugImage* image, const ladybug5_network::pbMessage& header);
+    /* The oldest finished frame, waits up to timeout_ms (-1 forever). error is the error of its render */
+    bool finished(ladybug5_network::pbMessage* header, zmq::message_t* pano, LadybugError* error, int timeout_ms);
+    /* Frames submitted and not returned by finished yet */
+    unsigned int in_flight();
+    /* Waits for the frames in flight and drops them, afterwards no stage uses the context */
+    void drain();
+private:
+    struct Slot{
+        Slab* planes_slab;
+        unsigned char* planes[LADYBUG_NUM_CAMERAS];
+        ladybug5_network::pbMessage header;
+        zmq::message_t pano;
+        LadybugError error;
+    };
+    class SlotQueue{
+    public:
+        SlotQueue();
+        void push(Slot* slot);
+        /* NULL on timeout or after close */
+        Slot* pop(int timeout_ms = -1);
+        bool empty();
+        void close();
+    private:
+        boost::mutex mutex;
+        boost::condition_variable filled;
+        std::deque<Slot*> slots;
+        bool closed;
+    };
+    void render_stage();
+    void encode_stage();
+
+    RenderBackend* backend;
+    bool compressed;
+    int jpeg_quality;
+    unsigned int submitted;     /* in flight, only the capture thread submits and takes the finished frames */
+    LadybugError setup_error;
+    bool setup_done;
+    boost::mutex setup_mutex;
+    boost::condition_variable setup_finished;
+    std::vector<Slot*> slots;
+    SlotQueue free_slots;
+    SlotQueue to_render;
+    SlotQueue to_encode;
+    SlotQueue done;
+    boost::thread_group threads;
+    unsigned int stage_convert;
+    unsigned int stage_render;
+    unsigned int stage_encode;
+};
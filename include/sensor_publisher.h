@@ -0,0 +1,27 @@
+#pragma once
+#include <string>
+#include <ladybug.h>
+#include "zmq.hpp"
+#include "imageMessage.pb.h"
+#include "pipelineMessage.pb.h"
+
+/*
+* Sensor channel.
+* Sends the gyro, accelerometer, compass and environment data of every
+* grabbed image as a small pbSensorMessage on its own socket, before the
+* image parts are queued. It never waits behind image data and keeps
+* running while the image output is paused.
+*/
+class SensorPublisher{
+public:
+    SensorPublisher(zmq::context_t* zmq_context, std::string connection, std::string serial_number);
+    /* Created before the camera is open, the serial follows once it is */
+    void set_serial_number(const std::string& serial_number);
+    /* Sends without blocking, drops the message if the receiver does not keep up */
+    bool publish(LadybugImage& image, unsigned int id);
+    ~SensorPublisher();
+private:
+    zmq::socket_t* socket;
+    ladybug5_network::pbSensorMessage message;
+    unsigned int drops; /* metrics counter */
+};
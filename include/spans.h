@@ -0,0 +1,78 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <boost/atomic.hpp>
+#include <boost/thread.hpp>
+
+unsigned long long monotonic_us();
+
+/* One finished span, the name is a string literal */
+struct SpanEvent{
+    const char* name;
+    unsigned long long begin_us;
+    unsigned long long duration_us;
+    int image;
+};
+
+/*
+* Opt-in span recorder for profiling, dumped as Chrome trace JSON
+* (chrome://tracing, ui.perfetto.dev).
+* Every thread writes into its own ring buffer without locks, the oldest
+* spans are overwritten. Touch <file>.dump to write the file while running,
+* the capture loops also write it on restart.
+*/
+class Spans{
+public:
+    static Spans& instance();
+    /* Enables recording with events_per_thread spans per thread. Only the first call starts the dump trigger */
+    void start(const std::string& file, unsigned int events_per_thread);
+    void record(const char* name, unsigned long long begin_us, unsigned long long end_us, int image = -1);
+    /* Name of the calling thread in the trace */
+    void name_thread(const std::string& name);
+    /* Writes all buffered spans, false if the file could not be written */
+    bool dump();
+    bool dump(const std::string& file);
+    /* false until start, recording is skipped then. Read relaxed */
+    static boost::atomic<bool> enabled;
+private:
+    Spans();
+    struct ThreadSpans{
+        ThreadSpans(unsigned int capacity, unsigned int tid);
+        std::vector<SpanEvent> events;
+        boost::atomic<unsigned long long> written;
+        unsigned int tid;
+        std::string name;
+    };
+    ThreadSpans* local();
+    static void release(ThreadSpans* spans);
+    void watch();
+
+    boost::mutex mutex;
+    std::string file;
+    unsigned int capacity;
+    std::vector<ThreadSpans*> threads;
+    std::vector<ThreadSpans*> unused;
+    boost::thread_specific_ptr<ThreadSpans> _local;
+    boost::thread* watcher;
+};
+
+/* Span from construction to end() or destruction */
+class Span{
+public:
+    Span(const char* name, int image = -1) : name(name), image(image){
+        begin_us = Spans::enabled.load(boost::memory_order_relaxed) ? monotonic_us() : 0;
+    }
+    void end(){
+        if(begin_us != 0){
+            Spans::instance().record(name, begin_us, monotonic_us(), image);
+            begin_us = 0;
+        }
+    }
+    ~Span(){
+        end();
+    }
+private:
+    const char* name;
+    int image;
+    unsigned long long begin_us;
+};
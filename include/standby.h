@@ -0,0 +1,32 @@
+#pragma once
+#include <string>
+#include "zmq.hpp"
+
+/*
+* A warm standby capture process. The watchdog service starts a second
+* instance of the program with STANDBY_ENVIRONMENT set to its promote
+* endpoint. The instance starts up like the active one but stops in wait()
+* before it opens the camera: the SDK is loaded, the sockets are
+* connected, the compression and sending threads run and the alpha masks
+* and frame pool of the last camera (ProcessingCache) are in place. Only
+* what reads the camera follows the promotion.
+* While it waits it reports HEARTBEAT_STANDBY to the watchdog service. The
+* service publishes the process id on the promote endpoint when the
+* active instance dies or is switched, the handover then only costs the
+* camera start.
+*/
+class Standby{
+public:
+    /* NULL if the process was not started as standby */
+    static Standby* create(zmq::context_t* zmq_context, const std::string& service);
+    ~Standby();
+    /* Blocks until the service promotes this process, returns the ms it waited */
+    unsigned long long wait();
+private:
+    Standby(zmq::context_t* zmq_context, const std::string& promote, const std::string& service);
+    void report(unsigned int state);
+
+    zmq::socket_t* promote;     /* SUB, the topic is the process id */
+    zmq::socket_t* service;     /* PUSH to the watchdog service, NULL without */
+    unsigned int process_id;
+};
@@ -0,0 +1,39 @@
+#pragma once
+#include <string>
+#include <vector>
+#include "zmq.hpp"
+#include "metrics.h"
+#include "allocations.h"
+#include "pipelineMessage.pb.h"
+
+/*
+* Reports connects, disconnects and reconnects of the socket as counters
+* socket.<name>.* on the stats channel. Call from the thread owning the socket.
+*/
+void monitor_socket(zmq::context_t* zmq_context, zmq::socket_t* socket, const std::string& name);
+/* Stops the monitor before the socket is closed, the statsThread drops it */
+void unmonitor_socket(zmq::socket_t* socket);
+
+/* Fills the message with the statistics between the two snapshots */
+void fill_stats(ladybug5_network::pbStats* stats, const MetricsSnapshot& now, const MetricsSnapshot& last);
+
+/* Reads the events of the monitored sockets, used by the statsThread */
+class SocketMonitors{
+public:
+    SocketMonitors(zmq::context_t* zmq_context);
+    /* Connects to new monitors, reads all pending events without blocking and closes the unmonitored ones */
+    void update();
+    ~SocketMonitors();
+private:
+    struct Monitor{
+        std::string name;
+        std::string endpoint;
+        zmq::socket_t* socket;
+        bool disconnected;
+        unsigned int connected_counter;
+        unsigned int disconnected_counter;
+        unsigned int reconnect_counter;
+    };
+    std::vector<Monitor> monitors;
+    zmq::context_t* zmq_context;
+};
@@ -0,0 +1,28 @@
+#pragma once
+#include <set>
+#include <string>
+#include <boost/thread/mutex.hpp>
+#include "zmq.hpp"
+
+/*
+* Tracks the live subscriptions of a XPUB socket.
+* Only the thread owning the socket may call update(), has_subscribers()
+* can be asked from every thread (e.g. the capture loop while the
+* sendingThread owns the socket).
+*/
+class Subscriptions{
+public:
+    Subscriptions();
+    /* Reads all pending (un)subscribe events from the XPUB socket without blocking, returns the number of new subscriptions */
+    unsigned int update(zmq::socket_t* socket);
+    /* true if at least one peer subscribed to a prefix of topic, "" is the image stream */
+    bool has_subscribers(const std::string& topic = "");
+    void clear();
+    ~Subscriptions();
+private:
+    boost::mutex mutex;
+    std::set<std::string> topics;
+};
+
+/* Creates a XPUB socket with the given high water mark and connects (or binds) it */
+zmq::socket_t* create_xpub(zmq::context_t* zmq_context, std::string connection, int hwm, bool zmq_bind = false, bool verbose = false);
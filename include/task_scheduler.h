@@ -0,0 +1,94 @@
+#pragma once
+#include <deque>
+#include <vector>
+#include <boost/atomic.hpp>
+#include <boost/function.hpp>
+#include <boost/thread.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+
+class TaskGroup;
+
+/* One node of a TaskGroup, runs when all tasks it depends on are done */
+struct Task{
+    boost::function<void()> work;
+    TaskGroup* group;
+    boost::atomic<int> dependencies;
+    std::vector<Task*> successors;
+};
+
+/*
+* Work stealing scheduler shared by the pipeline stages (Threading.TaskThreads).
+* Every worker has its own deque: it pushes and pops at the back (the
+* newest task, still in the cache), idle workers steal from the front of
+* the others. Tasks submitted from other threads are spread over the
+* deques. A thread waiting for a TaskGroup runs tasks meanwhile, so a
+* wait inside a task does not block a worker.
+* Only the first active workers take tasks, the CompressionPool sizes
+* them to the encode load. The others park and leave their cores free.
+* Not started, every task runs in the thread that waits for its group.
+*/
+class TaskScheduler{
+public:
+    static TaskScheduler& instance();
+    /* threads 0: one per core. Only the first call starts the workers, all active */
+    void start(unsigned int threads);
+    unsigned int threads();
+    /* Workers that take tasks, the others park. 0: only the waiting threads run tasks */
+    void set_active(unsigned int active);
+    void submit(Task* task);
+    /* Runs one waiting task in the calling thread, false if there is none */
+    bool run_one();
+private:
+    TaskScheduler();
+    struct Worker{
+        boost::mutex mutex;
+        std::deque<Task*> tasks;
+    };
+    void work(unsigned int index);
+    Task* pop(unsigned int index);
+    Task* steal(unsigned int thief);
+    void execute(Task* task);
+
+    boost::mutex mutex;
+    boost::condition_variable available;
+    std::vector<Worker*> workers;
+    boost::thread_group worker_threads;
+    boost::atomic<unsigned int> pending;    /* submitted and not yet taken */
+    boost::atomic<unsigned int> next;       /* deque for tasks from outside */
+    boost::atomic<unsigned int> active;     /* workers below take tasks */
+    unsigned int stolen;                    /* counter tasks.stolen */
+    unsigned int executed;                  /* counter tasks.executed */
+    friend class TaskGroup;
+};
+
+/*
+* The tasks of one frame as a DAG: add the tasks, declare the order with
+* depends, then run. Independent tasks run in parallel on the
+* TaskScheduler, a task becomes ready when its last dependency finished.
+* The group owns its tasks, the destructor waits for them.
+*/
+class TaskGroup{
+public:
+    typedef unsigned int Id;
+    TaskGroup();
+    ~TaskGroup();
+    Id add(const boost::function<void()>& work);
+    /* task runs after before. Only before run() */
+    void depends(Id task, Id before);
+    /* Submits the tasks without dependencies */
+    void run();
+    /* Runs tasks of the scheduler until the whole group is done */
+    void wait();
+private:
+    TaskGroup(const TaskGroup&);
+    TaskGroup& operator=(const TaskGroup&);
+    void finished(Task* task);
+
+    std::vector<Task*> tasks;
+    boost::atomic<unsigned int> remaining;
+    boost::mutex mutex;
+    boost::condition_variable done;
+    bool started;
+    friend class TaskScheduler;
+};
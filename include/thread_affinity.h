@@ -0,0 +1,60 @@
+#pragma once
+#include <string>
+#include <boost/thread.hpp>
+#include "zmq.hpp"
+
+enum ThreadRole{
+    THREAD_CAPTURE,         /* ladybugGrabImage and processing */
+    THREAD_COMPRESSION,     /* compressionThread and the TaskScheduler workers encoding for it */
+    THREAD_SENDING,         /* sendingThread */
+    THREAD_IO,              /* zmq I/O threads of the context */
+    THREAD_ROLES
+};
+
+enum ThreadPriority{
+    PRIORITY_IDLE,
+    PRIORITY_LOWEST,
+    PRIORITY_BELOW_NORMAL,
+    PRIORITY_NORMAL,
+    PRIORITY_ABOVE_NORMAL,
+    PRIORITY_HIGHEST,
+    PRIORITY_TIME_CRITICAL
+};
+
+/*
+* Core set and priority per pipeline thread role ([Threads] in config.ini).
+* A core set is a bit mask of logical cores, 0 leaves the thread floating.
+* With reserve the capture and I/O cores are taken out of the sets of the
+* compression and sending threads, so the encoders never preempt the grab.
+* Windows: SetThreadAffinityMask/SetThreadPriority.
+* Linux: sched_setaffinity/pthread_setschedparam, priorities above normal
+* are realtime (SCHED_RR, SCHED_FIFO) and need CAP_SYS_NICE.
+* Failures are printed and the thread keeps running unpinned.
+*/
+class ThreadAffinity{
+public:
+    static ThreadAffinity& instance();
+    void configure(const unsigned long long* cores, const ThreadPriority* priorities, bool reserve);
+    /* Pins a thread just created for role */
+    void apply(boost::thread* thread, ThreadRole role);
+    /* Pins the calling thread */
+    void apply_current(ThreadRole role);
+    /* Pins the I/O threads of context, before its first socket is created */
+    void apply(zmq::context_t* context);
+    /* Effective core set of role after the reservation, 0: any core */
+    unsigned long long cores(ThreadRole role);
+    /* Number of cores in the set of role, all cores if it floats */
+    unsigned int core_count(ThreadRole role);
+private:
+    ThreadAffinity();
+    unsigned long long _cores[THREAD_ROLES];
+    ThreadPriority priorities[THREAD_ROLES];
+    bool reserve;
+};
+
+const char* threadRoleToString(ThreadRole role);
+ThreadPriority threadPriorityFromString(const std::string& name);
+std::string threadPriorityToString(ThreadPriority priority);
+/* "0-3,6" <-> core mask */
+unsigned long long coresFromString(const std::string& cores, const std::string& owner);
+std::string coresToString(unsigned long long cores);
@@ -19,15 +19,38 @@
 #include <boost/thread.hpp>
 #include "myLadybug.h"
 #include "error.h"
+#include "subscriptions.h"
+#include "output_profile.h"
+#include "calibration.h"
+#include "sensor_publisher.h"
+#include "trace.h"
+#include "stats.h"
+#include "spans.h"
+#include "frame_pool.h"
+#include "memory_budget.h"
+#include "thread_affinity.h"
+#include "compression_pool.h"
+#include "task_scheduler.h"
+#include "load_shedding.h"
+#include "mailbox.h"
+#include "render_pipeline.h"
+#include "recovery.h"
+#include "processing_cache.h"
+#include "process_watchdog.h"
+#include "standby.h"
 
 /*Threads*/
 void ladybugThread(zmq::context_t* p_zmqcontext, std::string imageReciever);
 void ladybugSimulator(zmq::context_t* p_zmqcontext );
-void compressionThread(zmq::context_t* p_zmqcontext, int i);
-void sendingThread(zmq::context_t* p_zmqcontext);
+/* One per generation of the CompressionPool, its encodes run on the TaskScheduler. mailboxes NULL: the stages are connected by zmq queues */
+void compressionThread(zmq::context_t* p_zmqcontext, unsigned int generation, Outputs* outputs, Mailboxes* mailboxes);
+void sendingThread(zmq::context_t* p_zmqcontext, Outputs* outputs, int hwm, Mailboxes* mailboxes);
+/* Publishes a pbStats snapshot of the metrics every interval_ms */
+void statsThread(zmq::context_t* p_zmqcontext, std::string connection, unsigned int interval_ms, std::string serial_number);
 void ladybugFileStreamThread(zmq::context_t* p_zmqcontext, char* filename);
-int thread_ladybug_full(zmq::context_t* zmq_context);
-int thread_panoramic(zmq::context_t* zmq_context);
+/* standby: waits to be promoted before the camera is opened the first time, deleted then */
+int thread_ladybug_full(zmq::context_t* zmq_context, Standby* standby = NULL);
+int thread_panoramic(zmq::context_t* zmq_context, Standby* standby = NULL);
 int thread_ladybug();
 int singleThread();
 
@@ -4,11 +4,42 @@
 #include <iostream>
 #include <time.h>
 #include <string>
+#include "metrics.h"
 
+/*
+* Records the time since t_now in the histogram of this call site, t_now is on the monotonic_us() clock.
+* The compression threads run the same call sites, the stage is registered under a once flag
+* (function-local statics are not initialized thread-safe by VS2012).
+*/
 #ifndef _TIME
 #define _TIME \
-	t_now = time_diff(status, t_now, __FUNCTION__);
+	{ static boost::once_flag _time_once = BOOST_ONCE_INIT; static unsigned int _time_stage; \
+	t_now = time_diff(metrics_stage(_time_once, _time_stage, __FUNCTION__, __LINE__), status, t_now); }
 #endif
 
-double time_diff(std::string status, double start, std::string name);
-#endif
\ No newline at end of file
+double time_diff(unsigned int stage, const std::string& status, double start);
+/* Host monotonic clock in microseconds, comparable between threads */
+unsigned long long monotonic_us();
+
+/*
+* Time to first frame: start() when a capture loop boots or rebuilds its
+* context, sent() after every frame that left the loop. The first frame
+* after start() is recorded in the stage "first frame after boot" or
+* "first frame after restart" and printed. takeover() starts the clock
+* for a promoted standby, "first frame after takeover" is the handover.
+*/
+class FirstFrameClock{
+public:
+    FirstFrameClock();
+    void start(bool restart);
+    void takeover();
+    void sent();
+private:
+    enum Event{ AFTER_BOOT = 0, AFTER_RESTART, AFTER_TAKEOVER, EVENTS };
+    void start(Event event);
+    unsigned long long start_us;
+    bool waiting;
+    Event event;
+    unsigned int stages[EVENTS];
+};
+#endif
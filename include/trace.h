@@ -0,0 +1,34 @@
+#pragma once
+#include <ladybug.h>
+#include "zmq.hpp"
+#include "imageMessage.pb.h"
+#include "pipelineMessage.pb.h"
+
+/* Adds a stage with the current monotonic time to the trace */
+void trace_stage(ladybug5_network::pbTrace* trace, ladybug5_network::TraceStage stage, int image = -1);
+/* Appends a pbMessageExtension with one stage to a serialized frame header */
+void append_trace_stage(zmq::message_t* header, ladybug5_network::TraceStage stage);
+
+/*
+* Relates the Ladybug cycle time (128 s wrap) to the host monotonic clock.
+* A live camera is asked for its current cycle time (sync), for file
+* streams the grab returns after the exposure, so the smallest difference
+* between host time and image cycle time is the best estimate.
+*/
+class CycleTimeMapping{
+public:
+    CycleTimeMapping();
+    /* Reads the cycle time of the live camera, call on start and from time to time for the drift */
+    LadybugError sync(LadybugContext context);
+    /* Updates the estimate with an image grabbed at host_us and returns the offset */
+    long long update(const LadybugTimestamp& timestamp, unsigned long long host_us);
+    long long offset();
+    void reset();
+private:
+    unsigned long long unwrap(const LadybugTimestamp& timestamp);
+    bool valid;
+    bool synced;
+    long long _offset;
+    unsigned long long wraps;
+    unsigned long long last_cycle_us;
+};
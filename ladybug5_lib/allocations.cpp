@@ -0,0 +1,90 @@
+#include "allocations.h"
+#include <stdlib.h>
+#include <new>
+
+#ifdef _MSC_VER
+#define THREAD_LOCAL __declspec(thread)
+#else
+#define THREAD_LOCAL __thread
+#endif
+
+#if defined(_MSC_VER) && _MSC_VER < 1900
+#define NOEXCEPT throw() // no noexcept before VS2015
+#else
+#define NOEXCEPT noexcept
+#endif
+
+boost::atomic<bool> Allocations::enabled(false);
+
+/* plain thread locals, operator new can not use anything that allocates */
+static THREAD_LOCAL unsigned long long thread_count = 0;
+static THREAD_LOCAL unsigned long long thread_bytes = 0;
+static THREAD_LOCAL unsigned long long reported_count = 0;
+static THREAD_LOCAL unsigned long long reported_bytes = 0;
+
+void
+Allocations::external(size_t bytes){
+    if(!enabled.load(boost::memory_order_relaxed)) return;
+    ++thread_count;
+    thread_bytes += bytes;
+}
+
+void
+Allocations::zmq_message(size_t size){
+    if(size > ZMQ_INLINE_MESSAGE_SIZE){
+        external(size);
+    }
+}
+
+void
+Allocations::since_last(unsigned long long& count, unsigned long long& bytes){
+    count = thread_count - reported_count;
+    bytes = thread_bytes - reported_bytes;
+    reported_count = thread_count;
+    reported_bytes = thread_bytes;
+}
+
+#ifdef ALLOCATION_HOOKS
+/* Replaces the global operator new of every program linking the library, only in instrumented builds */
+void* operator new(size_t size){
+    if(Allocations::enabled.load(boost::memory_order_relaxed)){
+        ++thread_count;
+        thread_bytes += size;
+    }
+    void* p = malloc(size > 0 ? size : 1);
+    if(p == NULL) throw std::bad_alloc();
+    return p;
+}
+
+void* operator new[](size_t size){
+    return operator new(size);
+}
+
+void* operator new(size_t size, const std::nothrow_t&) NOEXCEPT{
+    try{
+        return operator new(size);
+    }catch(std::bad_alloc){
+        return NULL;
+    }
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) NOEXCEPT{
+    return operator new(size, std::nothrow);
+}
+
+void operator delete(void* p) NOEXCEPT{
+    free(p);
+}
+
+void operator delete[](void* p) NOEXCEPT{
+    free(p);
+}
+
+void operator delete(void* p, const std::nothrow_t&) NOEXCEPT{
+    free(p);
+}
+
+void operator delete[](void* p, const std::nothrow_t&) NOEXCEPT{
+    free(p);
+}
+#endif
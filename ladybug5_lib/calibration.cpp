@@ -0,0 +1,75 @@
+#include "calibration.h"
+#include "subscriptions.h"
+#include "metrics.h"
+#include <stdio.h>
+
+CalibrationChannel::CalibrationChannel(zmq::context_t* zmq_context, std::string connection){
+    _hash = 0;
+    /* verbose: every subscription is reported, also if the topic is already known */
+    socket = create_xpub(zmq_context, connection, 2, false, true);
+}
+
+unsigned long long
+CalibrationChannel::set(ladybug5_network::pbCalibration& calibration){
+    _hash = calibration_hash(calibration);
+    calibration.set_hash(_hash);
+    calibration.SerializeToString(&serialized);
+    printf("Calibration %s hash %016llx on the calibration channel\n", calibration.serial_number().c_str(), _hash);
+    publish();
+    return _hash;
+}
+
+void
+CalibrationChannel::update(){
+    zmq::message_t event;
+    /* XPUB events: first byte 1 = subscribe, 0 = unsubscribe */
+    while(socket->recv(&event, ZMQ_NOBLOCK)){
+        if(event.size() > 0 && ((const char*)event.data())[0] == 1){
+            publish();
+        }
+    }
+}
+
+void
+CalibrationChannel::publish(){
+    if(serialized.empty()) return;
+    zmq::message_t msg(serialized.size());
+    memcpy(msg.data(), serialized.c_str(), serialized.size());
+    if(!socket->send(msg, ZMQ_NOBLOCK)){
+        static const unsigned int drops = Metrics::instance().counter("drops.calibration");
+        Metrics::instance().count(drops);
+    }
+}
+
+unsigned long long
+CalibrationChannel::hash(){
+    return _hash;
+}
+
+CalibrationChannel::~CalibrationChannel(){
+    socket->close();
+    delete socket;
+}
+
+void
+add_camera_calibration(ladybug5_network::pbCalibration* calibration, unsigned int camera, const ladybug5_network::pbPosition& position, const ladybug5_network::pbDisortion& disortion){
+    ladybug5_network::pbCameraCalibration* camera_msg = calibration->add_cameras();
+    camera_msg->set_type((ladybug5_network::ImageType) ( 1 << camera));
+    camera_msg->mutable_position()->CopyFrom(position);
+    camera_msg->mutable_distortion()->CopyFrom(disortion);
+}
+
+unsigned long long
+calibration_hash(const ladybug5_network::pbCalibration& calibration){
+    ladybug5_network::pbCalibration unhashed(calibration);
+    unhashed.clear_hash();
+    std::string data;
+    unhashed.SerializeToString(&data);
+
+    unsigned long long hash = 14695981039346656037ULL;
+    for(size_t i = 0; i < data.size(); ++i){
+        hash ^= (unsigned char)data[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
@@ -0,0 +1,125 @@
+#include "compression_pool.h"
+#include "task_scheduler.h"
+#include "metrics.h"
+#include <stdio.h>
+
+#define COMPRESSION_TUNE_FRAMES 30      /* frames between two decisions */
+#define COMPRESSION_CALM 4              /* decisions with surplus workers before one leaves */
+#define COMPRESSION_HEADROOM 125        /* % of the measured encode load */
+
+unsigned long long monotonic_us();
+
+CompressionPool::CompressionPool(){
+    generation.store(0);
+    target.store(0);
+    min_workers = 1;
+    max_workers = 1;
+    auto_tune = false;
+    busy_us.store(0);
+    window_start_us = 0;
+    frames = 0;
+    calm = 0;
+    gauge = Metrics::instance().gauge("compression.workers");
+}
+
+CompressionPool&
+CompressionPool::instance(){
+    static CompressionPool pool;
+    return pool;
+}
+
+void
+CompressionPool::configure(unsigned int min_workers, unsigned int max_workers, bool auto_tune){
+    boost::mutex::scoped_lock lock(mutex);
+    this->max_workers = max_workers > 0 ? max_workers : 1;
+    this->min_workers = min_workers < 1 ? 1 : (min_workers > this->max_workers ? this->max_workers : min_workers);
+    this->auto_tune = auto_tune;
+}
+
+void
+CompressionPool::start(Spawn spawn){
+    {
+        boost::mutex::scoped_lock lock(mutex);
+        this->spawn = spawn;
+        ++generation;
+        target.store(0);
+        busy_us.store(0);
+        window_start_us = 0;
+        frames = 0;
+        calm = 0;
+        spawn(generation);
+    }
+    resize(auto_tune ? min_workers : max_workers);
+}
+
+void
+CompressionPool::stop(){
+    boost::mutex::scoped_lock lock(mutex);
+    spawn = Spawn();
+    ++generation;
+    Metrics::instance().add(gauge, -(long long)target.load());
+    target.store(0);
+    TaskScheduler::instance().set_active(0);
+}
+
+void
+CompressionPool::resize(unsigned int wanted){
+    boost::mutex::scoped_lock lock(mutex);
+    if(!spawn) return;
+    unsigned int before = target.load();
+    target.store(wanted);
+    Metrics::instance().add(gauge, (long long)wanted - (long long)before);
+    TaskScheduler::instance().set_active(wanted - 1); // the compressionThread encodes while it waits
+}
+
+void
+CompressionPool::report_encode(unsigned long long encode_us){
+    busy_us.fetch_add(encode_us, boost::memory_order_relaxed);
+}
+
+void
+CompressionPool::report_frame(){
+    if(!auto_tune || target.load() == 0) return; // not started
+    unsigned long long now_us = monotonic_us();
+    if(window_start_us == 0){
+        window_start_us = now_us;
+        busy_us.store(0);
+        return;
+    }
+    if(++frames < COMPRESSION_TUNE_FRAMES) return;
+    frames = 0;
+    unsigned long long window_us = now_us - window_start_us;
+    window_start_us = now_us;
+    if(window_us == 0) return;
+
+    unsigned long long busy = busy_us.exchange(0);
+    unsigned long long load = busy * COMPRESSION_HEADROOM / 100;
+    unsigned int needed = (unsigned int)((load + window_us - 1) / window_us);
+    if(needed < min_workers) needed = min_workers;
+    if(needed > max_workers) needed = max_workers;
+
+    unsigned int current = target.load();
+    if(needed > current){
+        calm = 0;
+        printf("Compression workers %u -> %u (encoding on %.2f cores)\n", current, needed, (double)busy / window_us);
+        resize(needed);
+    }else if(needed < current){
+        if(++calm >= COMPRESSION_CALM){
+            calm = 0;
+            printf("Compression workers %u -> %u (encoding on %.2f cores)\n", current, current - 1, (double)busy / window_us);
+            resize(current - 1);
+        }
+    }else{
+        calm = 0;
+    }
+}
+
+bool
+CompressionPool::keep(unsigned int generation){
+    return generation == this->generation;
+}
+
+unsigned int
+CompressionPool::workers(){
+    return target.load();
+}
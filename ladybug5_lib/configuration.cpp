@@ -14,6 +14,41 @@ Configuration::Configuration(std::string filename){
 void 
 Configuration::init(){
         cfg_ros_master = "tcp://10.1.1.1:28882";
+        cfg_calibration = "tcp://10.1.1.1:28883";
+        cfg_sensors = "tcp://10.1.1.1:28884";
+        cfg_metrics_interval = 10;
+        cfg_stats = "tcp://10.1.1.1:28885";
+        cfg_stats_interval = 1000;
+        cfg_spans = "";
+        cfg_span_events = 65536;
+        cfg_allocations = false;
+        cfg_compression_threads = 0;
+        cfg_min_compression_threads = 1;
+        cfg_compression_autotune = true;
+        cfg_task_threads = 0;
+        cfg_hwm = 6;
+        cfg_latest_only = false;
+        cfg_inflight_frames = 8;
+        cfg_huge_pages = false;
+        cfg_render_backend = "ladybug";
+        cfg_pipeline_depth = 3;
+        cfg_processing_cache = "cache";
+        cfg_memory_budget = 1024;
+        cfg_shedding_policy = SHED_DROP;
+        cfg_admission_wait = 100;
+        cfg_shed_target_lag = 500;
+        cfg_shed_essential = 0x1F;
+        cfg_shed_scale = 2;
+        cfg_grab_retries = 10;
+        cfg_max_backoff = 5000;
+        cfg_watchdog_service = "tcp://127.0.0.1:28884";
+        cfg_heartbeat_timeout = 200;
+        cfg_health_interval = 1000;
+        for(int role = 0; role < THREAD_ROLES; ++role){
+            cfg_thread_cores[role] = 0;
+            cfg_thread_priority[role] = PRIORITY_NORMAL;
+        }
+        cfg_reserve_cores = false;
         cfg_configFile = "config.ini";
         cfg_fileStream = "";
         cfg_panoramic = false;
@@ -26,6 +61,7 @@ Configuration::init(){
         cfg_ladybug_colorProcessing = LADYBUG_DOWNSAMPLE4;//LADYBUG_NEAREST_NEIGHBOR_FAST; //LADYBUG_DOWNSAMPLE4;
         cfg_ladybug_autoShutterRange = LADYBUG_AUTO_SHUTTER_MOTION;
         cfg_ladybug_autoExposureMode = LADYBUG_AUTO_EXPOSURE_ROI_FULL_IMAGE ; 
+        cfg_output_profiles = loadOutputProfiles(pt, cfg_ros_master);
 }
 
 void 
@@ -34,6 +70,37 @@ Configuration::load(std::string filename){
     boost::property_tree::ini_parser::read_ini(filename, pt_load);
 	merge(pt,pt_load);
     cfg_ros_master = pt.get<std::string>(PATH_ROS_MASTER);
+    cfg_calibration = pt.get<std::string>(PATH_CALIBRATION, cfg_calibration);
+    cfg_sensors = pt.get<std::string>(PATH_SENSORS, cfg_sensors);
+    cfg_metrics_interval = pt.get<unsigned int>(PATH_METRICS_INTERVAL, cfg_metrics_interval);
+    cfg_stats = pt.get<std::string>(PATH_STATS, cfg_stats);
+    cfg_stats_interval = pt.get<unsigned int>(PATH_STATS_INTERVAL, cfg_stats_interval);
+    cfg_spans = pt.get<std::string>(PATH_SPANS, cfg_spans);
+    cfg_span_events = pt.get<unsigned int>(PATH_SPAN_EVENTS, cfg_span_events);
+    cfg_allocations = pt.get<bool>(PATH_ALLOCATIONS, cfg_allocations);
+    cfg_compression_threads = pt.get<unsigned int>(PATH_NR_THREADS, cfg_compression_threads);
+    cfg_min_compression_threads = pt.get<unsigned int>(PATH_MIN_THREADS, cfg_min_compression_threads);
+    cfg_compression_autotune = pt.get<bool>(PATH_AUTOTUNE, cfg_compression_autotune);
+    cfg_task_threads = pt.get<unsigned int>(PATH_TASK_THREADS, cfg_task_threads);
+    cfg_hwm = pt.get<unsigned int>(PATH_HWM, cfg_hwm);
+    cfg_latest_only = pt.get<bool>(PATH_LATEST_ONLY, cfg_latest_only);
+    cfg_inflight_frames = pt.get<unsigned int>(PATH_INFLIGHT_FRAMES, cfg_inflight_frames);
+    cfg_huge_pages = pt.get<bool>(PATH_HUGE_PAGES, cfg_huge_pages);
+    cfg_render_backend = pt.get<std::string>(PATH_RENDER_BACKEND, cfg_render_backend);
+    cfg_pipeline_depth = pt.get<unsigned int>(PATH_PIPELINE_DEPTH, cfg_pipeline_depth);
+    cfg_processing_cache = pt.get<std::string>(PATH_PROCESSING_CACHE, cfg_processing_cache);
+    cfg_memory_budget = pt.get<unsigned int>(PATH_MEMORY_BUDGET, cfg_memory_budget);
+    cfg_shedding_policy = sheddingPolicyFromString(pt.get<std::string>(PATH_SHEDDING, sheddingPolicyToString(cfg_shedding_policy)));
+    cfg_admission_wait = pt.get<unsigned int>(PATH_ADMISSION_WAIT, cfg_admission_wait);
+    cfg_shed_target_lag = pt.get<unsigned int>(PATH_SHED_TARGET_LAG, cfg_shed_target_lag);
+    cfg_shed_essential = imagesFromString(pt.get<std::string>(PATH_SHED_ESSENTIAL, imagesToString(cfg_shed_essential)), PATH_SHED_ESSENTIAL);
+    cfg_shed_scale = pt.get<unsigned int>(PATH_SHED_SCALE, cfg_shed_scale);
+    cfg_grab_retries = pt.get<unsigned int>(PATH_GRAB_RETRIES, cfg_grab_retries);
+    cfg_max_backoff = pt.get<unsigned int>(PATH_MAX_BACKOFF, cfg_max_backoff);
+    cfg_watchdog_service = pt.get<std::string>(PATH_WATCHDOG_SERVICE, cfg_watchdog_service);
+    cfg_heartbeat_timeout = pt.get<unsigned int>(PATH_HEARTBEAT_TIMEOUT, cfg_heartbeat_timeout);
+    cfg_health_interval = pt.get<unsigned int>(PATH_HEALTH_INTERVAL, cfg_health_interval);
+    getThreadConfig(pt, cfg_thread_cores, cfg_thread_priority, cfg_reserve_cores);
     cfg_transfer_compressed = pt.get<bool>(PATH_TRANSFER_COMPRESSED);
     cfg_fileStream = pt.get<std::string>(PATH_LADYBUG_STREAMFILE);
     cfg_rectification = pt.get<bool>(PATH_RECTIFICATION);
@@ -44,6 +111,7 @@ Configuration::load(std::string filename){
     cfg_ladybug_dataformat = ladybugDataFormatMap.right.find( pt.get<std::string>(PATH_LB_DATA))->second;
     cfg_ladybug_autoExposureMode = ladybugAutoExposureModeMap.right.find( pt.get<std::string>(PATH_EXPOSURE))->second;
     cfg_ladybug_autoShutterRange = ladybugAutoShutterRangeMap.right.find( pt.get<std::string>(PATH_SHUTTER))->second;
+    cfg_output_profiles = loadOutputProfiles(pt, cfg_ros_master);
 }
 
 void 
@@ -57,6 +125,37 @@ Configuration::merge( boost::property_tree::ptree& pt, const boost::property_tre
 void
 Configuration::save(std::string filename){
     pt.put(PATH_ROS_MASTER, cfg_ros_master.c_str()); 
+    pt.put(PATH_CALIBRATION, cfg_calibration.c_str());
+    pt.put(PATH_SENSORS, cfg_sensors.c_str());
+    pt.put(PATH_METRICS_INTERVAL, cfg_metrics_interval);
+    pt.put(PATH_STATS, cfg_stats.c_str());
+    pt.put(PATH_STATS_INTERVAL, cfg_stats_interval);
+    pt.put(PATH_SPANS, cfg_spans.c_str());
+    pt.put(PATH_SPAN_EVENTS, cfg_span_events);
+    pt.put(PATH_ALLOCATIONS, cfg_allocations);
+    pt.put(PATH_NR_THREADS, cfg_compression_threads);
+    pt.put(PATH_MIN_THREADS, cfg_min_compression_threads);
+    pt.put(PATH_AUTOTUNE, cfg_compression_autotune);
+    pt.put(PATH_TASK_THREADS, cfg_task_threads);
+    pt.put(PATH_HWM, cfg_hwm);
+    pt.put(PATH_LATEST_ONLY, cfg_latest_only);
+    pt.put(PATH_INFLIGHT_FRAMES, cfg_inflight_frames);
+    pt.put(PATH_HUGE_PAGES, cfg_huge_pages);
+    pt.put(PATH_RENDER_BACKEND, cfg_render_backend);
+    pt.put(PATH_PIPELINE_DEPTH, cfg_pipeline_depth);
+    pt.put(PATH_PROCESSING_CACHE, cfg_processing_cache);
+    pt.put(PATH_MEMORY_BUDGET, cfg_memory_budget);
+    pt.put(PATH_SHEDDING, sheddingPolicyToString(cfg_shedding_policy).c_str());
+    pt.put(PATH_ADMISSION_WAIT, cfg_admission_wait);
+    pt.put(PATH_SHED_TARGET_LAG, cfg_shed_target_lag);
+    pt.put(PATH_SHED_ESSENTIAL, imagesToString(cfg_shed_essential).c_str());
+    pt.put(PATH_SHED_SCALE, cfg_shed_scale);
+    pt.put(PATH_GRAB_RETRIES, cfg_grab_retries);
+    pt.put(PATH_MAX_BACKOFF, cfg_max_backoff);
+    pt.put(PATH_WATCHDOG_SERVICE, cfg_watchdog_service);
+    pt.put(PATH_HEARTBEAT_TIMEOUT, cfg_heartbeat_timeout);
+    pt.put(PATH_HEALTH_INTERVAL, cfg_health_interval);
+    putThreadConfig(pt, cfg_thread_cores, cfg_thread_priority, cfg_reserve_cores);
     pt.put(PATH_TRANSFER_COMPRESSED, cfg_transfer_compressed);
     pt.put(PATH_LADYBUG_STREAMFILE, cfg_fileStream.c_str());
     pt.put(PATH_RECTIFICATION, cfg_rectification);
@@ -3,8 +3,21 @@
 /* Settings paths */
 const char* PATH_ROS_MASTER =  "Network.ROS_MASTER";
 const char* PATH_TRANSFER_COMPRESSED = "Network.Compressed";
+const char* PATH_CALIBRATION = "Network.Calibration";
+const char* PATH_SENSORS = "Network.Sensors";
+const char* PATH_METRICS_INTERVAL = "Metrics.Interval";
+const char* PATH_STATS = "Metrics.Stats";
+const char* PATH_STATS_INTERVAL = "Metrics.StatsInterval";
+const char* PATH_SPANS = "Metrics.Spans";
+const char* PATH_SPAN_EVENTS = "Metrics.SpanEvents";
+const char* PATH_ALLOCATIONS = "Metrics.Allocations";
 //const char* PATH_THREADING  =  "Threading.Enabled";
-//const char* PATH_NR_THREADS =  "Threading.NumberCompressionThreads"; 
+const char* PATH_NR_THREADS =  "Threading.NumberCompressionThreads"; 
+const char* PATH_MIN_THREADS = "Threading.MinCompressionThreads";
+const char* PATH_AUTOTUNE = "Threading.CompressionAutoTune";
+const char* PATH_TASK_THREADS = "Threading.TaskThreads";
+const char* PATH_HWM = "Network.HWM";
+const char* PATH_LATEST_ONLY = "Network.LatestOnly";
 //const char* PATH_BATCH_THREAD ="Threading.OneThreadPerImageGrab";
 const char* PATH_POST_PROCESS=  "Processing.Enabled";
 const char* PATH_LADYBUG_STREAMFILE    =   "Input.Filestream";
@@ -12,6 +25,24 @@ const char* PATH_PANO       =   "Processing.CreatePanoramic";
 const char* PATH_PANO_WIDTH =   "Processing.PanoWidth";
 const char* PATH_PANO_HIGHT =   "Processing.PanoHeight";
 const char* PATH_RECTIFICATION = "Processing.Rectification";
+const char* PATH_INFLIGHT_FRAMES = "Processing.InflightFrames";
+const char* PATH_HUGE_PAGES = "Processing.HugePages";
+const char* PATH_RENDER_BACKEND = "Processing.RenderBackend";
+const char* PATH_PIPELINE_DEPTH = "Processing.PipelineDepth";
+const char* PATH_PROCESSING_CACHE = "Processing.CacheDir";
+const char* PATH_MEMORY_BUDGET = "Memory.Budget";
+const char* PATH_SHEDDING = "Memory.Shedding";
+const char* PATH_ADMISSION_WAIT = "Memory.AdmissionWait";
+const char* PATH_SHED_TARGET_LAG = "LoadShedding.TargetLag";
+const char* PATH_SHED_ESSENTIAL = "LoadShedding.EssentialCameras";
+const char* PATH_SHED_SCALE = "LoadShedding.Scale";
+const char* PATH_GRAB_RETRIES = "Recovery.GrabRetries";
+const char* PATH_MAX_BACKOFF = "Recovery.MaxBackoff";
+const char* PATH_WATCHDOG_SERVICE = "Watchdog.Service";
+const char* PATH_HEARTBEAT_TIMEOUT = "Watchdog.HeartbeatTimeout";
+const char* PATH_HEALTH_INTERVAL = "Watchdog.HealthInterval";
+const char* PATH_THREADS = "Threads";
+const char* PATH_RESERVE_CORES = "Threads.ReserveCores";
 const char* PATH_COLOR_PROCESSING = "Processing.ColorProcessing";
 const char* PATH_LB_DATA    =   "Capture.Dataformat";
 const char* PATH_EXPOSURE   =   "Capture.ExposureMode";
@@ -21,6 +52,14 @@ const char* zmq_uncompressed = "inproc://uncompressed";
 const char* zmq_compressed = "inproc://compressed";
 
 std::string cfg_ros_master = "tcp://10.1.1.1:28882";
+std::string cfg_calibration = "tcp://10.1.1.1:28883";
+std::string cfg_sensors = "tcp://10.1.1.1:28884";
+unsigned int cfg_metrics_interval = 10;
+std::string cfg_stats = "tcp://10.1.1.1:28885";
+unsigned int cfg_stats_interval = 1000;
+std::string cfg_spans = "";
+unsigned int cfg_span_events = 65536;
+bool cfg_allocations = false;
 std::string cfg_configFile = "config.ini";
 std::string cfg_fileStream = "";
 //bool cfg_threading = true;
@@ -28,7 +67,31 @@ bool cfg_panoramic = false;
 bool cfg_transfer_compressed = true;
 bool cfg_postprocessing = false;
 //bool cfg_full_img_msg = true;
-//unsigned int cfg_compression_threads = 4; 
+unsigned int cfg_compression_threads = 0;
+unsigned int cfg_min_compression_threads = 1;
+bool cfg_compression_autotune = true;
+unsigned int cfg_task_threads = 0; /* 0: one per compression core */
+unsigned int cfg_hwm = 6;
+bool cfg_latest_only = false;
+unsigned int cfg_inflight_frames = 8;
+bool cfg_huge_pages = false;
+std::string cfg_render_backend = "ladybug";
+unsigned int cfg_pipeline_depth = 3;
+std::string cfg_processing_cache = "cache";
+unsigned int cfg_memory_budget = 1024;
+SheddingPolicy cfg_shedding_policy = SHED_DROP;
+unsigned int cfg_admission_wait = 100;
+unsigned int cfg_shed_target_lag = 500;
+unsigned int cfg_shed_essential = 0x1F; /* cameras 0-4, the top camera 5 goes first */
+unsigned int cfg_shed_scale = 2;
+unsigned int cfg_grab_retries = 10;
+unsigned int cfg_max_backoff = 5000;
+std::string cfg_watchdog_service = "tcp://127.0.0.1:28884";
+unsigned int cfg_heartbeat_timeout = 200;
+unsigned int cfg_health_interval = 1000;
+unsigned long long cfg_thread_cores[THREAD_ROLES] = { 0, 0, 0, 0 };
+ThreadPriority cfg_thread_priority[THREAD_ROLES] = { PRIORITY_NORMAL, PRIORITY_NORMAL, PRIORITY_NORMAL, PRIORITY_NORMAL };
+bool cfg_reserve_cores = false;
 /* The size of the stitched image */
 unsigned int cfg_pano_width = 4096;
 unsigned int cfg_pano_hight = 2048;
@@ -36,6 +99,7 @@ LadybugDataFormat cfg_ladybug_dataformat = LADYBUG_DATAFORMAT_COLOR_SEP_JPEG8;
 LadybugColorProcessingMethod cfg_ladybug_colorProcessing = LADYBUG_DOWNSAMPLE4;//LADYBUG_NEAREST_NEIGHBOR_FAST; //LADYBUG_DOWNSAMPLE4;
 LadybugAutoShutterRange cfg_ladybug_autoShutterRange = LADYBUG_AUTO_SHUTTER_MOTION;
 LadybugAutoExposureMode cfg_ladybug_autoExposureMode = LADYBUG_AUTO_EXPOSURE_ROI_FULL_IMAGE ;
+std::vector<OutputProfile> cfg_output_profiles;
 
 std::string indent(int level) {
   std::string s; 
@@ -66,8 +130,38 @@ void printTree (boost::property_tree::ptree &pt, int level) {
 void createDefaultIni(boost::property_tree::ptree *pt){
     pt->put(PATH_ROS_MASTER, cfg_ros_master.c_str()); 
     pt->put(PATH_TRANSFER_COMPRESSED, cfg_transfer_compressed); 
+    pt->put(PATH_CALIBRATION, cfg_calibration.c_str());
+    pt->put(PATH_SENSORS, cfg_sensors.c_str());
+    pt->put(PATH_METRICS_INTERVAL, cfg_metrics_interval);
+    pt->put(PATH_STATS, cfg_stats.c_str());
+    pt->put(PATH_STATS_INTERVAL, cfg_stats_interval);
+    pt->put(PATH_SPANS, cfg_spans.c_str());
+    pt->put(PATH_SPAN_EVENTS, cfg_span_events);
+    pt->put(PATH_ALLOCATIONS, cfg_allocations);
     //pt->put(PATH_THREADING, cfg_threading);
-    //pt->put(PATH_NR_THREADS, cfg_compression_threads); 
+    pt->put(PATH_NR_THREADS, cfg_compression_threads); 
+    pt->put(PATH_MIN_THREADS, cfg_min_compression_threads);
+    pt->put(PATH_AUTOTUNE, cfg_compression_autotune);
+    pt->put(PATH_TASK_THREADS, cfg_task_threads);
+    pt->put(PATH_HWM, cfg_hwm);
+    pt->put(PATH_LATEST_ONLY, cfg_latest_only);
+    pt->put(PATH_INFLIGHT_FRAMES, cfg_inflight_frames);
+    pt->put(PATH_HUGE_PAGES, cfg_huge_pages);
+    pt->put(PATH_RENDER_BACKEND, cfg_render_backend);
+    pt->put(PATH_PIPELINE_DEPTH, cfg_pipeline_depth);
+    pt->put(PATH_PROCESSING_CACHE, cfg_processing_cache);
+    pt->put(PATH_MEMORY_BUDGET, cfg_memory_budget);
+    pt->put(PATH_SHEDDING, sheddingPolicyToString(cfg_shedding_policy).c_str());
+    pt->put(PATH_ADMISSION_WAIT, cfg_admission_wait);
+    pt->put(PATH_SHED_TARGET_LAG, cfg_shed_target_lag);
+    pt->put(PATH_SHED_ESSENTIAL, imagesToString(cfg_shed_essential).c_str());
+    pt->put(PATH_SHED_SCALE, cfg_shed_scale);
+    pt->put(PATH_GRAB_RETRIES, cfg_grab_retries);
+    pt->put(PATH_MAX_BACKOFF, cfg_max_backoff);
+    pt->put(PATH_WATCHDOG_SERVICE, cfg_watchdog_service);
+    pt->put(PATH_HEARTBEAT_TIMEOUT, cfg_heartbeat_timeout);
+    pt->put(PATH_HEALTH_INTERVAL, cfg_health_interval);
+    putThreadConfig(*pt, cfg_thread_cores, cfg_thread_priority, cfg_reserve_cores);
     //pt->put(PATH_BATCH_THREAD, cfg_full_img_msg);
     pt->put(PATH_POST_PROCESS, cfg_postprocessing);      
     pt->put(PATH_LADYBUG_STREAMFILE, cfg_fileStream.c_str());
@@ -81,11 +175,60 @@ void createDefaultIni(boost::property_tree::ptree *pt){
     boost::property_tree::ini_parser::write_ini(cfg_configFile.c_str(), *pt);
 }
 
+/* Threads.<Role>Cores and Threads.<Role>Priority for every ThreadRole */
+void putThreadConfig(boost::property_tree::ptree& pt, const unsigned long long* cores, const ThreadPriority* priorities, bool reserve){
+    for(int role = 0; role < THREAD_ROLES; ++role){
+        std::string path = std::string(PATH_THREADS) + "." + threadRoleToString((ThreadRole)role);
+        pt.put(path + "Cores", coresToString(cores[role]).c_str());
+        pt.put(path + "Priority", threadPriorityToString(priorities[role]).c_str());
+    }
+    pt.put(PATH_RESERVE_CORES, reserve);
+}
+
+void getThreadConfig(const boost::property_tree::ptree& pt, unsigned long long* cores, ThreadPriority* priorities, bool& reserve){
+    for(int role = 0; role < THREAD_ROLES; ++role){
+        std::string path = std::string(PATH_THREADS) + "." + threadRoleToString((ThreadRole)role);
+        cores[role] = coresFromString(pt.get<std::string>(path + "Cores", coresToString(cores[role])), path + "Cores");
+        priorities[role] = threadPriorityFromString(pt.get<std::string>(path + "Priority", threadPriorityToString(priorities[role])));
+    }
+    reserve = pt.get<bool>(PATH_RESERVE_CORES, reserve);
+}
+
 void loadConfigsFromPtree(boost::property_tree::ptree *pt){
     cfg_ros_master = pt->get<std::string>(PATH_ROS_MASTER);
     cfg_transfer_compressed = pt->get<bool>(PATH_TRANSFER_COMPRESSED); 
+    cfg_calibration = pt->get<std::string>(PATH_CALIBRATION, cfg_calibration);
+    cfg_sensors = pt->get<std::string>(PATH_SENSORS, cfg_sensors);
+    cfg_metrics_interval = pt->get<unsigned int>(PATH_METRICS_INTERVAL, cfg_metrics_interval);
+    cfg_stats = pt->get<std::string>(PATH_STATS, cfg_stats);
+    cfg_stats_interval = pt->get<unsigned int>(PATH_STATS_INTERVAL, cfg_stats_interval);
+    cfg_spans = pt->get<std::string>(PATH_SPANS, cfg_spans);
+    cfg_span_events = pt->get<unsigned int>(PATH_SPAN_EVENTS, cfg_span_events);
+    cfg_allocations = pt->get<bool>(PATH_ALLOCATIONS, cfg_allocations);
     //cfg_threading = pt->get<bool>(PATH_THREADING);
-    //cfg_compression_threads = pt->get<unsigned int>(PATH_NR_THREADS);
+    cfg_compression_threads = pt->get<unsigned int>(PATH_NR_THREADS, cfg_compression_threads);
+    cfg_min_compression_threads = pt->get<unsigned int>(PATH_MIN_THREADS, cfg_min_compression_threads);
+    cfg_compression_autotune = pt->get<bool>(PATH_AUTOTUNE, cfg_compression_autotune);
+    cfg_task_threads = pt->get<unsigned int>(PATH_TASK_THREADS, cfg_task_threads);
+    cfg_hwm = pt->get<unsigned int>(PATH_HWM, cfg_hwm);
+    cfg_latest_only = pt->get<bool>(PATH_LATEST_ONLY, cfg_latest_only);
+    cfg_inflight_frames = pt->get<unsigned int>(PATH_INFLIGHT_FRAMES, cfg_inflight_frames);
+    cfg_huge_pages = pt->get<bool>(PATH_HUGE_PAGES, cfg_huge_pages);
+    cfg_render_backend = pt->get<std::string>(PATH_RENDER_BACKEND, cfg_render_backend);
+    cfg_pipeline_depth = pt->get<unsigned int>(PATH_PIPELINE_DEPTH, cfg_pipeline_depth);
+    cfg_processing_cache = pt->get<std::string>(PATH_PROCESSING_CACHE, cfg_processing_cache);
+    cfg_memory_budget = pt->get<unsigned int>(PATH_MEMORY_BUDGET, cfg_memory_budget);
+    cfg_shedding_policy = sheddingPolicyFromString(pt->get<std::string>(PATH_SHEDDING, sheddingPolicyToString(cfg_shedding_policy)));
+    cfg_admission_wait = pt->get<unsigned int>(PATH_ADMISSION_WAIT, cfg_admission_wait);
+    cfg_shed_target_lag = pt->get<unsigned int>(PATH_SHED_TARGET_LAG, cfg_shed_target_lag);
+    cfg_shed_essential = imagesFromString(pt->get<std::string>(PATH_SHED_ESSENTIAL, imagesToString(cfg_shed_essential)), PATH_SHED_ESSENTIAL);
+    cfg_shed_scale = pt->get<unsigned int>(PATH_SHED_SCALE, cfg_shed_scale);
+    cfg_grab_retries = pt->get<unsigned int>(PATH_GRAB_RETRIES, cfg_grab_retries);
+    cfg_max_backoff = pt->get<unsigned int>(PATH_MAX_BACKOFF, cfg_max_backoff);
+    cfg_watchdog_service = pt->get<std::string>(PATH_WATCHDOG_SERVICE, cfg_watchdog_service);
+    cfg_heartbeat_timeout = pt->get<unsigned int>(PATH_HEARTBEAT_TIMEOUT, cfg_heartbeat_timeout);
+    cfg_health_interval = pt->get<unsigned int>(PATH_HEALTH_INTERVAL, cfg_health_interval);
+    getThreadConfig(*pt, cfg_thread_cores, cfg_thread_priority, cfg_reserve_cores);
     //cfg_full_img_msg = pt->get<bool>(PATH_BATCH_THREAD);
     cfg_postprocessing = pt->get<bool>(PATH_POST_PROCESS);
     cfg_fileStream = pt->get<std::string>(PATH_LADYBUG_STREAMFILE);
@@ -96,6 +239,7 @@ void loadConfigsFromPtree(boost::property_tree::ptree *pt){
     cfg_ladybug_dataformat = ladybugDataFormatMap.right.find( pt->get<std::string>(PATH_LB_DATA))->second;
     cfg_ladybug_autoExposureMode = ladybugAutoExposureModeMap.right.find( pt->get<std::string>(PATH_EXPOSURE))->second;
     cfg_ladybug_autoShutterRange = ladybugAutoShutterRangeMap.right.find( pt->get<std::string>(PATH_SHUTTER))->second;
+    cfg_output_profiles = loadOutputProfiles(*pt, cfg_ros_master);
 }
 
 const ldf_type ladybugDataFormatMap =
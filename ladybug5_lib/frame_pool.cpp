@@ -0,0 +1,172 @@
+#include "frame_pool.h"
+#include "memory_budget.h"
+#include <stdio.h>
+#include <string.h>
+#include <new>
+#ifdef _WIN32
+#include <Windows.h>
+#include <malloc.h>
+#else
+#include <stdlib.h>
+#include <sys/mman.h>
+#endif
+
+Slab::Slab(size_t size, bool huge_pages){
+    this->size = size;
+    data = NULL;
+    large_pages = false;
+    mapped = 0;
+#ifdef _WIN32
+    size_t large_page = huge_pages ? GetLargePageMinimum() : 0;
+    if(large_page > 0){
+        mapped = (size + large_page - 1) / large_page * large_page;
+        data = (unsigned char*)VirtualAlloc(NULL, mapped, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE);
+        large_pages = data != NULL;
+    }
+    if(data == NULL){
+        data = (unsigned char*)_aligned_malloc(size, FRAME_POOL_ALIGNMENT);
+    }
+#else
+    if(huge_pages){
+        mapped = (size + (2 << 20) - 1) & ~(size_t)((2 << 20) - 1);
+        void* p = mmap(NULL, mapped, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if(p != MAP_FAILED){
+            data = (unsigned char*)p;
+            large_pages = true;
+        }
+    }
+    if(data == NULL){
+        void* p = NULL;
+        if(posix_memalign(&p, FRAME_POOL_ALIGNMENT, size) == 0){
+            data = (unsigned char*)p;
+        }
+    }
+#endif
+    if(data == NULL){
+        throw std::bad_alloc();
+    }
+    if(huge_pages && !large_pages){
+        printf("Large pages not available, using normal pages for %.1f MiB\n", size / (1024.0 * 1024.0));
+    }
+    memset(data, 0, size); // map the pages now, not on the first frame
+}
+
+Slab::~Slab(){
+#ifdef _WIN32
+    if(large_pages){
+        VirtualFree(data, 0, MEM_RELEASE);
+    }else{
+        _aligned_free(data);
+    }
+#else
+    if(large_pages){
+        munmap(data, mapped);
+    }else{
+        free(data);
+    }
+#endif
+}
+
+FramePool::FramePool(){
+    frames = 0;
+    wanted_frames = 0;
+    _plane_size = 0;
+    stride = 0;
+    generation = 0;
+    huge_pages = false;
+}
+
+FramePool&
+FramePool::instance(){
+    /* never destroyed, zmq may free planes of a frame during shutdown */
+    static FramePool* pool = new FramePool();
+    return *pool;
+}
+
+void
+FramePool::configure(unsigned int plane_size, unsigned int frames, bool huge_pages){
+    boost::mutex::scoped_lock lock(mutex);
+    if(frames == 0) frames = 1;
+    if(plane_size != _plane_size || huge_pages != this->huge_pages){
+        /* frames in flight are freed on release, they belong to the old generation */
+        for(size_t i = 0; i < free_frames.size(); ++i){
+            delete free_frames[i]->slab;
+            delete free_frames[i];
+        }
+        free_frames.clear();
+        this->frames = 0;
+        ++generation;
+        _plane_size = plane_size;
+        stride = (plane_size + FRAME_POOL_ALIGNMENT - 1) / FRAME_POOL_ALIGNMENT * FRAME_POOL_ALIGNMENT;
+        this->huge_pages = huge_pages;
+    }
+    wanted_frames = frames;
+    while(this->frames > wanted_frames && !free_frames.empty()){
+        delete free_frames.back()->slab;
+        delete free_frames.back();
+        free_frames.pop_back();
+        --this->frames;
+    }
+    while(this->frames < wanted_frames){
+        Frame* frame = new Frame();
+        frame->pool = this;
+        frame->slab = new Slab((size_t)stride * FRAME_POOL_PLANES, huge_pages);
+        frame->generation = generation;
+        frame->references.store(0);
+        free_frames.push_back(frame);
+        ++this->frames;
+    }
+    printf("Frame pool: %u frames of %u x %u bytes\n", wanted_frames, FRAME_POOL_PLANES, plane_size);
+}
+
+bool
+FramePool::acquire(zmq::message_t* planes, unsigned char** buffers){
+    Frame* frame = NULL;
+    {
+        boost::mutex::scoped_lock lock(mutex);
+        if(free_frames.empty()) return false;
+        frame = free_frames.back();
+        free_frames.pop_back();
+    }
+    frame->references.store(FRAME_POOL_PLANES);
+    frame->bytes = (unsigned long long)_plane_size * FRAME_POOL_PLANES;
+    MemoryBudget::instance().charge(frame->bytes);
+    for(unsigned int i = 0; i < FRAME_POOL_PLANES; ++i){
+        buffers[i] = frame->slab->data + (size_t)i * stride;
+        planes[i].rebuild(buffers[i], _plane_size, &FramePool::free_plane, frame);
+    }
+    return true;
+}
+
+void
+FramePool::free_plane(void* data, void* hint){
+    /* called by zmq in the thread that frees the message */
+    Frame* frame = (Frame*)hint;
+    if(frame->references.fetch_sub(1) == 1){
+        MemoryBudget::instance().release(frame->bytes);
+        frame->pool->release(frame);
+    }
+}
+
+void
+FramePool::release(Frame* frame){
+    boost::mutex::scoped_lock lock(mutex);
+    if(frame->generation != generation || frames > wanted_frames){
+        if(frame->generation == generation) --frames;
+        delete frame->slab;
+        delete frame;
+        return;
+    }
+    free_frames.push_back(frame);
+}
+
+unsigned int
+FramePool::plane_size(){
+    return _plane_size;
+}
+
+unsigned int
+FramePool::in_flight(){
+    boost::mutex::scoped_lock lock(mutex);
+    return frames - free_frames.size();
+}
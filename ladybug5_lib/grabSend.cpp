@@ -1,12 +1,17 @@
 #include "grabSend.h"
+#include <stdexcept>
 
-GrabSend::GrabSend(){
+GrabSend::GrabSend() : recovery(config.cfg_grab_retries, config.cfg_max_backoff){
     socket = NULL;
     socket_watchdog = NULL;
+    calibration = NULL;
+    sensors = NULL;
+    stats_thread = NULL;
     uiRawCols = 0;
     uiRawRows = 0;
     separatedColors = false;
     stop = false;
+    paused = false;
 	lady = NULL;
 	nr = 0;
     
@@ -14,8 +19,38 @@ GrabSend::GrabSend(){
 }
 
 void
-GrabSend::init(zmq::context_t* zmq_context)
+GrabSend::init_network(){
+	try{
+		//-----------------------------------------------
+		//create watchdog
+		//-----------------------------------------------
+		int val_watchdog = 1;
+		socket_watchdog = new zmq::socket_t(*zmq_context, ZMQ_PUSH);
+		socket_watchdog->setsockopt(ZMQ_RCVHWM, &val_watchdog, sizeof(val_watchdog));  //prevent buffer get overfilled
+		socket_watchdog->setsockopt(ZMQ_SNDHWM, &val_watchdog, sizeof(val_watchdog));
+		socket_watchdog->connect(WATCHDOG_ENDPOINT);
+		socket_watchdog->send(msg_watchdog, ZMQ_NOBLOCK);
+
+		int val = 2; //buffer size
+		socket = create_xpub(zmq_context, cfg_ros_master, val, false);
+		monitor_socket(zmq_context, socket, "ros_master");
+
+		calibration = new CalibrationChannel(zmq_context, config.cfg_calibration);
+	}catch(zmq::error_t& e){
+		network_error = e.what(); // thrown by init after the join
+	}catch(std::exception& e){
+		network_error = e.what(); // an exception must not leave the thread, it would terminate the process
+	}catch(...){
+		network_error = "unknown exception";
+	}
+}
+
+void
+GrabSend::init(zmq::context_t* zmq_context, bool restart, Standby* standby)
 {	
+	this->zmq_context = zmq_context;
+	first_frame.start(restart);
+	t_now = monotonic_us();
 	if(config.cfg_panoramic){
 		config.cfg_panoramic=false;
 		printf("Warning: panoramic image creation not supported in grabber...\n");
@@ -26,18 +61,39 @@ GrabSend::init(zmq::context_t* zmq_context)
 		printf("Warning: compressed image transfer is not supported in grabber...\n");
 	}
 
-	lady = new Ladybug();
-	lady->init(&config);
-
-    //-----------------------------------------------
-    //create watchdog
-    //-----------------------------------------------
-    int val_watchdog = 1;
-    socket_watchdog = new zmq::socket_t(*zmq_context, ZMQ_PUSH);
-	socket_watchdog->setsockopt(ZMQ_RCVHWM, &val_watchdog, sizeof(val_watchdog));  //prevent buffer get overfilled
-	socket_watchdog->setsockopt(ZMQ_SNDHWM, &val_watchdog, sizeof(val_watchdog));
-    socket_watchdog->connect("inproc://watchdog");
-    socket_watchdog->send(msg_watchdog, ZMQ_NOBLOCK);
+	if(config.cfg_allocations){
+		Allocations::enabled = true;
+		Metrics::enabled = true;
+	}
+	Metrics::instance().start_reporting(config.cfg_metrics_interval);
+	Spans::instance().start(config.cfg_spans, config.cfg_span_events);
+	Spans::instance().name_thread("grab and send");
+	frames_grabbed = Metrics::instance().counter("frames.grabbed");
+	frames_skipped = Metrics::instance().counter("frames.skipped");
+	frames_sent = Metrics::instance().counter("frames.sent");
+	frames_paused = Metrics::instance().counter("frames.paused");
+	frames_delivered = Metrics::instance().counter("frames.delivered");
+	frame_latency = Metrics::instance().stage(HEALTH_LATENCY_STAGE);
+
+	/* Watchdog, output socket and calibration channel connect while the camera and the processing start */
+	status = "connect with zmq to " + cfg_ros_master;
+	boost::thread network(boost::bind(&GrabSend::init_network, this));
+	try{
+		if(standby != NULL){
+			standby->wait();
+			first_frame.takeover();
+		}
+		lady = new Ladybug();
+		lady->init(&config);
+	}catch(...){
+		network.join(); // the sockets belong to this GrabSend, the destructor closes them
+		throw;
+	}
+	network.join();
+	if(!network_error.empty()){
+		throw std::runtime_error(network_error);
+	}
+	_TIME
 
     lady->grabImage(&image);
    
@@ -62,32 +118,12 @@ GrabSend::init(zmq::context_t* zmq_context)
 
 	_TIME
     
-    std::string connection;
-	int socket_type = ZMQ_PUB;
-    bool zmq_bind = false;
- 
-    connection = cfg_ros_master.c_str();
-
-    status = "connect with zmq to " + connection;
-
-	socket = new zmq::socket_t(*zmq_context, socket_type);
-	int val = 2; //buffer size
-	socket->setsockopt(ZMQ_RCVHWM, &val, sizeof(val));  //prevent buffer get overfilled
-	socket->setsockopt(ZMQ_SNDHWM, &val, sizeof(val));  //prevent buffer get overfilled
-        
-    if(zmq_bind){
-        socket->bind(connection.c_str());
-    }else{
-        socket->connect(connection.c_str());
-    }
-	_TIME 
-    
     socket_watchdog->send(msg_watchdog, ZMQ_NOBLOCK);
     for( unsigned int uiCamera = 0; uiCamera < LADYBUG_NUM_CAMERAS; uiCamera++ ){
         status = "reading camera extrinics and disortion";
            
         CameraCalibration calib;
-        lady->getCameraCalibration(uiCamera, &calib);
+        lady->getCameraCalibration(uiCamera, &calib); // all cameras are read at the first call
             
         position[uiCamera].set_rx(calib.rotationX);
         position[uiCamera].set_ry(calib.rotationY);
@@ -108,8 +144,6 @@ GrabSend::init(zmq::context_t* zmq_context)
 		image_msg->set_name(enumToString(image_msg->type()));
 		image_msg->set_height(uiRawRows);
 		image_msg->set_width(uiRawCols);
-		image_msg->set_allocated_distortion(new ladybug5_network::pbDisortion(disortion[uiCamera]));
-		image_msg->set_allocated_position(new ladybug5_network::pbPosition(position[uiCamera]));
         
 		image_msg->set_border_left(image.imageBorder.uiLeftCols/2);
 		image_msg->set_border_right(image.imageBorder.uiRightCols/2);
@@ -128,8 +162,27 @@ GrabSend::init(zmq::context_t* zmq_context)
 		_TIME
     }
 
+    /* The calibration is latched on its own channel, the frames only carry the hash */
+    status = "publish calibration on " + config.cfg_calibration;
+    ladybug5_network::pbCalibration calibration_msg;
+    calibration_msg.set_serial_number(std::to_string(lady->caminfo.serialBase));
+    for( unsigned int uiCamera = 0; uiCamera < LADYBUG_NUM_CAMERAS; uiCamera++ ){
+        add_camera_calibration(&calibration_msg, uiCamera, position[uiCamera], disortion[uiCamera]);
+    }
+    header_extension.set_calibration_hash(calibration->set(calibration_msg));
+    if(!lady->isFileStream()){
+        cycle_time.sync(lady->context);
+    }
+    if(!config.cfg_sensors.empty()){
+        sensors = new SensorPublisher(zmq_context, config.cfg_sensors, std::to_string(lady->caminfo.serialBase));
+    }
+    if(!config.cfg_stats.empty()){
+        stats_thread = new boost::thread(std::bind(statsThread, zmq_context, config.cfg_stats, config.cfg_stats_interval, std::to_string(lady->caminfo.serialBase)));
+    }
+    _TIME
+
     unsigned int nr = 0;
-    double loopstart = t_now = clock();		
+    double loopstart = t_now = monotonic_us();		
        
     printf("Running...\n");
     socket_watchdog->send(msg_watchdog, ZMQ_NOBLOCK);
@@ -142,25 +195,86 @@ GrabSend::loop(){
 	
     while(!stop){
 		try{
-			loopstart = t_now = clock();
+			loopstart = t_now = monotonic_us();
 			t_now = loopstart;
 
+			/* Without subscribers the images are only grabbed to keep the camera running */
+			subscribers.update(socket);
+			calibration->update();
+			if(paused != !subscribers.has_subscribers()){
+				paused = !paused;
+				printf(paused ? "No subscribers, pausing...\n" : "Subscriber connected, resuming...\n");
+			}
+
 			// Grab an image from the camera
 			status = "wait for image";
 			_TIME
 			/* Get ladybugImage */
+			Span grab_span("grab");
 			lady->grabImage(&image);
-			_HANDLE_ERROR_LADY
+			if(lady->error != LADYBUG_OK){
+				printf("Error! While %s. Ladybug library reported %s\n", status.c_str(), ::ladybugErrorToString(lady->error));
+				RecoveryTier tier = lady->isFileStream() ? RECOVER_CONTEXT : recovery.escalate(lady->error);
+				if(tier == RECOVER_RETRY){
+					recovery.begin(RECOVER_RETRY);
+					socket_watchdog->send(msg_watchdog, ZMQ_NOBLOCK);
+					continue;
+				}
+				if(tier == RECOVER_CAMERA){
+					recovery.begin(RECOVER_CAMERA);
+					status = "restart the camera";
+					watchdog_starting(socket_watchdog);
+					unsigned int backoff = recovery.backoff_ms();
+					if(backoff > 0){
+						printf("Waiting %u ms...\n", backoff);
+						Sleep(backoff);
+					}
+					if(lady->restart() == LADYBUG_OK){
+						cycle_time.sync(lady->context);
+						socket_watchdog->send(msg_watchdog, ZMQ_NOBLOCK);
+						continue;
+					}
+				}
+				stop = true; // main rebuilds the context
+				goto _EXIT;
+			}
+			recovery.recovered();
+			grab_span.end();
+			ladybug5_network::pbTrace* trace = header_extension.mutable_trace();
+			trace->Clear();
+			trace->set_grab_us(monotonic_us());
+			trace_stage(trace, ladybug5_network::TRACE_GRAB);
+			Metrics::instance().count(frames_grabbed);
+			if(sensors != NULL){
+				sensors->publish(image, nr); // ahead of the image parts, also while paused
+			}
 			// Grab an image from the camera
 			status = "got images";
 			_TIME
 
+			if(paused){
+				Metrics::instance().count(frames_skipped);
+				Metrics::instance().count(frames_paused);
+				socket_watchdog->send(msg_watchdog, ZMQ_NOBLOCK);
+				if(lady->isFileStream()){
+					Sleep(lady->getCycleTime());
+				}
+				continue;
+			}
+
 			prefill_sensordata(message, image); 
+			if(!lady->isFileStream() && nr % 1000 == 0){
+				cycle_time.sync(lady->context); // follow the drift of the clocks
+			}
+			trace->set_cycle_offset_us(cycle_time.update(image.timeStamp, trace->grab_us()));
+			trace_stage(trace, ladybug5_network::TRACE_HEADER);
 			status = "get sensordata";
 			_TIME
 
 			//send protobuff message
-			pb_send(socket, &message, ZMQ_SNDMORE); 
+			Span send_span("send");
+			trace_stage(trace, ladybug5_network::TRACE_ENQUEUE);
+			pb_send(socket, &message, &header_extension, ZMQ_SNDMORE); 
 			status = "send header";
 			_TIME
 
@@ -192,6 +306,10 @@ GrabSend::loop(){
 					send_image(uiCamera, &image, socket, flag);
 				}
 			} // end uiCamera loop
+			Metrics::instance().count(frames_sent);
+			Metrics::instance().count(frames_delivered);
+			Metrics::instance().record(frame_latency, monotonic_us() - trace->grab_us());
+			first_frame.sent();
 
 			_TIME
 			//message.Clear();
@@ -200,7 +318,7 @@ GrabSend::loop(){
 			socket_watchdog->send(msg_watchdog, ZMQ_NOBLOCK); // Loop done
         
 			if(lady->isFileStream()){
-				double sleepTime = lady->getCycleTime() - (clock() - loopstart) -1;
+				double sleepTime = lady->getCycleTime() - (monotonic_us() - loopstart) / 1000 -1;
 				if(sleepTime > 0){
 					Sleep(sleepTime);
 				}
@@ -212,26 +330,53 @@ GrabSend::loop(){
 			t_now = loopstart;
 			_TIME
 		}
+		catch(zmq::error_t& e){
+			/* the output socket failed, the camera is fine */
+			printf("Socket error %s, reconnecting\n", e.what());
+			recovery.begin(RECOVER_SOCKET);
+			unmonitor_socket(socket);
+			socket->close();
+			delete socket;
+			socket = NULL;
+			try{
+				subscribers.clear();
+				socket = create_xpub(zmq_context, cfg_ros_master, 2, false);
+				monitor_socket(zmq_context, socket, "ros_master");
+			}catch(zmq::error_t& e){
+				printf("Reconnect failed: %s\n", e.what());
+				stop = true;
+			}
+		}
 		catch(std::exception e){
 			stop = true;
 		}
 	}
+	socket_watchdog->send(msg_watchdog, ZMQ_NOBLOCK); // wakes main, it rebuilds the grabber
 	return 0;
 	
 _EXIT:
+	socket_watchdog->send(msg_watchdog, ZMQ_NOBLOCK);
     return 1;
 }
 
 GrabSend::~GrabSend(){
-    stop = true;
-	Sleep(500);
+    stop = true; // main joined the loop before
 
 	if(socket != NULL) 
 	{
+		unmonitor_socket(socket);
 		socket->close();
 		delete socket;
 	}
 
+	if(stats_thread != NULL){
+		stats_thread->interrupt();
+		stats_thread->join();
+		delete stats_thread;
+	}
+	if(calibration != NULL) delete calibration;
+	if(sensors != NULL) delete sensors;
+
 	if(socket_watchdog != NULL) 
 	{
 		socket_watchdog->close();
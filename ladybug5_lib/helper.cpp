@@ -15,20 +15,6 @@ void jpegEncode(unsigned char* _compressedImage, unsigned long *_jpegSize, unsig
 
 
 
-unsigned int initBuffers(unsigned char** arpBuffers, unsigned int number, unsigned int width, unsigned int height, unsigned int dimensions){
-	//
-	// Initialize the pointers to NULL 
-	//
-    unsigned int size = width * height * dimensions;
-	std::cout << "Initialised arpBuffers with size: "<< size << " width: " << width << " height: " << height << std::endl;
-	for( unsigned int uiCamera = 0; uiCamera < LADYBUG_NUM_CAMERAS; uiCamera++ )
-	{
-		arpBuffers[ uiCamera ] = new unsigned char[ size ];
-	}
-    return size;
-}
-
-
 void initBuffersWitPicture(unsigned char** arpBuffers, long unsigned int* size){
 	//
 	// Initialize the pointers to NULL 
@@ -72,7 +58,7 @@ void compressImages(ladybug5_network::pbMessage *message, unsigned char* arpBuff
 
 void compressImageToMsg(ladybug5_network::pbMessage *message, zmq::message_t* zmq_msg, int i, TJPF color){
 	//encode to jpg
-    double t_now = clock();
+    double t_now = monotonic_us();
 	std::string status = "Compression";
 	unsigned char* _compressedImage = 0;
 	int JPEG_QUALITY = 85;
@@ -107,39 +93,62 @@ void compressImageToMsg(ladybug5_network::pbMessage *message, zmq::message_t* zm
 
 
 zmq::message_t compressImageToZmqMsg(ladybug5_network::pbMessage *message, zmq::message_t* zmq_msg, int i, TJPF color){
+	int img_width =  message->images(i).width();
+	int img_height =  message->images(i).height();
+
+	assert(zmq_msg->size()!=0);
+	return compressBufferToZmqMsg((unsigned char*)zmq_msg->data(), img_width, img_height, color);
+}
+
+zmq::message_t compressBufferToZmqMsg(unsigned char* buffer, int width, int height, TJPF color, int jpeg_quality){
 	//encode to jpg
-    double t_now = clock();
+    double t_now = monotonic_us();
 	std::string status = "Compression";
 	unsigned char* _compressedImage = 0;
-	int JPEG_QUALITY = 85;
-	
-	int img_width =  message->images(i).width();
-	int img_height =  message->images(i).height();
 	unsigned long img_Size = 0;
-	ladybug5_network::ImageType img_type = message->images(i).type();
 
-	unsigned char* pointer = (unsigned char*)zmq_msg->data();
-	assert(zmq_msg->size()!=0);
-	assert(img_width!=0);
-	assert(img_height!=0);
+	assert(width!=0);
+	assert(height!=0);
 	tjhandle _jpegCompressor = tjInitCompress();
-	tjCompress2(_jpegCompressor, pointer, img_width, 0, img_height, color,
-				&_compressedImage, &img_Size, TJSAMP_420, JPEG_QUALITY,
+	tjCompress2(_jpegCompressor, buffer, width, 0, height, color,
+				&_compressedImage, &img_Size, TJSAMP_420, jpeg_quality,
 				TJFLAG_FASTDCT);
 	tjDestroy(_jpegCompressor);
     _TIME
     status = "updating image message";
 	assert(img_Size!=0);
 
-    zmq::message_t img_out(img_Size);
-    memcpy(img_out.data(), _compressedImage, img_Size);
-
-	tjFree(_compressedImage);
+    /* zero copy, the TurboJPEG buffer is freed with the message */
+    zmq::message_t img_out;
+    MemoryBudget::instance().jpeg_message(&img_out, _compressedImage, img_Size);
+    Allocations::external(img_Size); // TurboJPEG output buffer, the message wraps it without a zmq buffer of its own
     //_TIME
     return img_out;
 }
 
 
+void scaleImage(const unsigned char* src, int width, int height, int pixel_size, unsigned int scale, unsigned char* dst){
+	int dst_width = width / scale;
+	int dst_height = height / scale;
+	unsigned int area = scale * scale;
+
+	for(int y = 0; y < dst_height; ++y){
+		unsigned char* out = dst + y * dst_width * pixel_size;
+		for(int x = 0; x < dst_width; ++x){
+			for(int c = 0; c < pixel_size; ++c){
+				unsigned int sum = 0;
+				for(unsigned int dy = 0; dy < scale; ++dy){
+					const unsigned char* in = src + ((y * scale + dy) * width + x * scale) * pixel_size + c;
+					for(unsigned int dx = 0; dx < scale; ++dx){
+						sum += in[dx * pixel_size];
+					}
+				}
+				*out++ = (unsigned char)(sum / area);
+			}
+		}
+	}
+}
+
 void addImageToMessage(ladybug5_network::pbMessage *message,  unsigned char* uncompressedBGRImageBuffer, TJPF color, ladybug5_network::LadybugTimeStamp *timestamp, ladybug5_network::ImageType img_type, int _width, int _height){
 	//encode to jpg
 	//const int COLOR_COMPONENTS = 4;
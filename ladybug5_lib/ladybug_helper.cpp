@@ -135,6 +135,12 @@ LadybugError startLadybug(LadybugContext context){
 	return error;
 }
 
+LadybugError restartLadybug(LadybugContext context){
+	// The calibration, the rendering setup and the alpha masks belong to the context and stay
+	ladybugStop( context ); // fails if the device already stopped itself
+	return startLadybug( context );
+}
+
 void ladybugImagetoDisk(LadybugImage *image, std::string filename){
     image->stippledFormat;
     image->dataFormat;
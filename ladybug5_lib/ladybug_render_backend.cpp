@@ -0,0 +1,38 @@
+#include "render_pipeline.h"
+#include "ladybug_helper.h"
+#include <stdio.h>
+
+/* Apart from render_pipeline.cpp: the benchmark builds the pipeline with the MockRenderBackend, without the configuration of the applications */
+LadybugRenderBackend::LadybugRenderBackend(LadybugContext render_context, LadybugContext convert_context)
+    : render_mutex(render_context == convert_context ? convert_mutex : own_render_mutex){
+    this->render_context = render_context;
+    this->convert_context = convert_context;
+}
+
+LadybugError
+LadybugRenderBackend::setup(){
+    boost::mutex::scoped_lock lock(render_mutex);
+    LadybugImageRenderingInfo graphics_info;
+    ladybugGetImageRenderingInfo(render_context, &graphics_info);
+    printf("Graphic info: %s\nRenderbuffer size: %i maxTextureSize %i\nMax viewport: width %i height %i\nmemory size %i\n", graphics_info.pszAdapterString,
+        graphics_info.uiMaxRenderbufferSize, graphics_info.uiMaxTextureSize, graphics_info.uiMaxViewPortWidth, graphics_info.uiMaxViewPortWidth, graphics_info.uiMemorySize);
+    return configureLadybugForPanoramic(render_context);
+}
+
+LadybugError
+LadybugRenderBackend::convert(LadybugImage* image, unsigned char** planes){
+    boost::mutex::scoped_lock lock(convert_mutex);
+    return ladybugConvertImage(convert_context, image, planes);
+}
+
+LadybugError
+LadybugRenderBackend::upload(unsigned char** planes){
+    boost::mutex::scoped_lock lock(render_mutex);
+    return ladybugUpdateTextures(render_context, LADYBUG_NUM_CAMERAS, (const unsigned char**)planes);
+}
+
+LadybugError
+LadybugRenderBackend::render(LadybugProcessedImage* pano){
+    boost::mutex::scoped_lock lock(render_mutex);
+    return ladybugRenderOffScreenImage(render_context, LADYBUG_PANORAMIC, LADYBUG_BGR, pano);
+}
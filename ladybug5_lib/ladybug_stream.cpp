@@ -40,7 +40,7 @@ void getColorOffset(LadybugImage *image, unsigned int& red_idx_offset, unsigned
         blue_idx_offset = 3;
         break;
     default:
-        throw new std::exception("getColorOffset, this image stippledFormat not implemted");
+        throw new std::runtime_error("getColorOffset, this image stippledFormat not implemted");
     }
 }
 
@@ -157,7 +157,7 @@ unsigned int getDataBitDepth(LadybugImage* image){
                 return 16;
                 break;
             default:
-                throw new std::exception("bit size can not be dettermined");
+                throw new std::runtime_error("bit size can not be dettermined");
      }
 }
 
@@ -177,7 +177,7 @@ unsigned int getDataBitDepth(LadybugProcessedImage* image){
 	case LADYBUG_BGR32F:
 		return 32; 
         default:
-            throw new std::exception("bit size can not be dettermined");
+            throw new std::runtime_error("bit size can not be dettermined");
      }
 }
 
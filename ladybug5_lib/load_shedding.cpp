@@ -0,0 +1,137 @@
+#include "load_shedding.h"
+#include "memory_budget.h"
+#include "output_profile.h"
+#include "metrics.h"
+#include <stdio.h>
+
+#define SHED_HOLD_FRAMES 8      /* frames between two steps up, the effect of a step needs time to reach the end */
+#define SHED_CALM_FRAMES 60     /* frames without lag before a step down */
+
+unsigned long long monotonic_us();
+
+LoadShedder::LoadShedder(){
+    lag_us.store(0);
+    reported_us.store(0);
+    target_us = 0;
+    essential_cameras = PROFILE_ALL_IMAGES;
+    scale = 2;
+    _level = SHED_NONE;
+    frames_at_level = 0;
+    frames = 0;
+    level_gauge = Metrics::instance().gauge("shed.level");
+    counters[SHED_NONE] = 0;
+    counters[SHED_PANORAMA] = Metrics::instance().counter("shed.panorama");
+    counters[SHED_RESOLUTION] = Metrics::instance().counter("shed.resolution");
+    counters[SHED_CAMERAS] = Metrics::instance().counter("shed.cameras");
+    counters[SHED_FRAMES] = Metrics::instance().counter("shed.frames");
+}
+
+LoadShedder&
+LoadShedder::instance(){
+    static LoadShedder shedder;
+    return shedder;
+}
+
+void
+LoadShedder::configure(unsigned int target_lag_ms, unsigned int essential_cameras, unsigned int scale){
+    target_us = (unsigned long long)target_lag_ms * 1000;
+    this->essential_cameras = essential_cameras & ~PROFILE_PANORAMIC;
+    this->scale = scale > 1 ? scale : 2;
+}
+
+void
+LoadShedder::report_lag(unsigned long long lag_us){
+    unsigned long long average = this->lag_us.load(boost::memory_order_relaxed);
+    this->lag_us.store(average == 0 ? lag_us : (average * 7 + lag_us) / 8, boost::memory_order_relaxed);
+    reported_us.store(monotonic_us(), boost::memory_order_relaxed);
+}
+
+bool
+LoadShedder::overloaded(unsigned long long now_us){
+    MemoryBudget& budget = MemoryBudget::instance();
+    if(budget.limit() > 0 && budget.in_use() * 4 > budget.limit() * 3){
+        return true;
+    }
+    /* without reports for a while nothing is in flight, an old lag does not count */
+    bool recent = now_us - reported_us.load(boost::memory_order_relaxed) < 2 * target_us;
+    return recent && lag_us.load(boost::memory_order_relaxed) > target_us;
+}
+
+bool
+LoadShedder::relaxed(unsigned long long now_us){
+    MemoryBudget& budget = MemoryBudget::instance();
+    if(budget.limit() > 0 && budget.in_use() * 2 > budget.limit()){
+        return false;
+    }
+    bool recent = now_us - reported_us.load(boost::memory_order_relaxed) < 2 * target_us;
+    return !recent || lag_us.load(boost::memory_order_relaxed) < target_us / 2;
+}
+
+unsigned int
+LoadShedder::apply(unsigned int wanted, unsigned int* scale){
+    *scale = 1;
+    if(target_us == 0 || wanted == 0) return wanted;
+
+    unsigned long long now_us = monotonic_us();
+    ++frames;
+    ++frames_at_level;
+    ShedLevel next = _level;
+    if(overloaded(now_us)){
+        if(_level < SHED_FRAMES && frames_at_level >= SHED_HOLD_FRAMES){
+            next = (ShedLevel)(_level + 1);
+        }
+    }else if(relaxed(now_us)){
+        if(_level > SHED_NONE && frames_at_level >= SHED_CALM_FRAMES){
+            next = (ShedLevel)(_level - 1);
+        }
+    }else{
+        frames_at_level = 0; // between the thresholds, hold the level
+    }
+    if(next != _level){
+        printf("Load shedding: %s -> %s, lag %.1f ms\n", shedLevelToString(_level).c_str(), shedLevelToString(next).c_str(),
+            lag_us.load(boost::memory_order_relaxed) / 1000.0);
+        Metrics::instance().add(level_gauge, (long long)next - _level);
+        _level = next;
+        frames_at_level = 0;
+    }
+
+    /* the levels below skip what this frame does not have */
+    if(_level >= SHED_FRAMES && frames % 2 == 0){
+        Metrics::instance().count(counters[SHED_FRAMES]); // every second frame, the rest still carries the essentials
+        return 0;
+    }
+    if(_level >= SHED_PANORAMA && (wanted & PROFILE_PANORAMIC)){
+        wanted &= ~PROFILE_PANORAMIC;
+        Metrics::instance().count(counters[SHED_PANORAMA]);
+    }
+    if(_level >= SHED_RESOLUTION){
+        *scale = this->scale;
+        Metrics::instance().count(counters[SHED_RESOLUTION]);
+    }
+    if(_level >= SHED_CAMERAS && (wanted & ~essential_cameras) != 0){
+        wanted &= essential_cameras;
+        Metrics::instance().count(counters[SHED_CAMERAS]);
+    }
+    return wanted;
+}
+
+ShedLevel
+LoadShedder::level(){
+    return _level;
+}
+
+std::string
+shedLevelToString(ShedLevel level){
+    switch(level){
+        case SHED_PANORAMA:
+            return "panorama";
+        case SHED_RESOLUTION:
+            return "resolution";
+        case SHED_CAMERAS:
+            return "cameras";
+        case SHED_FRAMES:
+            return "frames";
+        default:
+            return "none";
+    }
+}
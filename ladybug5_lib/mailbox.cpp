@@ -0,0 +1,68 @@
+#include "mailbox.h"
+#include "metrics.h"
+
+void free_parts(Parts& parts){
+    for(size_t i = 0; i < parts.size(); ++i){
+        delete parts[i];
+    }
+    parts.clear();
+}
+
+Mailbox::Mailbox(unsigned int slots){
+    this->slots.resize(slots > 0 ? slots : 1);
+    ids.resize(this->slots.size(), 0);
+    next = 0;
+    drops = Metrics::instance().counter("drops.mailbox");
+}
+
+void
+Mailbox::put(unsigned int slot, Parts& parts, unsigned long long id){
+    Parts replaced;
+    {
+        boost::mutex::scoped_lock lock(mutex);
+        if(slot >= slots.size()) slot = 0;
+        Parts& waiting = slots[slot];
+        if(!waiting.empty() && ids[slot] > id){
+            replaced.swap(parts); // a worker finished a newer frame first, this one is late
+        }else{
+            replaced.swap(waiting);
+            waiting.swap(parts);
+            ids[slot] = id;
+        }
+    }
+    filled.notify_one();
+    if(!replaced.empty()){
+        Metrics::instance().count(drops);
+        free_parts(replaced); // outside the lock, frees pool frames and budget
+    }
+}
+
+bool
+Mailbox::take(Parts& parts, unsigned int* slot, int timeout_ms){
+    free_parts(parts); // a frame the caller did not free
+    boost::system_time deadline = boost::get_system_time() + boost::posix_time::milliseconds(timeout_ms);
+    boost::mutex::scoped_lock lock(mutex);
+    while(true){
+        for(unsigned int i = 0; i < slots.size(); ++i){
+            unsigned int s = (next + i) % slots.size();
+            if(!slots[s].empty()){
+                parts.swap(slots[s]);
+                slots[s].clear();
+                next = (s + 1) % slots.size();
+                if(slot != NULL) *slot = s;
+                return true;
+            }
+        }
+        if(timeout_ms < 0){
+            filled.wait(lock);
+        }else if(!filled.timed_wait(lock, deadline)){
+            return false;
+        }
+    }
+}
+
+Mailbox::~Mailbox(){
+    for(size_t i = 0; i < slots.size(); ++i){
+        free_parts(slots[i]);
+    }
+}
@@ -0,0 +1,113 @@
+#include "memory_budget.h"
+#include "metrics.h"
+#include "allocations.h"
+#include "turbojpeg.h"
+#include <stdlib.h>
+#include <new>
+
+MemoryBudget::MemoryBudget(){
+    used.store(0);
+    _limit = 0;
+    policy = SHED_DROP;
+    wait_ms = 0;
+    gauge = Metrics::instance().gauge("inflight.bytes");
+}
+
+MemoryBudget&
+MemoryBudget::instance(){
+    /* never destroyed, zmq may free messages during shutdown */
+    static MemoryBudget* budget = new MemoryBudget();
+    return *budget;
+}
+
+void
+MemoryBudget::configure(unsigned long long limit_bytes, SheddingPolicy policy, unsigned int wait_ms){
+    boost::mutex::scoped_lock lock(mutex);
+    _limit = limit_bytes;
+    this->policy = policy;
+    this->wait_ms = wait_ms;
+}
+
+bool
+MemoryBudget::admit(unsigned long long bytes){
+    if(_limit == 0 || used.load(boost::memory_order_relaxed) + bytes <= _limit){
+        return true;
+    }
+    if(policy == SHED_WAIT && wait_ms > 0){
+        boost::system_time deadline = boost::get_system_time() + boost::posix_time::milliseconds(wait_ms);
+        boost::mutex::scoped_lock lock(mutex);
+        while(used.load(boost::memory_order_relaxed) + bytes > _limit){
+            if(!released.timed_wait(lock, deadline)) break;
+        }
+    }
+    return used.load(boost::memory_order_relaxed) + bytes <= _limit;
+}
+
+void
+MemoryBudget::charge(unsigned long long bytes){
+    used.fetch_add(bytes, boost::memory_order_relaxed);
+    Metrics::instance().add(gauge, (long long)bytes);
+}
+
+void
+MemoryBudget::release(unsigned long long bytes){
+    used.fetch_sub(bytes, boost::memory_order_relaxed);
+    Metrics::instance().add(gauge, -(long long)bytes);
+    if(policy == SHED_WAIT){
+        boost::mutex::scoped_lock lock(mutex); // no lost wakeup between the check and the wait in admit
+        released.notify_all();
+    }
+}
+
+void
+MemoryBudget::message(zmq::message_t* msg, size_t size){
+    void* data = malloc(size > 0 ? size : 1);
+    if(data == NULL) throw std::bad_alloc();
+    Allocations::external(size);
+    charge(size);
+    msg->rebuild(data, size, &MemoryBudget::free_message, (void*)size);
+}
+
+void
+MemoryBudget::jpeg_message(zmq::message_t* msg, unsigned char* data, size_t size){
+    charge(size);
+    msg->rebuild(data, size, &MemoryBudget::free_jpeg, (void*)size);
+}
+
+void
+MemoryBudget::free_message(void* data, void* hint){
+    free(data);
+    instance().release((size_t)hint);
+}
+
+void
+MemoryBudget::free_jpeg(void* data, void* hint){
+    tjFree((unsigned char*)data);
+    instance().release((size_t)hint);
+}
+
+unsigned long long
+MemoryBudget::in_use(){
+    return used.load(boost::memory_order_relaxed);
+}
+
+unsigned long long
+MemoryBudget::limit(){
+    return _limit;
+}
+
+SheddingPolicy
+sheddingPolicyFromString(const std::string& name){
+    if(name == "wait") return SHED_WAIT;
+    return SHED_DROP;
+}
+
+std::string
+sheddingPolicyToString(SheddingPolicy policy){
+    switch(policy){
+        case SHED_WAIT:
+            return "wait";
+        default:
+            return "drop";
+    }
+}
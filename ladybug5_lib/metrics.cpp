@@ -0,0 +1,343 @@
+#include "metrics.h"
+#include "timing.h"
+#include <stdio.h>
+#include <sstream>
+#include <boost/bind.hpp>
+
+boost::atomic<bool> Metrics::enabled(false);
+
+Histogram::Histogram(){
+    for(unsigned int i = 0; i < METRICS_BUCKETS; ++i){
+        counts[i].store(0, boost::memory_order_relaxed);
+    }
+    count.store(0, boost::memory_order_relaxed);
+    sum.store(0, boost::memory_order_relaxed);
+    max.store(0, boost::memory_order_relaxed);
+    allocations.store(0, boost::memory_order_relaxed);
+    allocated_bytes.store(0, boost::memory_order_relaxed);
+}
+
+void
+Histogram::record(unsigned long long value){
+    /* single writer: load and store instead of locked read-modify-write */
+    boost::atomic<unsigned long long>& slot = counts[bucket(value)];
+    slot.store(slot.load(boost::memory_order_relaxed) + 1, boost::memory_order_relaxed);
+    count.store(count.load(boost::memory_order_relaxed) + 1, boost::memory_order_relaxed);
+    sum.store(sum.load(boost::memory_order_relaxed) + value, boost::memory_order_relaxed);
+    if(value > max.load(boost::memory_order_relaxed)){
+        max.store(value, boost::memory_order_relaxed);
+    }
+}
+
+void
+Histogram::allocated(unsigned long long allocations, unsigned long long bytes){
+    this->allocations.store(this->allocations.load(boost::memory_order_relaxed) + allocations, boost::memory_order_relaxed);
+    allocated_bytes.store(allocated_bytes.load(boost::memory_order_relaxed) + bytes, boost::memory_order_relaxed);
+}
+
+unsigned int
+Histogram::bucket(unsigned long long value){
+    if(value < METRICS_LINEAR){
+        return (unsigned int)value;
+    }
+    unsigned int msb = 0;
+    for(unsigned long long v = value; v > 1; v >>= 1) ++msb;
+    unsigned int sub = (unsigned int)(value >> (msb - 3)) & (METRICS_SUB_BUCKETS - 1);
+    unsigned int index = METRICS_LINEAR + (msb - 4) * METRICS_SUB_BUCKETS + sub;
+    return index < METRICS_BUCKETS ? index : METRICS_BUCKETS - 1;
+}
+
+unsigned long long
+Histogram::bucket_value(unsigned int bucket){
+    if(bucket < METRICS_LINEAR){
+        return bucket;
+    }
+    unsigned int msb = (bucket - METRICS_LINEAR) / METRICS_SUB_BUCKETS + 4;
+    unsigned int sub = (bucket - METRICS_LINEAR) % METRICS_SUB_BUCKETS;
+    return (1ULL << msb) + ((unsigned long long)sub << (msb - 3));
+}
+
+HistogramSnapshot::HistogramSnapshot(){
+    counts.resize(METRICS_BUCKETS, 0);
+    count = 0;
+    sum = 0;
+    max = 0;
+    allocations = 0;
+    allocated_bytes = 0;
+}
+
+void
+HistogramSnapshot::add(const Histogram& histogram){
+    for(unsigned int i = 0; i < METRICS_BUCKETS; ++i){
+        counts[i] += histogram.counts[i].load(boost::memory_order_relaxed);
+    }
+    count += histogram.count.load(boost::memory_order_relaxed);
+    sum += histogram.sum.load(boost::memory_order_relaxed);
+    unsigned long long m = histogram.max.load(boost::memory_order_relaxed);
+    if(m > max) max = m;
+    allocations += histogram.allocations.load(boost::memory_order_relaxed);
+    allocated_bytes += histogram.allocated_bytes.load(boost::memory_order_relaxed);
+}
+
+void
+HistogramSnapshot::subtract(const HistogramSnapshot& earlier){
+    for(unsigned int i = 0; i < METRICS_BUCKETS; ++i){
+        counts[i] -= earlier.counts[i];
+    }
+    count -= earlier.count;
+    sum -= earlier.sum;
+    allocations -= earlier.allocations;
+    allocated_bytes -= earlier.allocated_bytes;
+}
+
+unsigned long long
+HistogramSnapshot::percentile(double p) const{
+    if(count == 0) return 0;
+    unsigned long long rank = (unsigned long long)(p / 100.0 * count);
+    unsigned long long seen = 0;
+    for(unsigned int i = 0; i < METRICS_BUCKETS; ++i){
+        seen += counts[i];
+        if(seen > rank){
+            if(i < METRICS_LINEAR || i == METRICS_BUCKETS - 1){
+                return Histogram::bucket_value(i);
+            }
+            return (Histogram::bucket_value(i) + Histogram::bucket_value(i + 1)) / 2; // middle of the bucket
+        }
+    }
+    return max;
+}
+
+double
+HistogramSnapshot::mean() const{
+    return count == 0 ? 0.0 : (double)sum / count;
+}
+
+MetricsSnapshot
+MetricsSnapshot::since(const MetricsSnapshot& earlier) const{
+    MetricsSnapshot interval = *this;
+    for(size_t i = 0; i < earlier.stages.size() && i < interval.stages.size(); ++i){
+        interval.stages[i].subtract(earlier.stages[i]);
+    }
+    for(size_t i = 0; i < earlier.counters.size() && i < interval.counters.size(); ++i){
+        interval.counters[i] -= earlier.counters[i];
+    }
+    return interval;
+}
+
+void
+MetricsSnapshot::print() const{
+    unsigned long long allocations = 0;
+    for(size_t i = 0; i < stages.size(); ++i){
+        allocations += stages[i].allocations;
+    }
+    printf("%-50s %8s %9s %9s %9s %9s", "stage", "count", "p50 ms", "p90 ms", "p99 ms", "max ms");
+    if(allocations > 0) printf(" %9s %11s", "allocs", "KB");
+    printf("\n");
+    for(size_t i = 0; i < stages.size(); ++i){
+        const HistogramSnapshot& h = stages[i];
+        if(h.count == 0) continue;
+        printf("%-50.50s %8llu %9.3f %9.3f %9.3f %9.3f", stage_names[i].c_str(), h.count,
+            h.percentile(50) / 1000.0, h.percentile(90) / 1000.0, h.percentile(99) / 1000.0, h.max / 1000.0);
+        if(allocations > 0) printf(" %9llu %11.1f", h.allocations, h.allocated_bytes / 1024.0);
+        printf("\n");
+    }
+    if(allocations > 0){
+        printf("%-50s %8.1f\n", "allocations per frame", allocations_per_frame());
+    }
+    for(size_t i = 0; i < counters.size(); ++i){
+        printf("%-50.50s %8llu\n", counter_names[i].c_str(), counters[i]);
+    }
+    for(size_t i = 0; i < gauges.size(); ++i){
+        printf("%-50.50s %8lld\n", gauge_names[i].c_str(), gauges[i]);
+    }
+}
+
+Metrics::ThreadMetrics::ThreadMetrics(){
+    for(unsigned int i = 0; i < METRICS_MAX_STAGES; ++i){
+        stages[i].store(NULL);
+    }
+    for(unsigned int i = 0; i < METRICS_MAX_COUNTERS; ++i){
+        counters[i].store(0);
+    }
+    for(unsigned int i = 0; i < METRICS_MAX_GAUGES; ++i){
+        gauges[i].store(0);
+    }
+}
+
+Metrics::Metrics() : _local(&Metrics::release){
+    reporter = NULL;
+}
+
+Metrics&
+Metrics::instance(){
+    static Metrics metrics;
+    return metrics;
+}
+
+unsigned int
+Metrics::stage(const std::string& name){
+    boost::mutex::scoped_lock lock(mutex);
+    for(size_t i = 0; i < stage_names.size(); ++i){
+        if(stage_names[i] == name) return i;
+    }
+    if(stage_names.size() == METRICS_MAX_STAGES){
+        return METRICS_MAX_STAGES - 1; // shared overflow stage
+    }
+    stage_names.push_back(name);
+    return stage_names.size() - 1;
+}
+
+unsigned int
+Metrics::counter(const std::string& name){
+    boost::mutex::scoped_lock lock(mutex);
+    for(size_t i = 0; i < counter_names.size(); ++i){
+        if(counter_names[i] == name) return i;
+    }
+    if(counter_names.size() == METRICS_MAX_COUNTERS){
+        return METRICS_MAX_COUNTERS - 1;
+    }
+    counter_names.push_back(name);
+    return counter_names.size() - 1;
+}
+
+unsigned int
+Metrics::gauge(const std::string& name){
+    boost::mutex::scoped_lock lock(mutex);
+    for(size_t i = 0; i < gauge_names.size(); ++i){
+        if(gauge_names[i] == name) return i;
+    }
+    if(gauge_names.size() == METRICS_MAX_GAUGES){
+        return METRICS_MAX_GAUGES - 1;
+    }
+    gauge_names.push_back(name);
+    return gauge_names.size() - 1;
+}
+
+Metrics::ThreadMetrics*
+Metrics::local(){
+    ThreadMetrics* metrics = _local.get();
+    if(metrics == NULL){
+        boost::mutex::scoped_lock lock(mutex);
+        if(unused.empty()){
+            metrics = new ThreadMetrics();
+            threads.push_back(metrics);
+        }else{
+            metrics = unused.back();
+            unused.pop_back();
+        }
+        _local.reset(metrics);
+    }
+    return metrics;
+}
+
+void
+Metrics::release(ThreadMetrics* metrics){
+    /* called on thread exit, keep the values for the next thread */
+    Metrics& self = instance();
+    boost::mutex::scoped_lock lock(self.mutex);
+    self.unused.push_back(metrics);
+}
+
+double
+MetricsSnapshot::allocations_per_frame() const{
+    unsigned long long allocations = 0;
+    for(size_t i = 0; i < stages.size(); ++i){
+        allocations += stages[i].allocations;
+    }
+    for(size_t i = 0; i < counters.size(); ++i){
+        if(counter_names[i] == "frames.grabbed"){
+            return counters[i] == 0 ? 0.0 : (double)allocations / counters[i];
+        }
+    }
+    return 0.0;
+}
+
+void
+Metrics::record(unsigned int stage, unsigned long long value_us, unsigned long long allocations, unsigned long long allocated_bytes){
+    if(!enabled.load(boost::memory_order_relaxed)) return;
+    ThreadMetrics* metrics = local();
+    Histogram* histogram = metrics->stages[stage].load(boost::memory_order_acquire);
+    if(histogram == NULL){
+        histogram = new Histogram();
+        metrics->stages[stage].store(histogram, boost::memory_order_release);
+    }
+    histogram->record(value_us);
+    if(allocations > 0){
+        histogram->allocated(allocations, allocated_bytes);
+    }
+}
+
+void
+Metrics::count(unsigned int counter, unsigned long long n){
+    if(!enabled.load(boost::memory_order_relaxed)) return;
+    boost::atomic<unsigned long long>& value = local()->counters[counter];
+    value.store(value.load(boost::memory_order_relaxed) + n, boost::memory_order_relaxed);
+}
+
+void
+Metrics::add(unsigned int gauge, long long delta){
+    if(!enabled.load(boost::memory_order_relaxed)) return;
+    boost::atomic<long long>& value = local()->gauges[gauge];
+    value.store(value.load(boost::memory_order_relaxed) + delta, boost::memory_order_relaxed);
+}
+
+MetricsSnapshot
+Metrics::snapshot(){
+    MetricsSnapshot snapshot;
+    boost::mutex::scoped_lock lock(mutex);
+    snapshot.time_us = monotonic_us();
+    snapshot.stage_names = stage_names;
+    snapshot.counter_names = counter_names;
+    snapshot.stages.resize(stage_names.size());
+    snapshot.counters.resize(counter_names.size(), 0);
+    snapshot.gauge_names = gauge_names;
+    snapshot.gauges.resize(gauge_names.size(), 0);
+    for(size_t t = 0; t < threads.size(); ++t){
+        for(size_t i = 0; i < stage_names.size(); ++i){
+            Histogram* histogram = threads[t]->stages[i].load(boost::memory_order_acquire);
+            if(histogram != NULL){
+                snapshot.stages[i].add(*histogram);
+            }
+        }
+        for(size_t i = 0; i < counter_names.size(); ++i){
+            snapshot.counters[i] += threads[t]->counters[i].load(boost::memory_order_relaxed);
+        }
+        for(size_t i = 0; i < gauge_names.size(); ++i){
+            snapshot.gauges[i] += threads[t]->gauges[i].load(boost::memory_order_relaxed);
+        }
+    }
+    return snapshot;
+}
+
+void
+Metrics::start_reporting(unsigned int interval_sec){
+    boost::mutex::scoped_lock lock(mutex);
+    if(interval_sec == 0 || reporter != NULL) return;
+    enabled = true;
+    reporter = new boost::thread(boost::bind(&Metrics::report, this, interval_sec));
+}
+
+void
+Metrics::report(unsigned int interval_sec){
+    MetricsSnapshot last = snapshot();
+    while(true){
+        boost::this_thread::sleep(boost::posix_time::seconds(interval_sec));
+        MetricsSnapshot now = snapshot();
+        printf("\n--- metrics, last %u sec ---\n", interval_sec);
+        now.since(last).print();
+        last = now;
+    }
+}
+
+static void
+register_stage(unsigned int* stage, const char* function, int line){
+    std::stringstream name;
+    name << function << ":" << line; // the status changes at a call site, the stage is created once
+    *stage = Metrics::instance().stage(name.str());
+}
+
+unsigned int
+metrics_stage(boost::once_flag& once, unsigned int& stage, const char* function, int line){
+    boost::call_once(once, boost::bind(register_stage, &stage, function, line));
+    return stage;
+}
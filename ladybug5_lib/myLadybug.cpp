@@ -63,9 +63,11 @@ ArpBuffer::ArpBuffer(unsigned int width, unsigned int height, unsigned int dimme
     this->size = width * height * dimmensions;
     this->nrBuffers = LADYBUG_NUM_CAMERAS;
 
+    unsigned int stride = (size + FRAME_POOL_ALIGNMENT - 1) / FRAME_POOL_ALIGNMENT * FRAME_POOL_ALIGNMENT;
+    slab = new Slab((size_t)stride * nrBuffers);
     for( unsigned int uiCamera = 0; uiCamera < nrBuffers; uiCamera++ )
 	{
-		buffers[ uiCamera ] = new unsigned char[ size ];
+		buffers[ uiCamera ] = slab->data + (size_t)uiCamera * stride;
 	}
 };
 
@@ -77,9 +79,7 @@ ArpBuffer::getBuffer(unsigned int bufferNr){
 };
 
 ArpBuffer::~ArpBuffer(){
-    for( unsigned int uiCamera = 0; uiCamera < nrBuffers; uiCamera++ ){ 
-		delete  [] buffers[ uiCamera ];	    
-    }
+    delete slab;
 };
 
 void 
@@ -118,6 +118,7 @@ Ladybug::Ladybug(){
     _stream = NULL;
     images_processed = false;
     initialised_processing = false;
+    calibrations_read = false;
 	rectified_images_width = 0;
 	rectified_image_height = 0;
 };
@@ -136,6 +137,16 @@ Ladybug::grabImage(LadybugImage* image){
     return error;
 }
 
+LadybugError
+Ladybug::restart(){
+    if(_stream != NULL){
+        return LADYBUG_FAILED; // nothing to restart, the stream is rebuilt with the context
+    }
+    ladybugStop( context ); // fails if the device already stopped itself
+    error = ladybugStart( context, config->cfg_ladybug_dataformat );
+    return error;
+}
+
 LadybugError
 Ladybug::initCamera()
 {    
@@ -207,6 +218,7 @@ Ladybug::initProcessing(unsigned int cols, unsigned int rows){
 	_ERROR
 
 	calculate_rectified_image_size(cols, rows);
+	calibrations_read = false; // read again for the new size
 
     //_buffer = new ArpBuffer(uiRawCols, uiRawRows, 4);
 
@@ -234,7 +246,8 @@ Ladybug::initProcessing(unsigned int cols, unsigned int rows){
 			error = set_rectification_image_size(rectified_images_width, rectified_image_height);
 			_ERROR
         }	   
-        error = ladybugInitializeAlphaMasks( context, rectified_images_width, rectified_image_height );
+        error = initializeAlphaMasksCached( context, config->cfg_processing_cache, caminfo.serialBase, rectified_images_width, rectified_image_height,
+            config->cfg_ladybug_colorProcessing, config->cfg_panoramic ? config->cfg_pano_width : 0, config->cfg_panoramic ? config->cfg_pano_hight : 0 );
         _ERROR;
     }
 
@@ -245,6 +258,9 @@ Ladybug::initProcessing(unsigned int cols, unsigned int rows){
 
 LadybugError
 Ladybug::set_rectification_image_size(unsigned int cols, unsigned int rows){
+	if((int)cols != rectified_images_width || (int)rows != rectified_image_height){
+		calibrations_read = false; // focal length and center are in pixels of the rectified images
+	}
 	 error = ladybugSetOffScreenImageSize(
                 context,
                 LADYBUG_ALL_RECTIFIED_IMAGES, 
@@ -326,26 +342,40 @@ Ladybug::start( bool init_processing ){
 LadybugError 
 Ladybug::getCameraCalibration(unsigned int camera_index, CameraCalibration* calibration){
     _ERROR
+    if(!calibrations_read){
+        error = readCameraCalibrations();
+        _ERROR
+    }
+    *calibration = calibrations[camera_index];
+    return error;
+}
+
+LadybugError 
+Ladybug::readCameraCalibrations(){
     if(!initialised_processing){ initProcessing(); };
 
 	error = set_rectification_image_size(rectified_images_width, rectified_image_height); // make sure we get the right informations
 	_ERROR
 
-    double extrinsics[6];
-    error = ladybugGetCameraUnitExtrinsics(context, camera_index, extrinsics);
-    _ERROR
-    calibration->rotationX = extrinsics[0];
-    calibration->rotationY = extrinsics[1];
-    calibration->rotationZ = extrinsics[2];
-    calibration->translationX = extrinsics[3];
-    calibration->translationY = extrinsics[4];
-    calibration->translationZ = extrinsics[5];
-
-    error = ladybugGetCameraUnitFocalLength(context, camera_index, &calibration->focal_lenght);
-    _ERROR
+    for( unsigned int camera_index = 0; camera_index < LADYBUG_NUM_CAMERAS; camera_index++ ){
+        CameraCalibration* calibration = &calibrations[camera_index];
+        double extrinsics[6];
+        error = ladybugGetCameraUnitExtrinsics(context, camera_index, extrinsics);
+        _ERROR
+        calibration->rotationX = extrinsics[0];
+        calibration->rotationY = extrinsics[1];
+        calibration->rotationZ = extrinsics[2];
+        calibration->translationX = extrinsics[3];
+        calibration->translationY = extrinsics[4];
+        calibration->translationZ = extrinsics[5];
+
+        error = ladybugGetCameraUnitFocalLength(context, camera_index, &calibration->focal_lenght);
+        _ERROR
        
-    error = ladybugGetCameraUnitImageCenter(context , camera_index, &calibration->centerX, &calibration->centerY);
-    _ERROR
+        error = ladybugGetCameraUnitImageCenter(context , camera_index, &calibration->centerX, &calibration->centerY);
+        _ERROR
+    }
+    calibrations_read = true;
     return error;
 }
 
@@ -0,0 +1,170 @@
+#include "output_profile.h"
+#include <sstream>
+#include <stdio.h>
+#include <stdlib.h>
+#include <boost/algorithm/string.hpp>
+
+/* Settings paths */
+const char* PATH_OUTPUT_PROFILES = "Output.Profiles";
+const char* PATH_PROFILE_PREFIX = "Profile_";
+
+OutputProfile::OutputProfile(std::string name, std::string endpoint){
+    this->name = name;
+    this->endpoint = endpoint;
+    images = PROFILE_ALL_IMAGES;
+    scale = 1;
+    jpeg_quality = 85;
+    rate_divisor = 1;
+}
+
+bool
+OutputProfile::wants_frame(unsigned int frame_nr) const{
+    return rate_divisor <= 1 || frame_nr % rate_divisor == 0;
+}
+
+bool
+OutputProfile::wants_image(unsigned int image_bit) const{
+    return (images & image_bit) != 0;
+}
+
+std::string
+OutputProfile::path(const char* key) const{
+    return std::string(PATH_PROFILE_PREFIX) + name + "." + key;
+}
+
+void
+OutputProfile::load(const boost::property_tree::ptree& pt){
+    endpoint = pt.get<std::string>(path("Endpoint"), endpoint);
+    set_cameras(pt.get<std::string>(path("Cameras"), get_cameras()));
+    scale = pt.get<unsigned int>(path("Scale"), scale);
+    jpeg_quality = pt.get<int>(path("Quality"), jpeg_quality);
+    rate_divisor = pt.get<unsigned int>(path("RateDivisor"), rate_divisor);
+
+    if(scale == 0) scale = 1;
+    if(rate_divisor == 0) rate_divisor = 1;
+    if(jpeg_quality < 1 || jpeg_quality > 100){
+        printf("Profile %s: jpeg quality %i out of range, using 85\n", name.c_str(), jpeg_quality);
+        jpeg_quality = 85;
+    }
+}
+
+std::string
+OutputProfile::get_cameras() const{
+    return imagesToString(images);
+}
+
+void
+OutputProfile::set_cameras(std::string cameras){
+    images = imagesFromString(cameras, "Profile " + name);
+}
+
+std::string
+imagesToString(unsigned int images){
+    std::stringstream ss;
+    for( unsigned int uiCamera = 0; uiCamera < LADYBUG_NUM_CAMERAS; uiCamera++ ){
+        if(images & (1 << uiCamera)){
+            if(ss.tellp() > 0) ss << ",";
+            ss << uiCamera;
+        }
+    }
+    if(images & PROFILE_PANORAMIC){
+        if(ss.tellp() > 0) ss << ",";
+        ss << "PANO";
+    }
+    return ss.str();
+}
+
+unsigned int
+imagesFromString(const std::string& cameras, const std::string& owner){
+    std::vector<std::string> tokens;
+    boost::split(tokens, cameras, boost::is_any_of(", "), boost::token_compress_on);
+
+    unsigned int images = 0;
+    for(size_t i = 0; i < tokens.size(); ++i){
+        std::string token = boost::to_upper_copy(tokens[i]);
+        if(token.empty()) continue;
+        if(token == "PANO" || token == "PANORAMIC"){
+            images |= PROFILE_PANORAMIC;
+        }
+        else{
+            unsigned int uiCamera = atoi(token.c_str());
+            if(uiCamera < LADYBUG_NUM_CAMERAS){
+                images |= 1 << uiCamera;
+            }
+            else{
+                printf("%s: unknown camera %s\n", owner.c_str(), token.c_str());
+            }
+        }
+    }
+    return images;
+}
+
+std::vector<OutputProfile>
+loadOutputProfiles(const boost::property_tree::ptree& pt, std::string default_endpoint){
+    std::vector<OutputProfile> profiles;
+    std::string names = pt.get<std::string>(PATH_OUTPUT_PROFILES, "default");
+
+    std::vector<std::string> tokens;
+    boost::split(tokens, names, boost::is_any_of(", "), boost::token_compress_on);
+    for(size_t i = 0; i < tokens.size(); ++i){
+        if(tokens[i].empty()) continue;
+
+        OutputProfile profile(tokens[i], default_endpoint);
+        profile.load(pt);
+        profiles.push_back(profile);
+    }
+
+    if(profiles.empty()){
+        profiles.push_back(OutputProfile("default", default_endpoint));
+    }
+    return profiles;
+}
+
+Outputs::Outputs(const std::vector<OutputProfile>& profiles){
+    this->profiles = profiles;
+    for(size_t i = 0; i < profiles.size(); ++i){
+        _subscribers.push_back(new Subscriptions());
+    }
+}
+
+unsigned int
+Outputs::size(){
+    return profiles.size();
+}
+
+Subscriptions*
+Outputs::subscribers(unsigned int profile){
+    return _subscribers.at(profile);
+}
+
+bool
+Outputs::has_subscribers(){
+    for(size_t i = 0; i < _subscribers.size(); ++i){
+        if(_subscribers[i]->has_subscribers()){
+            return true;
+        }
+    }
+    return false;
+}
+
+bool
+Outputs::active(unsigned int profile, unsigned int frame_nr){
+    return profiles[profile].wants_frame(frame_nr) && _subscribers[profile]->has_subscribers();
+}
+
+unsigned int
+Outputs::wanted_images(unsigned int frame_nr){
+    unsigned int images = 0;
+    for(size_t i = 0; i < profiles.size(); ++i){
+        if(active(i, frame_nr)){
+            images |= profiles[i].images;
+        }
+    }
+    return images;
+}
+
+Outputs::~Outputs(){
+    for(size_t i = 0; i < _subscribers.size(); ++i){
+        delete _subscribers[i];
+    }
+}
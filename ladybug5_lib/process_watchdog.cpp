@@ -0,0 +1,174 @@
+#include "process_watchdog.h"
+#include "metrics.h"
+#include "timing.h"
+#include <stdio.h>
+#include <string.h>
+#ifdef _WIN32
+#include <Windows.h>
+#include <psapi.h>
+#else
+#include <unistd.h>
+#endif
+
+/* Counters of frames that were dropped on the way to the output */
+static const char* frame_drops[] = { "drops.pool", "drops.budget", "drops.mailbox" };
+
+unsigned int
+current_process_id(){
+#ifdef _WIN32
+    return GetCurrentProcessId();
+#else
+    return getpid();
+#endif
+}
+
+static unsigned long long
+resident_bytes(){
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS memory;
+    if(!GetProcessMemoryInfo(GetCurrentProcess(), &memory, sizeof(memory))) return 0;
+    return memory.WorkingSetSize;
+#else
+    unsigned long long pages = 0, resident = 0;
+    FILE* statm = fopen("/proc/self/statm", "r");
+    if(statm == NULL) return 0;
+    if(fscanf(statm, "%llu %llu", &pages, &resident) != 2) resident = 0;
+    fclose(statm);
+    return resident * sysconf(_SC_PAGESIZE);
+#endif
+}
+
+ProcessWatchdog::ProcessWatchdog(zmq::context_t* zmq_context, const std::string& service, unsigned int timeout_ms, unsigned int health_interval_ms){
+    this->timeout_ms = timeout_ms;
+    this->health_interval_ms = service.empty() ? 0 : health_interval_ms;
+    holding = false;
+    missed = Metrics::instance().counter("watchdog.missed");
+
+    int val = 1;
+    loop = new zmq::socket_t(*zmq_context, ZMQ_PULL);
+    loop->setsockopt(ZMQ_RCVHWM, &val, sizeof(val));  //prevent buffer get overfilled
+    loop->setsockopt(ZMQ_SNDHWM, &val, sizeof(val));
+    loop->bind(WATCHDOG_ENDPOINT);
+
+    this->service = NULL;
+    if(!service.empty()){
+        int linger = 0;
+        this->service = new zmq::socket_t(*zmq_context, ZMQ_PUSH);
+        this->service->setsockopt(ZMQ_SNDHWM, &val, sizeof(val)); // only the latest heartbeat matters
+        this->service->setsockopt(ZMQ_LINGER, &linger, sizeof(linger));
+        this->service->connect(service.c_str());
+    }
+
+    latency_stage = 0;
+    last_metrics = NULL;
+    if(this->health_interval_ms > 0){
+        Metrics::enabled = true; // the counters of the report
+        latency_stage = Metrics::instance().stage(HEALTH_LATENCY_STAGE);
+        last_metrics = new MetricsSnapshot(Metrics::instance().snapshot());
+    }
+    last_health_us = monotonic_us();
+}
+
+ProcessWatchdog::~ProcessWatchdog(){
+    loop->close();
+    delete loop;
+    if(service != NULL){
+        service->close();
+        delete service;
+    }
+    delete last_metrics;
+}
+
+bool
+ProcessWatchdog::wait(){
+    zmq::pollitem_t items[] = { { *loop, 0, ZMQ_POLLIN, 0 } };
+    zmq::poll(&items[0], 1, holding ? -1 : (long)timeout_ms);
+    if(!(items[0].revents & ZMQ_POLLIN)){
+        Metrics::instance().count(missed);
+        return false;
+    }
+    zmq::message_t msg;
+    HeartbeatState state = HEARTBEAT_RUNNING;
+    while(loop->recv(&msg, ZMQ_NOBLOCK)){ // the latest one counts
+        state = msg.size() > 0 ? HEARTBEAT_STARTING : HEARTBEAT_RUNNING;
+    }
+    holding = state == HEARTBEAT_STARTING;
+    report(state);
+    if(health_interval_ms > 0 && !holding && monotonic_us() - last_health_us >= health_interval_ms * 1000ULL){
+        report_health();
+    }
+    return true;
+}
+
+void
+ProcessWatchdog::starting(){
+    holding = false; // the rebuilt loop sends its own heartbeats
+    report(HEARTBEAT_STARTING);
+}
+
+void
+ProcessWatchdog::run(){
+    bool late = false;
+    while(true){
+        bool alive = wait();
+        if(!alive && !late){
+            printf("Watchdog: no heartbeat for %u ms\n", timeout_ms);
+        }
+        late = !alive;
+    }
+}
+
+void
+ProcessWatchdog::report(HeartbeatState state){
+    if(service == NULL) return;
+    HeartbeatMessage heartbeat;
+    heartbeat.process_id = current_process_id();
+    heartbeat.state = state;
+    send(&heartbeat, sizeof(heartbeat));
+}
+
+void
+ProcessWatchdog::report_health(){
+    MetricsSnapshot now = Metrics::instance().snapshot();
+    MetricsSnapshot interval = now.since(*last_metrics);
+    double seconds = (now.time_us - last_metrics->time_us) / 1000000.0;
+    *last_metrics = now;
+    last_health_us = now.time_us;
+
+    unsigned long long delivered = 0, grabbed = 0, dropped = 0;
+    for(size_t i = 0; i < interval.counter_names.size(); ++i){
+        const std::string& name = interval.counter_names[i];
+        if(name == "frames.delivered" || name == "frames.paused") delivered += interval.counters[i]; // a paused process is healthy
+        if(name == "frames.grabbed") grabbed = interval.counters[i];
+        for(size_t d = 0; d < sizeof(frame_drops) / sizeof(frame_drops[0]); ++d){
+            if(name == frame_drops[d]) dropped += interval.counters[i];
+        }
+    }
+
+    HealthMessage health;
+    health.process_id = current_process_id();
+    health.p99_latency_us = latency_stage < interval.stages.size() ? (unsigned int)interval.stages[latency_stage].percentile(99) : 0;
+    health.fps = seconds > 0 ? (float)(delivered / seconds) : 0;
+    health.drop_rate = grabbed > 0 ? (float)dropped / grabbed : 0;
+    health.rss_bytes = resident_bytes();
+    send(&health, sizeof(health));
+}
+
+void
+ProcessWatchdog::send(const void* data, size_t size){
+    if(service == NULL) return;
+    zmq::message_t msg(size);
+    memcpy(msg.data(), data, size);
+    try{
+        service->send(msg, ZMQ_NOBLOCK); // without a service the report is dropped
+    }catch(zmq::error_t& e){
+        printf("Watchdog: report not sent, %s\n", e.what());
+    }
+}
+
+void
+watchdog_starting(zmq::socket_t* socket_watchdog){
+    zmq::message_t msg(strlen(WATCHDOG_STARTING));
+    memcpy(msg.data(), WATCHDOG_STARTING, msg.size());
+    socket_watchdog->send(msg);
+}
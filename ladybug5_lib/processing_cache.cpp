@@ -0,0 +1,212 @@
+#include "processing_cache.h"
+#include <stdio.h>
+#include <fstream>
+#include <sstream>
+#include <boost/filesystem.hpp>
+#include <boost/algorithm/string/predicate.hpp>
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+
+#define MANIFEST_NAME "manifest.txt"
+#define MANIFEST_VERSION 1
+#define ALPHA_MASK_EXTENSION ".pgm"
+#define LAST_NAME "last.txt"
+
+namespace fs = boost::filesystem;
+
+ProcessingCache::ProcessingCache(const std::string& directory, const std::string& key){
+    entry = (fs::path(directory) / key).string();
+}
+
+std::string
+ProcessingCache::key(unsigned int serial, unsigned int cols, unsigned int rows,
+        LadybugColorProcessingMethod color_processing, unsigned int pano_width, unsigned int pano_height){
+    std::ostringstream key;
+    key << serial << "_" << cols << "x" << rows << "_c" << (int)color_processing << "_p" << pano_width << "x" << pano_height;
+    return key.str();
+}
+
+void
+ProcessingCache::remember(const std::string& directory, unsigned int serial, unsigned int cols, unsigned int rows){
+    std::ofstream file((fs::path(directory) / LAST_NAME).string().c_str());
+    file << serial << " " << cols << " " << rows << "\n";
+}
+
+bool
+ProcessingCache::last(const std::string& directory, unsigned int* serial, unsigned int* cols, unsigned int* rows){
+    std::ifstream file((fs::path(directory) / LAST_NAME).string().c_str());
+    return (file >> *serial >> *cols >> *rows) && *cols > 0 && *rows > 0;
+}
+
+bool
+ProcessingCache::is_alpha_mask(const std::string& name){
+    return boost::algorithm::iends_with(name, ALPHA_MASK_EXTENSION) && fs::path(name).filename().string() == name;
+}
+
+bool
+ProcessingCache::checksum(const std::string& path, Artifact* artifact){
+    try{
+        artifact->size = fs::file_size(path);
+        artifact->checksum = 14695981039346656037ULL;
+        if(artifact->size == 0) return true;
+        boost::interprocess::file_mapping file(path.c_str(), boost::interprocess::read_only);
+        boost::interprocess::mapped_region region(file, boost::interprocess::read_only);
+        const unsigned char* data = (const unsigned char*)region.get_address();
+        for(size_t i = 0; i < region.get_size(); ++i){
+            artifact->checksum ^= data[i];
+            artifact->checksum *= 1099511628211ULL;
+        }
+        return true;
+    }catch(std::exception& e){
+        printf("Processing cache: can not read %s: %s\n", path.c_str(), e.what());
+        return false;
+    }
+}
+
+bool
+ProcessingCache::read_manifest(Manifest* manifest){
+    std::ifstream file((fs::path(entry) / MANIFEST_NAME).string().c_str());
+    int version = 0;
+    if(!(file >> version) || version != MANIFEST_VERSION) return false;
+    Artifact artifact;
+    std::string name;
+    while(file >> std::hex >> artifact.checksum >> std::dec >> artifact.size && std::getline(file >> std::ws, name)){
+        if(!is_alpha_mask(name)){
+            printf("Processing cache: %s in the manifest is no alpha mask, ignored\n", name.c_str());
+            continue;
+        }
+        (*manifest)[name] = artifact;
+    }
+    return !manifest->empty();
+}
+
+bool
+ProcessingCache::write_manifest(const Manifest& manifest){
+    fs::path path = fs::path(entry) / MANIFEST_NAME;
+    fs::path temporary = fs::path(entry) / (MANIFEST_NAME ".tmp");
+    {
+        std::ofstream file(temporary.string().c_str());
+        file << MANIFEST_VERSION << "\n";
+        for(Manifest::const_iterator i = manifest.begin(); i != manifest.end(); ++i){
+            file << std::hex << i->second.checksum << std::dec << " " << i->second.size << " " << i->first << "\n";
+        }
+        if(!file) return false;
+    }
+    boost::system::error_code error;
+    fs::rename(temporary, path, error); // a crash leaves the old manifest or the new one, never half of it
+    return !error;
+}
+
+void
+ProcessingCache::invalidate(){
+    boost::system::error_code error;
+    fs::remove(fs::path(entry) / MANIFEST_NAME, error);
+}
+
+bool
+ProcessingCache::restore(){
+    Manifest manifest;
+    bool valid = read_manifest(&manifest);
+    for(Manifest::iterator i = manifest.begin(); valid && i != manifest.end(); ++i){
+        Artifact cached;
+        valid = checksum((fs::path(entry) / i->first).string(), &cached)
+            && cached.size == i->second.size && cached.checksum == i->second.checksum;
+        if(!valid){
+            printf("Processing cache: %s does not match the manifest, dropping %s\n", i->first.c_str(), entry.c_str());
+            invalidate();
+        }
+    }
+    if(valid){
+        for(Manifest::iterator i = manifest.begin(); i != manifest.end(); ++i){
+            Artifact current;
+            if(fs::exists(i->first) && checksum(i->first, &current) && current.checksum == i->second.checksum && current.size == i->second.size){
+                continue; // already in place
+            }
+            boost::system::error_code error;
+            fs::copy_file(fs::path(entry) / i->first, i->first, fs::copy_option::overwrite_if_exists, error);
+            if(error){
+                printf("Processing cache: can not restore %s: %s\n", i->first.c_str(), error.message().c_str());
+                valid = false;
+            }
+        }
+    }
+    /* what the initialization writes is compared against this */
+    before.clear();
+    for(fs::directory_iterator i(fs::current_path()); i != fs::directory_iterator(); ++i){
+        if(fs::is_regular_file(i->status()) && is_alpha_mask(i->path().filename().string())){
+            before[i->path().filename().string()] = std::make_pair((unsigned long long)fs::file_size(i->path()), (long long)fs::last_write_time(i->path()));
+        }
+    }
+    printf("Processing cache %s: %s\n", entry.c_str(), valid ? "hit" : "miss");
+    return valid;
+}
+
+void
+ProcessingCache::store(){
+    Manifest manifest;
+    read_manifest(&manifest);
+    bool changed = false;
+    boost::system::error_code error;
+    for(fs::directory_iterator i(fs::current_path()); i != fs::directory_iterator(); ++i){
+        if(!fs::is_regular_file(i->status())) continue;
+        std::string name = i->path().filename().string();
+        if(!is_alpha_mask(name)) continue; // logs and configurations written meanwhile are not the SDK's
+        std::map<std::string, std::pair<unsigned long long, long long> >::iterator old = before.find(name);
+        if(old != before.end() && old->second.first == fs::file_size(i->path()) && old->second.second == (long long)fs::last_write_time(i->path())){
+            continue; // not written by the initialization
+        }
+        Artifact artifact;
+        if(!checksum(i->path().string(), &artifact)) continue;
+        fs::create_directories(entry, error);
+        fs::copy_file(i->path(), fs::path(entry) / name, fs::copy_option::overwrite_if_exists, error);
+        if(error){
+            printf("Processing cache: can not store %s: %s\n", name.c_str(), error.message().c_str());
+            continue;
+        }
+        manifest[name] = artifact;
+        changed = true;
+    }
+    if(changed && write_manifest(manifest)){
+        printf("Processing cache %s: stored %u files\n", entry.c_str(), (unsigned int)manifest.size());
+    }
+}
+
+LadybugError
+initializeAlphaMasksCached(LadybugContext context, const std::string& cache_directory, unsigned int serial,
+        unsigned int cols, unsigned int rows, LadybugColorProcessingMethod color_processing, unsigned int pano_width, unsigned int pano_height){
+    if(cache_directory.empty()){
+        return ladybugInitializeAlphaMasks(context, cols, rows);
+    }
+    ProcessingCache cache(cache_directory, ProcessingCache::key(serial, cols, rows, color_processing, pano_width, pano_height));
+    try{
+        cache.restore();
+    }catch(std::exception& e){
+        printf("Processing cache: %s\n", e.what()); // the SDK generates the masks as without cache
+    }
+    LadybugError error = ladybugInitializeAlphaMasks(context, cols, rows);
+    if(error == LADYBUG_OK){
+        try{
+            cache.store(); // on a hit only if the SDK rewrote a file
+            ProcessingCache::remember(cache_directory, serial, cols, rows);
+        }catch(std::exception& e){
+            printf("Processing cache: %s\n", e.what());
+        }
+    }
+    return error;
+}
+
+bool
+prepareAlphaMasksCached(const std::string& cache_directory, LadybugColorProcessingMethod color_processing,
+        unsigned int pano_width, unsigned int pano_height, unsigned int* cols, unsigned int* rows){
+    unsigned int serial;
+    if(cache_directory.empty() || !ProcessingCache::last(cache_directory, &serial, cols, rows)){
+        return false;
+    }
+    try{
+        ProcessingCache cache(cache_directory, ProcessingCache::key(serial, *cols, *rows, color_processing, pano_width, pano_height));
+        cache.restore(); // initializeAlphaMasksCached finds the files in place
+    }catch(std::exception& e){
+        printf("Processing cache: %s\n", e.what());
+    }
+    return true;
+}
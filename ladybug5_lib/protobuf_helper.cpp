@@ -8,9 +8,27 @@ bool pb_send(zmq::socket_t* socket, const ladybug5_network::pbMessage* pb_messag
 	// create and send the zmq message
 	zmq::message_t request (pb_serialized.size());
 	memcpy ((void *) request.data (), pb_serialized.c_str(), pb_serialized.size());
+	Allocations::zmq_message(pb_serialized.size());
 	return socket->send(request, flag);
 }
 
+bool pb_send(zmq::socket_t* socket, const ladybug5_network::pbMessage* pb_message, const ladybug5_network::pbMessageExtension* extension, int flag){
+	zmq::message_t request;
+	pb_serialize(&request, pb_message, extension);
+	return socket->send(request, flag);
+}
+
+void pb_serialize(zmq::message_t* msg, const ladybug5_network::pbMessage* pb_message, const ladybug5_network::pbMessageExtension* extension){
+	// concatenated messages are merged by the parser, pbMessage keeps the extension as unknown fields
+	std::string pb_serialized;
+	pb_message->SerializeToString(&pb_serialized);
+	extension->AppendToString(&pb_serialized);
+
+	msg->rebuild(pb_serialized.size());
+	memcpy (msg->data(), pb_serialized.c_str(), pb_serialized.size());
+	Allocations::zmq_message(pb_serialized.size());
+}
+
 bool pb_recv(zmq::socket_t* socket, ladybug5_network::pbMessage* pb_message){
 	
 	zmq::message_t zmq_msg;
@@ -19,6 +37,19 @@ bool pb_recv(zmq::socket_t* socket, ladybug5_network::pbMessage* pb_message){
 	return result;
 }
 
+bool pb_recv(zmq::socket_t* socket, ladybug5_network::pbMessage* pb_message, ladybug5_network::pbMessageExtension* extension){
+	zmq::message_t zmq_msg;
+	bool result = socket->recv(&zmq_msg);
+	pb_parse(zmq_msg, pb_message, extension);
+	return result;
+}
+
+bool pb_parse(zmq::message_t& msg, ladybug5_network::pbMessage* pb_message, ladybug5_network::pbMessageExtension* extension){
+	bool result = pb_message->ParseFromArray(msg.data(), msg.size());
+	extension->ParseFromArray(msg.data(), msg.size()); // same bytes, each parser skips the fields of the other
+	return result;
+}
+
 
 
 std::string enumToString(ladybug5_network::ImageType type){
@@ -45,12 +76,6 @@ std::string enumToString(ladybug5_network::ImageType type){
 }
 
 void prefill_sensordata( ladybug5_network::pbMessage& message, LadybugImage &image){
-		ladybug5_network::pbFloatTriblet gyro;
-		ladybug5_network::pbFloatTriblet accelerometer;
-		ladybug5_network::pbFloatTriblet compass;
-		ladybug5_network::pbSensor sensor;
-		ladybug5_network::LadybugTimeStamp msg_timestamp;
-
 		/* Create and fill protobuf message */
         message.set_name("windows");
 	    message.set_camera("ladybug5");
@@ -59,32 +84,34 @@ void prefill_sensordata( ladybug5_network::pbMessage& message, LadybugImage &ima
         message.set_serial_number(std::to_string(image.imageInfo.ulSerialNum));
 
         /* read the sensor data */        
-        accelerometer.set_x(image.imageHeader.accelerometer.x);
-        accelerometer.set_y(image.imageHeader.accelerometer.y);
-        accelerometer.set_z(image.imageHeader.accelerometer.z);
-        sensor.set_allocated_accelerometer(new ladybug5_network::pbFloatTriblet(accelerometer));
+        fill_sensordata(message.mutable_sensors(), image);
+        fill_timestamp(message.mutable_time(), image);
+}
+
+void fill_sensordata( ladybug5_network::pbSensor* sensor, LadybugImage &image){
+        sensor->mutable_accelerometer()->set_x(image.imageHeader.accelerometer.x);
+        sensor->mutable_accelerometer()->set_y(image.imageHeader.accelerometer.y);
+        sensor->mutable_accelerometer()->set_z(image.imageHeader.accelerometer.z);
  
-        compass.set_x(image.imageHeader.compass.x);
-        compass.set_y(image.imageHeader.compass.y);
-        compass.set_z(image.imageHeader.compass.z);
-        sensor.set_allocated_compass(new ladybug5_network::pbFloatTriblet(compass));
-
-        gyro.set_x(image.imageHeader.gyroscope.x);
-        gyro.set_y(image.imageHeader.gyroscope.y);
-        gyro.set_z(image.imageHeader.gyroscope.z);
-        sensor.set_allocated_gyroscope(new ladybug5_network::pbFloatTriblet(gyro));
-
-        sensor.set_humidity(image.imageHeader.uiHumidity);
-        sensor.set_barometer(image.imageHeader.uiAirPressure);
-        sensor.set_temperature(image.imageHeader.uiTemperature);
-        message.set_allocated_sensors(new ladybug5_network::pbSensor(sensor));         
-		
-	    msg_timestamp.set_ulcyclecount(image.timeStamp.ulCycleCount);
-	    msg_timestamp.set_ulcycleoffset(image.timeStamp.ulCycleOffset);
-	    msg_timestamp.set_ulcycleseconds(image.timeStamp.ulCycleSeconds);
-	    msg_timestamp.set_ulmicroseconds(image.timeStamp.ulMicroSeconds);
-	    msg_timestamp.set_ulseconds(image.timeStamp.ulSeconds);
-        message.set_allocated_time(new ladybug5_network::LadybugTimeStamp(msg_timestamp));
+        sensor->mutable_compass()->set_x(image.imageHeader.compass.x);
+        sensor->mutable_compass()->set_y(image.imageHeader.compass.y);
+        sensor->mutable_compass()->set_z(image.imageHeader.compass.z);
+
+        sensor->mutable_gyroscope()->set_x(image.imageHeader.gyroscope.x);
+        sensor->mutable_gyroscope()->set_y(image.imageHeader.gyroscope.y);
+        sensor->mutable_gyroscope()->set_z(image.imageHeader.gyroscope.z);
+
+        sensor->set_humidity(image.imageHeader.uiHumidity);
+        sensor->set_barometer(image.imageHeader.uiAirPressure);
+        sensor->set_temperature(image.imageHeader.uiTemperature);
+}
+
+void fill_timestamp( ladybug5_network::LadybugTimeStamp* timestamp, LadybugImage &image){
+	    timestamp->set_ulcyclecount(image.timeStamp.ulCycleCount);
+	    timestamp->set_ulcycleoffset(image.timeStamp.ulCycleOffset);
+	    timestamp->set_ulcycleseconds(image.timeStamp.ulCycleSeconds);
+	    timestamp->set_ulmicroseconds(image.timeStamp.ulMicroSeconds);
+	    timestamp->set_ulseconds(image.timeStamp.ulSeconds);
 }
 
 void send_image( unsigned int index, LadybugImage *image, zmq::socket_t *socket, int flag){
@@ -98,5 +125,6 @@ void send_image( unsigned int index, LadybugImage *image, zmq::socket_t *socket,
 	//RGB expected at reciever
 	zmq::message_t zmq_image(image_size);
 	memcpy(zmq_image.data(), image_data, image_size);
+	Allocations::zmq_message(image_size);
 	socket->send(zmq_image, flag ); 
 }
\ No newline at end of file
@@ -0,0 +1,102 @@
+#include "recovery.h"
+#include "metrics.h"
+#include "timing.h"
+#include <stdio.h>
+
+RecoveryTier
+recoveryTier(LadybugError error){
+    switch(error){
+    case LADYBUG_TIMEOUT:           /* no frame within the grab timeout, e.g. a bus hiccup */
+    case LADYBUG_IMAGE_NOT_READY:
+    case LADYBUG_OVERFLOW:          /* frames were dropped, the next one is complete */
+        return RECOVER_RETRY;
+    case LADYBUG_FAILED:
+    case LADYBUG_NOT_STARTED:       /* the device stopped streaming */
+        return RECOVER_CAMERA;
+    default:                        /* device removed, out of memory, ... */
+        return RECOVER_CONTEXT;
+    }
+}
+
+std::string
+recoveryTierToString(RecoveryTier tier){
+    switch(tier){
+    case RECOVER_RETRY:     return "retry";
+    case RECOVER_SOCKET:    return "socket";
+    case RECOVER_CAMERA:    return "camera";
+    case RECOVER_CONTEXT:   return "context";
+    default:                return "unknown";
+    }
+}
+
+Recovery::Recovery(unsigned int retries, unsigned int max_backoff_ms){
+    this->retries = retries;
+    this->max_backoff_ms = max_backoff_ms;
+    failures = 0;
+    restarts = 0;
+    rebuilds = 0;
+    recovering = false;
+    tier = RECOVER_RETRY;
+    begin_us = 0;
+    for(unsigned int i = 0; i < RECOVERY_TIERS; ++i){
+        std::string name = recoveryTierToString((RecoveryTier)i);
+        counters[i] = Metrics::instance().counter("recovery." + name);
+        stages[i] = Metrics::instance().stage("recovery " + name);
+    }
+}
+
+RecoveryTier
+Recovery::escalate(LadybugError error){
+    RecoveryTier wanted = recoveryTier(error);
+    if(wanted == RECOVER_RETRY && ++failures > retries){
+        wanted = RECOVER_CAMERA; // not transient after all
+    }
+    if(wanted == RECOVER_CAMERA && restarts >= RECOVERY_CAMERA_RESTARTS){
+        wanted = RECOVER_CONTEXT; // the restarts do not bring frames back
+    }
+    return wanted;
+}
+
+void
+Recovery::begin(RecoveryTier tier){
+    Metrics::instance().count(counters[tier]);
+    if(tier != RECOVER_RETRY){
+        printf("Recovering: %s\n", recoveryTierToString(tier).c_str());
+    }
+    if(!recovering){
+        recovering = true;
+        begin_us = monotonic_us();
+        this->tier = tier;
+    }else if(tier > this->tier){
+        this->tier = tier;
+    }
+    if(tier == RECOVER_CAMERA){
+        ++restarts;
+        failures = 0; // the restarted camera gets its retries again
+    }
+    if(tier == RECOVER_CONTEXT){
+        ++rebuilds;
+    }
+}
+
+void
+Recovery::recovered(){
+    failures = 0;
+    if(!recovering) return;
+    recovering = false;
+    restarts = 0;
+    rebuilds = 0;
+    unsigned long long took_us = monotonic_us() - begin_us;
+    Metrics::instance().record(stages[tier], took_us);
+    if(tier != RECOVER_RETRY){
+        printf("Recovered (%s) in %llu ms\n", recoveryTierToString(tier).c_str(), took_us / 1000);
+    }
+}
+
+unsigned int
+Recovery::backoff_ms(){
+    unsigned int attempts = restarts + rebuilds;
+    if(attempts <= 1) return 0;
+    unsigned long long wait_ms = 100ULL << (attempts - 2 < 16 ? attempts - 2 : 16);
+    return wait_ms < max_backoff_ms ? (unsigned int)wait_ms : max_backoff_ms;
+}
@@ -0,0 +1,246 @@
+#include "render_pipeline.h"
+#include "memory_budget.h"
+#include "metrics.h"
+#include "helper.h"
+#include "timing.h"
+#include <string.h>
+
+MockRenderBackend::MockRenderBackend(unsigned int pano_width, unsigned int pano_height, unsigned int plane_size,
+        unsigned int convert_us, unsigned int upload_us, unsigned int render_us){
+    this->pano_width = pano_width;
+    this->pano_height = pano_height;
+    this->plane_size = plane_size;
+    this->convert_us = convert_us;
+    this->upload_us = upload_us;
+    this->render_us = render_us;
+    frame = 0;
+    /* gradients, encodes like a scene rather than a flat color */
+    pano.resize(pano_width * pano_height * 3);
+    for(unsigned int y = 0; y < pano_height; ++y){
+        for(unsigned int x = 0; x < pano_width; ++x){
+            unsigned char* pixel = &pano[(y * pano_width + x) * 3];
+            pixel[0] = (unsigned char)(x * 255 / pano_width);
+            pixel[1] = (unsigned char)(y * 255 / pano_height);
+            pixel[2] = (unsigned char)((x ^ y) & 0xff);
+        }
+    }
+}
+
+LadybugError
+MockRenderBackend::convert(LadybugImage* image, unsigned char** planes){
+    unsigned long long end_us = monotonic_us() + convert_us;
+    for(unsigned int camera = 0; camera < LADYBUG_NUM_CAMERAS; ++camera){
+        for(unsigned int offset = 0; offset < plane_size; offset += 4096){
+            planes[camera][offset] = (unsigned char)frame; // every page is written like by the debayering
+        }
+    }
+    while(monotonic_us() < end_us){} // the debayering keeps the core busy
+    return LADYBUG_OK;
+}
+
+LadybugError
+MockRenderBackend::upload(unsigned char** planes){
+    boost::this_thread::sleep(boost::posix_time::microseconds(upload_us)); // DMA to the graphics card, the CPU is free
+    return LADYBUG_OK;
+}
+
+LadybugError
+MockRenderBackend::render(LadybugProcessedImage* pano){
+    boost::this_thread::sleep(boost::posix_time::microseconds(render_us)); // the GPU stitches
+    this->pano[0] = (unsigned char)frame++;
+    pano->uiCols = pano_width;
+    pano->uiRows = pano_height;
+    pano->pData = &this->pano[0];
+    pano->pixelFormat = LADYBUG_BGR;
+    return LADYBUG_OK;
+}
+
+RenderPipeline::SlotQueue::SlotQueue(){
+    closed = false;
+}
+
+void
+RenderPipeline::SlotQueue::push(Slot* slot){
+    boost::mutex::scoped_lock lock(mutex);
+    slots.push_back(slot);
+    filled.notify_one();
+}
+
+RenderPipeline::Slot*
+RenderPipeline::SlotQueue::pop(int timeout_ms){
+    boost::mutex::scoped_lock lock(mutex);
+    while(slots.empty() && !closed){
+        if(timeout_ms < 0){
+            filled.wait(lock);
+        }else if(!filled.timed_wait(lock, boost::posix_time::milliseconds(timeout_ms))){
+            break;
+        }
+    }
+    if(slots.empty() || closed) return NULL;
+    Slot* slot = slots.front();
+    slots.pop_front();
+    return slot;
+}
+
+bool
+RenderPipeline::SlotQueue::empty(){
+    boost::mutex::scoped_lock lock(mutex);
+    return slots.empty();
+}
+
+void
+RenderPipeline::SlotQueue::close(){
+    boost::mutex::scoped_lock lock(mutex);
+    closed = true;
+    filled.notify_all();
+}
+
+RenderPipeline::RenderPipeline(RenderBackend* backend, unsigned int plane_size, unsigned int depth, bool compressed, int jpeg_quality){
+    this->backend = backend;
+    this->compressed = compressed;
+    this->jpeg_quality = jpeg_quality;
+    submitted = 0;
+    setup_error = LADYBUG_OK;
+    setup_done = false;
+    unsigned int stride = (plane_size + FRAME_POOL_ALIGNMENT - 1) & ~(FRAME_POOL_ALIGNMENT - 1);
+    for(unsigned int i = 0; i < (depth > 0 ? depth : 1); ++i){
+        Slot* slot = new Slot();
+        slot->planes_slab = new Slab(stride * LADYBUG_NUM_CAMERAS);
+        for(unsigned int camera = 0; camera < LADYBUG_NUM_CAMERAS; ++camera){
+            slot->planes[camera] = slot->planes_slab->data + camera * stride;
+        }
+        slot->error = LADYBUG_OK;
+        slots.push_back(slot);
+        free_slots.push(slot);
+    }
+    stage_convert = Metrics::instance().stage("pano convert");
+    stage_render = Metrics::instance().stage("pano upload and render");
+    stage_encode = Metrics::instance().stage("pano encode");
+    threads.create_thread(boost::bind(&RenderPipeline::render_stage, this));
+    threads.create_thread(boost::bind(&RenderPipeline::encode_stage, this));
+    boost::mutex::scoped_lock lock(setup_mutex);
+    while(!setup_done){
+        setup_finished.wait(lock);
+    }
+}
+
+RenderPipeline::~RenderPipeline(){
+    to_render.close();
+    to_encode.close();
+    threads.join_all();
+    for(size_t i = 0; i < slots.size(); ++i){
+        delete slots[i]->planes_slab;
+        delete slots[i];
+    }
+}
+
+LadybugError
+RenderPipeline::started(){
+    return setup_error;
+}
+
+bool
+RenderPipeline::full(){
+    return free_slots.empty();
+}
+
+LadybugError
+RenderPipeline::submit(LadybugImage* image, const ladybug5_network::pbMessage& header){
+    Slot* slot = free_slots.pop();
+    unsigned long long start_us = monotonic_us();
+    LadybugError error = backend->convert(image, slot->planes);
+    Metrics::instance().record(stage_convert, monotonic_us() - start_us);
+    if(error != LADYBUG_OK){
+        free_slots.push(slot);
+        return error;
+    }
+    slot->header.CopyFrom(header);
+    slot->error = LADYBUG_OK;
+    ++submitted;
+    to_render.push(slot);
+    return LADYBUG_OK;
+}
+
+bool
+RenderPipeline::finished(ladybug5_network::pbMessage* header, zmq::message_t* pano, LadybugError* error, int timeout_ms){
+    Slot* slot = done.pop(timeout_ms);
+    if(slot == NULL) return false;
+    header->Swap(&slot->header);
+    pano->move(&slot->pano);
+    *error = slot->error;
+    free_slots.push(slot);
+    --submitted;
+    return true;
+}
+
+unsigned int
+RenderPipeline::in_flight(){
+    return submitted;
+}
+
+void
+RenderPipeline::drain(){
+    ladybug5_network::pbMessage header;
+    zmq::message_t pano;
+    LadybugError error;
+    while(submitted > 0){
+        finished(&header, &pano, &error, -1);
+    }
+}
+
+void
+RenderPipeline::render_stage(){
+    LadybugError error;
+    try{
+        error = backend->setup(); // the GL state of the renderer is created by this thread
+    }catch(...){
+        error = LADYBUG_FAILED;
+    }
+    {
+        boost::mutex::scoped_lock lock(setup_mutex);
+        setup_error = error;
+        setup_done = true;
+        setup_finished.notify_all();
+    }
+    while(Slot* slot = to_render.pop()){
+        unsigned long long start_us = monotonic_us();
+        LadybugProcessedImage processed;
+        try{
+            slot->error = setup_error != LADYBUG_OK ? setup_error : backend->upload(slot->planes);
+            if(slot->error == LADYBUG_OK){
+                slot->error = backend->render(&processed);
+            }
+            if(slot->error == LADYBUG_OK){
+                /* read back into the slot, the next render overwrites the buffer of the backend */
+                unsigned int size = processed.uiCols * processed.uiRows * 3;
+                MemoryBudget::instance().message(&slot->pano, size);
+                memcpy(slot->pano.data(), processed.pData, size);
+                ladybug5_network::pbImage* image_msg = slot->header.mutable_images(slot->header.images_size() - 1); // the panorama is the last image
+                image_msg->set_width(processed.uiCols);
+                image_msg->set_height(processed.uiRows);
+            }
+        }catch(...){
+            slot->error = LADYBUG_FAILED; // the capture thread handles it like an error of the SDK
+        }
+        Metrics::instance().record(stage_render, monotonic_us() - start_us);
+        to_encode.push(slot);
+    }
+}
+
+void
+RenderPipeline::encode_stage(){
+    while(Slot* slot = to_encode.pop()){
+        if(compressed && slot->error == LADYBUG_OK){
+            unsigned long long start_us = monotonic_us();
+            const ladybug5_network::pbImage& image_msg = slot->header.images(slot->header.images_size() - 1);
+            try{
+                zmq::message_t jpeg = compressBufferToZmqMsg((unsigned char*)slot->pano.data(), image_msg.width(), image_msg.height(), TJPF_BGR, jpeg_quality);
+                slot->pano.move(&jpeg); // the raw panorama is freed
+            }catch(...){
+                slot->error = LADYBUG_FAILED;
+            }
+            Metrics::instance().record(stage_encode, monotonic_us() - start_us);
+        }
+        done.push(slot);
+    }
+}
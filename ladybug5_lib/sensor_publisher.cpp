@@ -0,0 +1,46 @@
+#include "sensor_publisher.h"
+#include "protobuf_helper.h"
+#include "stats.h"
+#include <boost/date_time/posix_time/posix_time.hpp>
+
+SensorPublisher::SensorPublisher(zmq::context_t* zmq_context, std::string connection, std::string serial_number){
+    int val = 100; // ~6 sec at full frame rate, sensor messages are small
+    socket = new zmq::socket_t(*zmq_context, ZMQ_PUB);
+    socket->setsockopt(ZMQ_SNDHWM, &val, sizeof(val));
+    socket->connect(connection.c_str());
+    monitor_socket(zmq_context, socket, "sensors");
+    message.set_serial_number(serial_number);
+    drops = Metrics::instance().counter("drops.sensors");
+}
+
+void
+SensorPublisher::set_serial_number(const std::string& serial_number){
+    message.set_serial_number(serial_number);
+}
+
+bool
+SensorPublisher::publish(LadybugImage& image, unsigned int id){
+    static const boost::posix_time::ptime epoch(boost::gregorian::date(1970, 1, 1));
+    boost::posix_time::time_duration now = boost::posix_time::microsec_clock::universal_time() - epoch;
+
+    message.set_id(id);
+    message.set_host_time_us(now.total_microseconds());
+    fill_timestamp(message.mutable_time(), image);
+    fill_sensordata(message.mutable_sensors(), image);
+
+    std::string serialized;
+    message.SerializeToString(&serialized);
+    zmq::message_t msg(serialized.size());
+    memcpy(msg.data(), serialized.c_str(), serialized.size());
+    if(!socket->send(msg, ZMQ_NOBLOCK)){
+        Metrics::instance().count(drops);
+        return false;
+    }
+    return true;
+}
+
+SensorPublisher::~SensorPublisher(){
+    unmonitor_socket(socket);
+    socket->close();
+    delete socket;
+}
@@ -0,0 +1,142 @@
+#include "spans.h"
+#include <stdio.h>
+#include <boost\filesystem.hpp>
+
+boost::atomic<bool> Spans::enabled(false);
+
+Spans::ThreadSpans::ThreadSpans(unsigned int capacity, unsigned int tid) : events(capacity), written(0), tid(tid){
+}
+
+Spans::Spans() : _local(&Spans::release){
+    capacity = 0;
+    watcher = NULL;
+}
+
+Spans&
+Spans::instance(){
+    static Spans spans;
+    return spans;
+}
+
+void
+Spans::start(const std::string& file, unsigned int events_per_thread){
+    boost::mutex::scoped_lock lock(mutex);
+    if(file.empty() || events_per_thread == 0 || watcher != NULL) return;
+    this->file = file;
+    capacity = events_per_thread;
+    enabled = true;
+    printf("Recording spans, touch %s.dump to write %s\n", file.c_str(), file.c_str());
+    watcher = new boost::thread(boost::bind(&Spans::watch, this));
+}
+
+Spans::ThreadSpans*
+Spans::local(){
+    ThreadSpans* spans = _local.get();
+    if(spans == NULL){
+        boost::mutex::scoped_lock lock(mutex);
+        if(unused.empty()){
+            spans = new ThreadSpans(capacity, threads.size() + 1);
+            threads.push_back(spans);
+        }else{
+            spans = unused.back(); // keeps the spans of the exited thread
+            unused.pop_back();
+        }
+        _local.reset(spans);
+    }
+    return spans;
+}
+
+void
+Spans::release(ThreadSpans* spans){
+    Spans& self = instance();
+    boost::mutex::scoped_lock lock(self.mutex);
+    self.unused.push_back(spans);
+}
+
+void
+Spans::record(const char* name, unsigned long long begin_us, unsigned long long end_us, int image){
+    if(!enabled.load(boost::memory_order_relaxed)) return;
+    ThreadSpans* spans = local();
+    unsigned long long written = spans->written.load(boost::memory_order_relaxed);
+    SpanEvent& event = spans->events[written % spans->events.size()];
+    event.name = name;
+    event.begin_us = begin_us;
+    event.duration_us = end_us - begin_us;
+    event.image = image;
+    spans->written.store(written + 1, boost::memory_order_release);
+}
+
+void
+Spans::name_thread(const std::string& name){
+    if(!enabled.load(boost::memory_order_relaxed)) return;
+    ThreadSpans* spans = local();
+    boost::mutex::scoped_lock lock(mutex);
+    spans->name = name;
+}
+
+bool
+Spans::dump(){
+    return dump(file);
+}
+
+bool
+Spans::dump(const std::string& file){
+    if(!enabled.load(boost::memory_order_relaxed)) return false;
+    FILE* out = fopen(file.c_str(), "w");
+    if(out == NULL){
+        printf("Writing spans to %s failed\n", file.c_str());
+        return false;
+    }
+
+    boost::mutex::scoped_lock lock(mutex);
+    unsigned long long count = 0;
+    bool first = true;
+    fprintf(out, "{\"traceEvents\":[\n");
+    for(size_t t = 0; t < threads.size(); ++t){
+        ThreadSpans* spans = threads[t];
+        if(!spans->name.empty()){
+            fprintf(out, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"%s\"}}", first ? "" : ",\n", spans->tid, spans->name.c_str());
+            first = false;
+        }
+
+        /* copy first, the writer keeps going; drop what it overwrote meanwhile */
+        unsigned long long size = spans->events.size();
+        unsigned long long end = spans->written.load(boost::memory_order_acquire);
+        unsigned long long begin = end > size ? end - size : 0;
+        std::vector<SpanEvent> events;
+        for(unsigned long long i = begin; i < end; ++i){
+            events.push_back(spans->events[i % size]);
+        }
+        unsigned long long overwritten = spans->written.load(boost::memory_order_acquire);
+        /* the writer fills slot written % size before it counts it, that one may be torn too */
+        size_t skip = overwritten >= begin + size ? (size_t)(overwritten - size - begin + 1) : 0;
+
+        for(size_t i = skip; i < events.size(); ++i){
+            const SpanEvent& event = events[i];
+            fprintf(out, "%s{\"name\":\"%s\",\"ph\":\"X\",\"ts\":%llu,\"dur\":%llu,\"pid\":1,\"tid\":%u",
+                first ? "" : ",\n", event.name, event.begin_us, event.duration_us, spans->tid);
+            if(event.image >= 0){
+                fprintf(out, ",\"args\":{\"image\":%i}", event.image);
+            }
+            fprintf(out, "}");
+            first = false;
+            ++count;
+        }
+    }
+    fprintf(out, "\n]}\n");
+    fclose(out);
+    printf("Wrote %llu spans to %s\n", count, file.c_str());
+    return true;
+}
+
+void
+Spans::watch(){
+    std::string trigger = file + ".dump";
+    while(true){
+        boost::this_thread::sleep(boost::posix_time::seconds(1));
+        if(boost::filesystem::exists(trigger)){
+            boost::filesystem::remove(trigger);
+            dump();
+        }
+    }
+}
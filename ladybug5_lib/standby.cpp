@@ -0,0 +1,77 @@
+#include "standby.h"
+#include "process_watchdog.h"
+#include "timing.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* How often a waiting standby reports, well below the heartbeat timeout of the service */
+#define STANDBY_REPORT_MS 100
+
+Standby*
+Standby::create(zmq::context_t* zmq_context, const std::string& service){
+    const char* promote = getenv(STANDBY_ENVIRONMENT);
+    if(promote == NULL || promote[0] == '\0') return NULL;
+    return new Standby(zmq_context, promote, service);
+}
+
+Standby::Standby(zmq::context_t* zmq_context, const std::string& promote, const std::string& service){
+    process_id = current_process_id();
+    this->promote = new zmq::socket_t(*zmq_context, ZMQ_SUB);
+    this->promote->setsockopt(ZMQ_SUBSCRIBE, &process_id, sizeof(process_id)); // the service sees the subscription, then it can promote
+    this->promote->connect(promote.c_str());
+
+    this->service = NULL;
+    if(!service.empty()){
+        int val = 1;
+        int linger = 0;
+        this->service = new zmq::socket_t(*zmq_context, ZMQ_PUSH);
+        this->service->setsockopt(ZMQ_SNDHWM, &val, sizeof(val));
+        this->service->setsockopt(ZMQ_LINGER, &linger, sizeof(linger));
+        this->service->connect(service.c_str());
+    }
+}
+
+Standby::~Standby(){
+    promote->close();
+    delete promote;
+    if(service != NULL){
+        service->close();
+        delete service;
+    }
+}
+
+unsigned long long
+Standby::wait(){
+    printf("Standby %u, waiting to take over the camera...\n", process_id);
+    unsigned long long start_us = monotonic_us();
+    while(true){
+        report(HEARTBEAT_STANDBY);
+        zmq::pollitem_t items[] = { { *promote, 0, ZMQ_POLLIN, 0 } };
+        zmq::poll(&items[0], 1, STANDBY_REPORT_MS);
+        if(items[0].revents & ZMQ_POLLIN){
+            zmq::message_t msg;
+            promote->recv(&msg);
+            break;
+        }
+    }
+    report(HEARTBEAT_STARTING); // the service holds the deadline while the camera starts
+    unsigned long long waited_ms = (monotonic_us() - start_us) / 1000;
+    printf("Promoted after %llu ms in standby, starting the camera\n", waited_ms);
+    return waited_ms;
+}
+
+void
+Standby::report(unsigned int state){
+    if(service == NULL) return;
+    HeartbeatMessage heartbeat;
+    heartbeat.process_id = process_id;
+    heartbeat.state = state;
+    zmq::message_t msg(sizeof(heartbeat));
+    memcpy(msg.data(), &heartbeat, sizeof(heartbeat));
+    try{
+        service->send(msg, ZMQ_NOBLOCK);
+    }catch(zmq::error_t& e){
+        printf("Standby: heartbeat not sent, %s\n", e.what());
+    }
+}
@@ -0,0 +1,158 @@
+#include "stats.h"
+#include <stdio.h>
+#include <boost/thread/mutex.hpp>
+
+struct MonitorEndpoint{
+    zmq::context_t* zmq_context;
+    zmq::socket_t* socket;
+    std::string endpoint;
+    std::string name;
+};
+
+static boost::mutex monitor_mutex;
+static std::vector<MonitorEndpoint> monitor_endpoints; /* of the open sockets */
+static unsigned long long monitors_created = 0;
+
+void monitor_socket(zmq::context_t* zmq_context, zmq::socket_t* socket, const std::string& name){
+    boost::mutex::scoped_lock lock(monitor_mutex);
+    MonitorEndpoint monitor;
+    monitor.zmq_context = zmq_context;
+    monitor.socket = socket;
+    monitor.endpoint = "inproc://monitor." + name + "." + std::to_string(monitors_created++);
+    monitor.name = name;
+    if(zmq_socket_monitor(*socket, monitor.endpoint.c_str(), ZMQ_EVENT_CONNECTED | ZMQ_EVENT_DISCONNECTED) == 0){
+        monitor_endpoints.push_back(monitor);
+    }else{
+        printf("Monitoring socket %s failed: %i\n", name.c_str(), zmq_errno());
+    }
+}
+
+void unmonitor_socket(zmq::socket_t* socket){
+    boost::mutex::scoped_lock lock(monitor_mutex);
+    for(size_t i = 0; i < monitor_endpoints.size(); ++i){
+        if(monitor_endpoints[i].socket == socket){
+            zmq_socket_monitor(*socket, NULL, 0);
+            monitor_endpoints.erase(monitor_endpoints.begin() + i);
+            return;
+        }
+    }
+}
+
+static bool is_monitored(const std::string& endpoint){
+    for(size_t i = 0; i < monitor_endpoints.size(); ++i){
+        if(monitor_endpoints[i].endpoint == endpoint) return true;
+    }
+    return false;
+}
+
+void fill_stats(ladybug5_network::pbStats* stats, const MetricsSnapshot& now, const MetricsSnapshot& last){
+    MetricsSnapshot interval = now.since(last);
+    double seconds = (now.time_us - last.time_us) / 1000000.0;
+
+    stats->set_time_us(now.time_us);
+    stats->set_interval_ms((unsigned int)((now.time_us - last.time_us) / 1000));
+    for(size_t i = 0; i < interval.stages.size(); ++i){
+        const HistogramSnapshot& h = interval.stages[i];
+        if(h.count == 0) continue;
+        ladybug5_network::pbStageStats* stage = stats->add_stages();
+        stage->set_name(interval.stage_names[i]);
+        stage->set_count(h.count);
+        stage->set_p50_us(h.percentile(50));
+        stage->set_p90_us(h.percentile(90));
+        stage->set_p99_us(h.percentile(99));
+        stage->set_max_us(h.max);
+        stage->set_mean_us(h.mean());
+        if(h.allocations > 0){
+            stage->set_allocations(h.allocations);
+            stage->set_allocated_bytes(h.allocated_bytes);
+        }
+    }
+    if(Allocations::enabled.load(boost::memory_order_relaxed)){
+        stats->set_allocations_per_frame(interval.allocations_per_frame());
+    }
+    for(size_t i = 0; i < now.counters.size(); ++i){
+        ladybug5_network::pbCounterStats* counter = stats->add_counters();
+        counter->set_name(now.counter_names[i]);
+        counter->set_total(now.counters[i]);
+        counter->set_per_second(seconds > 0 ? interval.counters[i] / seconds : 0.0);
+    }
+    for(size_t i = 0; i < now.gauges.size(); ++i){
+        ladybug5_network::pbGaugeStats* gauge = stats->add_gauges();
+        gauge->set_name(now.gauge_names[i]);
+        gauge->set_value(now.gauges[i]);
+    }
+}
+
+SocketMonitors::SocketMonitors(zmq::context_t* zmq_context){
+    this->zmq_context = zmq_context;
+}
+
+void
+SocketMonitors::update(){
+    {
+        boost::mutex::scoped_lock lock(monitor_mutex);
+        for(size_t next = 0; next < monitor_endpoints.size(); ++next){
+            if(monitor_endpoints[next].zmq_context != zmq_context) continue; // inproc only works in the same context
+            bool connected = false;
+            for(size_t i = 0; i < monitors.size() && !connected; ++i){
+                connected = monitors[i].endpoint == monitor_endpoints[next].endpoint;
+            }
+            if(connected) continue;
+
+            Monitor monitor;
+            monitor.name = monitor_endpoints[next].name;
+            monitor.endpoint = monitor_endpoints[next].endpoint;
+            monitor.disconnected = false;
+            monitor.connected_counter = Metrics::instance().counter("socket." + monitor.name + ".connected");
+            monitor.disconnected_counter = Metrics::instance().counter("socket." + monitor.name + ".disconnected");
+            monitor.reconnect_counter = Metrics::instance().counter("socket." + monitor.name + ".reconnects");
+            monitor.socket = new zmq::socket_t(*zmq_context, ZMQ_PAIR);
+            try{
+                monitor.socket->connect(monitor_endpoints[next].endpoint.c_str());
+                monitors.push_back(monitor);
+            }catch(zmq::error_t e){
+                delete monitor.socket;
+            }
+        }
+    }
+
+    for(size_t i = 0; i < monitors.size(); ++i){
+        zmq::message_t msg;
+        while(monitors[i].socket->recv(&msg, ZMQ_NOBLOCK)){
+            if(msg.size() < sizeof(int)) continue;
+            zmq_event_t event;
+            memcpy(&event, msg.data(), msg.size() < sizeof(event) ? msg.size() : sizeof(event));
+
+            if(event.event == ZMQ_EVENT_CONNECTED){
+                Metrics::instance().count(monitors[i].connected_counter);
+                if(monitors[i].disconnected){
+                    Metrics::instance().count(monitors[i].reconnect_counter);
+                }
+                monitors[i].disconnected = false;
+            }
+            else if(event.event == ZMQ_EVENT_DISCONNECTED){
+                Metrics::instance().count(monitors[i].disconnected_counter);
+                monitors[i].disconnected = true;
+            }
+        }
+    }
+
+    /* the sockets closed since, their last events are read */
+    boost::mutex::scoped_lock lock(monitor_mutex);
+    for(size_t i = 0; i < monitors.size();){
+        if(is_monitored(monitors[i].endpoint)){
+            ++i;
+            continue;
+        }
+        monitors[i].socket->close();
+        delete monitors[i].socket;
+        monitors.erase(monitors.begin() + i);
+    }
+}
+
+SocketMonitors::~SocketMonitors(){
+    for(size_t i = 0; i < monitors.size(); ++i){
+        monitors[i].socket->close();
+        delete monitors[i].socket;
+    }
+}
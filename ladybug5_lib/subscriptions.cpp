@@ -0,0 +1,75 @@
+#include "subscriptions.h"
+#include <stdio.h>
+
+Subscriptions::Subscriptions(){
+}
+
+unsigned int
+Subscriptions::update(zmq::socket_t* socket){
+    unsigned int subscribed = 0;
+    zmq::message_t event;
+
+    /* XPUB events: first byte 1 = subscribe, 0 = unsubscribe, followed by the topic */
+    while(socket->recv(&event, ZMQ_NOBLOCK)){
+        if(event.size() == 0) continue;
+
+        const char* data = (const char*)event.data();
+        std::string topic(data + 1, event.size() - 1);
+
+        boost::mutex::scoped_lock lock(mutex);
+        if(data[0] == 1){
+            topics.insert(topic);
+            ++subscribed;
+#ifdef _DEBUG
+            printf("Subscribed: \"%s\"\n", topic.c_str());
+#endif
+        }
+        else{
+            /* XPUB only reports the unsubscribe of the last peer of a topic */
+            topics.erase(topic);
+#ifdef _DEBUG
+            printf("Unsubscribed: \"%s\"\n", topic.c_str());
+#endif
+        }
+    }
+    return subscribed;
+}
+
+bool
+Subscriptions::has_subscribers(const std::string& topic){
+    boost::mutex::scoped_lock lock(mutex);
+    for(std::set<std::string>::const_iterator it = topics.begin(); it != topics.end(); ++it){
+        if(topic.compare(0, it->size(), *it) == 0){
+            return true;
+        }
+    }
+    return false;
+}
+
+void
+Subscriptions::clear(){
+    boost::mutex::scoped_lock lock(mutex);
+    topics.clear();
+}
+
+Subscriptions::~Subscriptions(){
+}
+
+zmq::socket_t*
+create_xpub(zmq::context_t* zmq_context, std::string connection, int hwm, bool zmq_bind, bool verbose){
+    zmq::socket_t* socket = new zmq::socket_t(*zmq_context, ZMQ_XPUB);
+    socket->setsockopt(ZMQ_RCVHWM, &hwm, sizeof(hwm));  //prevent buffer get overfilled
+    socket->setsockopt(ZMQ_SNDHWM, &hwm, sizeof(hwm));  //prevent buffer get overfilled
+
+    if(verbose){ // report every subscription, also if the topic is already known
+        int val = 1;
+        socket->setsockopt(ZMQ_XPUB_VERBOSE, &val, sizeof(val));
+    }
+
+    if(zmq_bind){
+        socket->bind(connection.c_str());
+    }else{
+        socket->connect(connection.c_str());
+    }
+    return socket;
+}
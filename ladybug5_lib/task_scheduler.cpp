@@ -0,0 +1,233 @@
+#include "task_scheduler.h"
+#include "metrics.h"
+#include "spans.h"
+#include "thread_affinity.h"
+#include <string>
+
+#ifdef _WIN32
+#define THREAD_LOCAL __declspec(thread)
+#else
+#define THREAD_LOCAL __thread
+#endif
+
+/* index + 1 of the worker running in this thread, 0 for other threads */
+static THREAD_LOCAL unsigned int worker_index = 0;
+
+TaskScheduler::TaskScheduler(){
+    pending.store(0);
+    next.store(0);
+    active.store(0);
+    stolen = Metrics::instance().counter("tasks.stolen");
+    executed = Metrics::instance().counter("tasks.executed");
+}
+
+TaskScheduler&
+TaskScheduler::instance(){
+    static TaskScheduler* scheduler = new TaskScheduler(); // never destroyed, the workers run until the process exits
+    return *scheduler;
+}
+
+void
+TaskScheduler::start(unsigned int threads){
+    boost::mutex::scoped_lock lock(mutex);
+    if(!workers.empty()) return;
+    if(threads == 0){
+        threads = boost::thread::hardware_concurrency();
+    }
+    for(unsigned int i = 0; i < threads; ++i){
+        workers.push_back(new Worker());
+    }
+    active.store(threads);
+    for(unsigned int i = 0; i < threads; ++i){
+        ThreadAffinity::instance().apply(worker_threads.create_thread(boost::bind(&TaskScheduler::work, this, i)), THREAD_COMPRESSION);
+    }
+}
+
+unsigned int
+TaskScheduler::threads(){
+    boost::mutex::scoped_lock lock(mutex);
+    return workers.size();
+}
+
+void
+TaskScheduler::set_active(unsigned int active){
+    {
+        boost::mutex::scoped_lock lock(mutex);
+        this->active.store(active < workers.size() ? active : workers.size());
+    }
+    available.notify_all(); // the woken workers start, the surplus ones park
+}
+
+void
+TaskScheduler::submit(Task* task){
+    if(workers.empty()){
+        return; // not started, TaskGroup::wait runs the task
+    }
+    unsigned int taking = active.load();
+    unsigned int index = worker_index > 0 ? worker_index - 1 : next.fetch_add(1) % (taking > 0 ? taking : 1); // a parked deque is emptied by stealing
+    {
+        boost::mutex::scoped_lock lock(workers[index]->mutex);
+        workers[index]->tasks.push_back(task);
+    }
+    pending.fetch_add(1);
+    {
+        boost::mutex::scoped_lock lock(mutex); // a worker between its check and the wait gets the notify
+    }
+    available.notify_one();
+}
+
+Task*
+TaskScheduler::pop(unsigned int index){
+    boost::mutex::scoped_lock lock(workers[index]->mutex);
+    if(workers[index]->tasks.empty()) return NULL;
+    Task* task = workers[index]->tasks.back();
+    workers[index]->tasks.pop_back();
+    return task;
+}
+
+Task*
+TaskScheduler::steal(unsigned int thief){
+    for(unsigned int i = 1; i <= workers.size(); ++i){
+        Worker* victim = workers[(thief + i) % workers.size()];
+        boost::mutex::scoped_lock lock(victim->mutex);
+        if(victim->tasks.empty()) continue;
+        Task* task = victim->tasks.front();
+        victim->tasks.pop_front();
+        return task;
+    }
+    return NULL;
+}
+
+void
+TaskScheduler::execute(Task* task){
+    pending.fetch_sub(1);
+    task->work();
+    Metrics::instance().count(executed);
+    task->group->finished(task);
+}
+
+bool
+TaskScheduler::run_one(){
+    if(workers.empty() || pending.load() == 0) return false;
+    Task* task = worker_index > 0 ? pop(worker_index - 1) : NULL;
+    if(task == NULL){
+        task = steal(worker_index > 0 ? worker_index - 1 : next.load() % workers.size());
+    }
+    if(task == NULL) return false;
+    execute(task);
+    return true;
+}
+
+void
+TaskScheduler::work(unsigned int index){
+    worker_index = index + 1;
+    Spans::instance().name_thread("task " + std::to_string((long long)index));
+    while(true){
+        if(index >= active.load()){
+            boost::mutex::scoped_lock lock(mutex);
+            if(index >= active.load()){
+                available.timed_wait(lock, boost::posix_time::milliseconds(100)); // parked
+            }
+            continue;
+        }
+        Task* task = pop(index);
+        if(task == NULL){
+            task = steal(index);
+            if(task != NULL) Metrics::instance().count(stolen);
+        }
+        if(task != NULL){
+            execute(task);
+            continue;
+        }
+        boost::mutex::scoped_lock lock(mutex);
+        if(pending.load() == 0){
+            available.timed_wait(lock, boost::posix_time::milliseconds(100));
+        }
+    }
+}
+
+TaskGroup::TaskGroup(){
+    remaining.store(0);
+    started = false;
+}
+
+TaskGroup::~TaskGroup(){
+    if(started) wait();
+    for(size_t i = 0; i < tasks.size(); ++i){
+        delete tasks[i];
+    }
+}
+
+TaskGroup::Id
+TaskGroup::add(const boost::function<void()>& work){
+    Task* task = new Task();
+    task->work = work;
+    task->group = this;
+    task->dependencies.store(0);
+    tasks.push_back(task);
+    return tasks.size() - 1;
+}
+
+void
+TaskGroup::depends(Id task, Id before){
+    tasks[before]->successors.push_back(tasks[task]);
+    tasks[task]->dependencies.fetch_add(1);
+}
+
+void
+TaskGroup::run(){
+    started = true;
+    remaining.store(tasks.size());
+    std::vector<Task*> roots; // before the first submit, a finished root makes its successors ready
+    for(size_t i = 0; i < tasks.size(); ++i){
+        if(tasks[i]->dependencies.load() == 0) roots.push_back(tasks[i]);
+    }
+    for(size_t i = 0; i < roots.size(); ++i){
+        TaskScheduler::instance().submit(roots[i]);
+    }
+}
+
+void
+TaskGroup::finished(Task* task){
+    for(size_t i = 0; i < task->successors.size(); ++i){
+        if(task->successors[i]->dependencies.fetch_sub(1) == 1){
+            TaskScheduler::instance().submit(task->successors[i]);
+        }
+    }
+    boost::mutex::scoped_lock lock(mutex); // the waiter can not destroy the group before the unlock
+    if(remaining.fetch_sub(1) == 1){
+        done.notify_all();
+    }
+}
+
+void
+TaskGroup::wait(){
+    TaskScheduler& scheduler = TaskScheduler::instance();
+    if(scheduler.workers.empty()){
+        /* no workers: run the DAG here, in the order of the dependencies */
+        std::vector<Task*> ready;
+        for(size_t i = 0; i < tasks.size(); ++i){
+            if(tasks[i]->dependencies.load() == 0) ready.push_back(tasks[i]);
+        }
+        while(!ready.empty()){
+            Task* task = ready.back();
+            ready.pop_back();
+            task->work();
+            for(size_t i = 0; i < task->successors.size(); ++i){
+                if(task->successors[i]->dependencies.fetch_sub(1) == 1) ready.push_back(task->successors[i]);
+            }
+            remaining.fetch_sub(1);
+        }
+        started = false;
+        return;
+    }
+    while(remaining.load() > 0){
+        if(scheduler.run_one()) continue; // help, maybe with a task of another group
+        boost::mutex::scoped_lock lock(mutex);
+        if(remaining.load() > 0){
+            done.timed_wait(lock, boost::posix_time::milliseconds(1));
+        }
+    }
+    boost::mutex::scoped_lock lock(mutex); // the last finished() is done with the group
+    started = false;
+}
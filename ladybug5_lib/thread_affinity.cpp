@@ -0,0 +1,271 @@
+#include "thread_affinity.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+#include <sstream>
+#include <boost/algorithm/string.hpp>
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <sched.h>
+#include <pthread.h>
+#endif
+
+#define MAX_CORES 64
+
+ThreadAffinity::ThreadAffinity(){
+    for(unsigned int i = 0; i < THREAD_ROLES; ++i){
+        _cores[i] = 0;
+        priorities[i] = PRIORITY_NORMAL;
+    }
+    reserve = false;
+}
+
+ThreadAffinity&
+ThreadAffinity::instance(){
+    static ThreadAffinity affinity;
+    return affinity;
+}
+
+void
+ThreadAffinity::configure(const unsigned long long* cores, const ThreadPriority* priorities, bool reserve){
+    for(unsigned int i = 0; i < THREAD_ROLES; ++i){
+        _cores[i] = cores[i];
+        this->priorities[i] = priorities[i];
+    }
+    this->reserve = reserve;
+}
+
+unsigned long long
+ThreadAffinity::cores(ThreadRole role){
+    unsigned long long set = _cores[role];
+    if(!reserve || (role != THREAD_COMPRESSION && role != THREAD_SENDING)){
+        return set;
+    }
+    unsigned long long reserved = _cores[THREAD_CAPTURE] | _cores[THREAD_IO];
+    if(reserved == 0){
+        return set;
+    }
+    if(set == 0){
+        unsigned int nr = boost::thread::hardware_concurrency();
+        set = nr >= MAX_CORES ? ~0ULL : (1ULL << nr) - 1;
+    }
+    if((set & ~reserved) == 0){
+        printf("%s: all cores reserved, not reserving\n", threadRoleToString(role));
+        return _cores[role];
+    }
+    return set & ~reserved;
+}
+
+unsigned int
+ThreadAffinity::core_count(ThreadRole role){
+    unsigned long long set = cores(role);
+    if(set == 0){
+        return boost::thread::hardware_concurrency();
+    }
+    unsigned int count = 0;
+    for(; set != 0; set &= set - 1){
+        ++count;
+    }
+    return count;
+}
+
+#ifdef _WIN32
+static int
+windows_priority(ThreadPriority priority){
+    switch(priority){
+        case PRIORITY_IDLE:          return THREAD_PRIORITY_IDLE;
+        case PRIORITY_LOWEST:        return THREAD_PRIORITY_LOWEST;
+        case PRIORITY_BELOW_NORMAL:  return THREAD_PRIORITY_BELOW_NORMAL;
+        case PRIORITY_ABOVE_NORMAL:  return THREAD_PRIORITY_ABOVE_NORMAL;
+        case PRIORITY_HIGHEST:       return THREAD_PRIORITY_HIGHEST;
+        case PRIORITY_TIME_CRITICAL: return THREAD_PRIORITY_TIME_CRITICAL;
+        default:                     return THREAD_PRIORITY_NORMAL;
+    }
+}
+
+static void
+apply_handle(HANDLE thread, ThreadRole role, unsigned long long cores, ThreadPriority priority){
+    if(cores != 0 && SetThreadAffinityMask(thread, (DWORD_PTR)cores) == 0){
+        printf("%s: can not pin to cores %s\n", threadRoleToString(role), coresToString(cores).c_str());
+    }
+    if(priority != PRIORITY_NORMAL && !SetThreadPriority(thread, windows_priority(priority))){
+        printf("%s: can not set priority %s\n", threadRoleToString(role), threadPriorityToString(priority).c_str());
+    }
+}
+#else
+/* Linux has no priorities for normal threads, above normal is realtime */
+static void
+linux_sched(ThreadPriority priority, int* policy, int* level){
+    *level = 0;
+    switch(priority){
+        case PRIORITY_IDLE:
+            *policy = SCHED_IDLE;
+            break;
+        case PRIORITY_LOWEST:
+        case PRIORITY_BELOW_NORMAL:
+            *policy = SCHED_BATCH;
+            break;
+        case PRIORITY_ABOVE_NORMAL:
+            *policy = SCHED_RR;
+            *level = sched_get_priority_min(SCHED_RR);
+            break;
+        case PRIORITY_HIGHEST:
+            *policy = SCHED_RR;
+            *level = (sched_get_priority_min(SCHED_RR) + sched_get_priority_max(SCHED_RR)) / 2;
+            break;
+        case PRIORITY_TIME_CRITICAL:
+            *policy = SCHED_FIFO;
+            *level = sched_get_priority_max(SCHED_FIFO);
+            break;
+        default:
+            *policy = SCHED_OTHER;
+    }
+}
+
+static void
+cpu_set(unsigned long long cores, cpu_set_t* set){
+    CPU_ZERO(set);
+    for(unsigned int core = 0; core < MAX_CORES; ++core){
+        if(cores & (1ULL << core)) CPU_SET(core, set);
+    }
+}
+
+static void
+apply_priority(pthread_t thread, ThreadRole role, ThreadPriority priority){
+    if(priority == PRIORITY_NORMAL){
+        return;
+    }
+    int policy, level;
+    linux_sched(priority, &policy, &level);
+    sched_param param;
+    param.sched_priority = level;
+    if(pthread_setschedparam(thread, policy, &param) != 0){
+        printf("%s: can not set priority %s (CAP_SYS_NICE?)\n", threadRoleToString(role), threadPriorityToString(priority).c_str());
+    }
+}
+#endif
+
+void
+ThreadAffinity::apply(boost::thread* thread, ThreadRole role){
+    unsigned long long set = cores(role);
+#ifdef _WIN32
+    apply_handle(thread->native_handle(), role, set, priorities[role]);
+#else
+    if(set != 0){
+        cpu_set_t cpus;
+        cpu_set(set, &cpus);
+        if(pthread_setaffinity_np(thread->native_handle(), sizeof(cpus), &cpus) != 0){
+            printf("%s: can not pin to cores %s\n", threadRoleToString(role), coresToString(set).c_str());
+        }
+    }
+    apply_priority(thread->native_handle(), role, priorities[role]);
+#endif
+}
+
+void
+ThreadAffinity::apply_current(ThreadRole role){
+    unsigned long long set = cores(role);
+#ifdef _WIN32
+    apply_handle(GetCurrentThread(), role, set, priorities[role]);
+#else
+    if(set != 0){
+        cpu_set_t cpus;
+        cpu_set(set, &cpus);
+        if(sched_setaffinity(0, sizeof(cpus), &cpus) != 0){
+            printf("%s: can not pin to cores %s\n", threadRoleToString(role), coresToString(set).c_str());
+        }
+    }
+    apply_priority(pthread_self(), role, priorities[role]);
+#endif
+}
+
+void
+ThreadAffinity::apply(zmq::context_t* context){
+    unsigned long long set = cores(THREAD_IO);
+    ThreadPriority priority = priorities[THREAD_IO];
+    if(set == 0 && priority == PRIORITY_NORMAL){
+        return;
+    }
+#ifdef ZMQ_THREAD_AFFINITY_CPU_ADD
+    for(int core = 0; core < MAX_CORES; ++core){
+        if(set & (1ULL << core)) zmq_ctx_set((void*)*context, ZMQ_THREAD_AFFINITY_CPU_ADD, core);
+    }
+#else
+    if(set != 0) printf("%s: zmq %d.%d can not pin its threads\n", threadRoleToString(THREAD_IO), ZMQ_VERSION_MAJOR, ZMQ_VERSION_MINOR);
+#endif
+#if defined(ZMQ_THREAD_SCHED_POLICY) && !defined(_WIN32)
+    if(priority != PRIORITY_NORMAL){
+        int policy, level;
+        linux_sched(priority, &policy, &level);
+        zmq_ctx_set((void*)*context, ZMQ_THREAD_SCHED_POLICY, policy);
+        zmq_ctx_set((void*)*context, ZMQ_THREAD_PRIORITY, level);
+    }
+#else
+    if(priority != PRIORITY_NORMAL) printf("%s: zmq can not set the priority of its threads here\n", threadRoleToString(THREAD_IO));
+#endif
+}
+
+const char*
+threadRoleToString(ThreadRole role){
+    switch(role){
+        case THREAD_CAPTURE:     return "Capture";
+        case THREAD_COMPRESSION: return "Compression";
+        case THREAD_SENDING:     return "Sending";
+        case THREAD_IO:          return "IO";
+        default:                 return "";
+    }
+}
+
+static const char* priority_names[] = { "idle", "lowest", "below_normal", "normal", "above_normal", "highest", "time_critical" };
+
+ThreadPriority
+threadPriorityFromString(const std::string& name){
+    for(int i = PRIORITY_IDLE; i <= PRIORITY_TIME_CRITICAL; ++i){
+        if(name == priority_names[i]) return (ThreadPriority)i;
+    }
+    return PRIORITY_NORMAL;
+}
+
+std::string
+threadPriorityToString(ThreadPriority priority){
+    return priority_names[priority];
+}
+
+unsigned long long
+coresFromString(const std::string& cores, const std::string& owner){
+    std::vector<std::string> tokens;
+    boost::split(tokens, cores, boost::is_any_of(", "), boost::token_compress_on);
+
+    unsigned long long set = 0;
+    for(size_t i = 0; i < tokens.size(); ++i){
+        if(tokens[i].empty()) continue;
+        unsigned int first = 0, last = 0;
+        size_t dash = tokens[i].find('-');
+        first = atoi(tokens[i].substr(0, dash).c_str());
+        last = dash == std::string::npos ? first : atoi(tokens[i].substr(dash + 1).c_str());
+        if(last >= MAX_CORES || first > last){
+            printf("%s: unknown cores %s\n", owner.c_str(), tokens[i].c_str());
+            continue;
+        }
+        for(unsigned int core = first; core <= last; ++core){
+            set |= 1ULL << core;
+        }
+    }
+    return set;
+}
+
+std::string
+coresToString(unsigned long long cores){
+    std::stringstream ss;
+    for(unsigned int core = 0; core < MAX_CORES; ++core){
+        if(!(cores & (1ULL << core))) continue;
+        unsigned int last = core;
+        while(last + 1 < MAX_CORES && (cores & (1ULL << (last + 1)))) ++last;
+        if(ss.tellp() > 0) ss << ",";
+        ss << core;
+        if(last > core) ss << "-" << last;
+        core = last;
+    }
+    return ss.str();
+}
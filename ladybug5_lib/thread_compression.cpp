@@ -1,12 +1,51 @@
 #include "thread_functions.h"
 #include "timing.h"
+#include <map>
 
-void compressionThread(zmq::context_t* p_zmqcontext, int i)
-{	
+/* Encodes a received BGRA camera or BGR panoramic image, downscaled by the profile scale */
+static zmq::message_t* encodeImage(const ladybug5_network::pbImage& image_msg, zmq::message_t* raw, unsigned int scale, int jpeg_quality){
+    /* panramic image is BGR not BGRA */
+    bool panoramic = image_msg.type() == ladybug5_network::LADYBUG_PANORAMIC;
+    TJPF color = panoramic ? TJPF_RGB : TJPF_RGBA; // TJPF_BGRA
+    int pixel_size = panoramic ? 3 : 4;
+    int width = image_msg.width();
+    int height = image_msg.height();
+    unsigned char* buffer = (unsigned char*)raw->data();
+
+    std::vector<unsigned char> scaled;
+    if(scale > 1){
+        scaled.resize((width / scale) * (height / scale) * pixel_size);
+        scaleImage(buffer, width, height, pixel_size, scale, &scaled[0]);
+        buffer = &scaled[0];
+        width = width / scale;
+        height = height / scale;
+    }
+
+    zmq::message_t* encoded = new zmq::message_t();
+    *encoded = compressBufferToZmqMsg(buffer, width, height, color, jpeg_quality);
+    return encoded;
+}
+
+/* One image at one scale and quality, shared by all profiles that want it */
+static unsigned long long encodeKey(int img, unsigned int scale, int jpeg_quality){
+    return ((unsigned long long)img << 40) | ((unsigned long long)scale << 8) | jpeg_quality;
+}
+
+/* Task of the TaskScheduler, writes only its own result. Its time sizes the CompressionPool */
+static void encodeTask(const ladybug5_network::pbImage* image_msg, zmq::message_t* raw, unsigned int scale, int jpeg_quality, int img, zmq::message_t** encoded, unsigned long long* encoded_us){
+    Span encode_span("jpeg encode", img);
+    unsigned long long start_us = monotonic_us();
+    *encoded = encodeImage(*image_msg, raw, scale, jpeg_quality);
+    *encoded_us = monotonic_us();
+    CompressionPool::instance().report_encode(*encoded_us - start_us);
+}
+
+void compressionThread(zmq::context_t* p_zmqcontext, unsigned int generation, Outputs* outputs, Mailboxes* mailboxes)
+{
     std::string status = "CompressionThread";
-    double t_now = clock();
+    double t_now = monotonic_us();
 #ifdef _DEBUG
-	printf("Compression Thread%i: in: %s out: %s\n", i, zmq_uncompressed, zmq_compressed);
+	printf("Compression Thread%u: in: %s out: %s\n", generation, zmq_uncompressed, zmq_compressed);
 #endif
     zmq::socket_t socket_in(*p_zmqcontext, ZMQ_PULL);
     int val = 2; //buffer size
@@ -21,53 +60,156 @@ void compressionThread(zmq::context_t* p_zmqcontext, int i)
 
 	zmq::message_t zmq_ready;
 	ladybug5_network::pbMessage pb_msg;
+    ladybug5_network::pbMessageExtension pb_extension;
+    std::map<int, unsigned int> image_counters; // bytes.<image type>, encoded size per profile
+    Spans::instance().name_thread("compression");
     const unsigned int max_nr_images = LADYBUG_NUM_CAMERAS + 1; /*6x raw + panoramic*/
+    CompressionPool& pool = CompressionPool::instance();
+    bool leaving = false;
 
 	while(true)
 	{
+        if(!leaving && !pool.keep(generation)){
+            /* the capture loop restarted: no new frames, the ones already queued for this thread are still encoded */
+            leaving = true;
+            if(mailboxes != NULL) break;
+            socket_in.disconnect(zmq_uncompressed);
+        }
+        if(leaving){
+            zmq::pollitem_t item_in = { socket_in, 0, ZMQ_POLLIN, 0 };
+            if(zmq::poll(&item_in, 1, 10) == 0) break;
+        }
 		status = "compresseionThread recieving image";
         zmq::message_t arpBuffer[max_nr_images];
         int numImages = 0;
 
         int more;
         size_t more_size = sizeof (more);
-        
-        pb_recv(&socket_in, &pb_msg);
-        assert(pb_msg.images_size() > 0);
-        do{
-            socket_in.recv(&arpBuffer[numImages]);
-            socket_in.getsockopt(ZMQ_RCVMORE, &more, &more_size);
-             ++numImages;
+
+        if(mailboxes != NULL){
+            Parts frame;
+            if(!mailboxes->uncompressed->take(frame, NULL, 100)){ // the newest frame, the older ones were dropped
+                continue;
+            }
+            Span receive_span("receive");
+            pb_parse(*frame[0], &pb_msg, &pb_extension);
+            for(size_t part = 1; part < frame.size() && numImages < max_nr_images; ++part){
+                arpBuffer[numImages++].move(frame[part]);
+            }
+            free_parts(frame);
+        }else{
+            pb_recv(&socket_in, &pb_msg, &pb_extension);
+            Span receive_span("receive");
+            do{
+                socket_in.recv(&arpBuffer[numImages]);
+                socket_in.getsockopt(ZMQ_RCVMORE, &more, &more_size);
+                 ++numImages;
 #ifdef _DEBUG
-            printf("compression recieved image: %i more: %i\n", numImages, more, more_size);
+                printf("compression recieved image: %i more: %i\n", numImages, more, more_size);
 #endif
+            }
+            while(more);
         }
-        while(more);
+        assert(pb_msg.images_size() > 0);
+        unsigned int shed_scale = pb_extension.has_scale() && pb_extension.scale() > 1 ? pb_extension.scale() : 1;
         //_TIME
 
-	    status = "compresseionThread compress jpg";
-        zmq::message_t buffer[max_nr_images];
-        for(int i=0 ; i < numImages; ++i){
-            if( i < max_nr_images-1){
-                buffer[i] = compressImageToZmqMsg(&pb_msg, &arpBuffer[i], i, TJPF_RGBA); // TJPF_BGRA
+        /* Frame is decoded once, every image is encoded once per scale and quality and shared by the profiles */
+        std::map<unsigned long long, zmq::message_t*> encoded;
+        std::map<unsigned long long, unsigned long long> encoded_us;
+
+        /* the encodes of the frame are independent tasks, they run in parallel on the TaskScheduler */
+        TaskGroup encodes;
+        for(unsigned int profile_nr = 0; profile_nr < outputs->size(); ++profile_nr){
+            if(!outputs->active(profile_nr, pb_msg.id())) continue;
+            const OutputProfile& profile = outputs->profiles[profile_nr];
+            for(int img = 0; img < numImages && img < pb_msg.images_size(); ++img){
+                const ladybug5_network::pbImage& image_msg = pb_msg.images(img);
+                unsigned int image_bit = image_msg.type() == ladybug5_network::LADYBUG_PANORAMIC ? PROFILE_PANORAMIC : image_msg.type();
+                if(!profile.wants_image(image_bit)) continue;
+
+                unsigned int scale = image_bit == PROFILE_PANORAMIC ? profile.scale : profile.scale * shed_scale;
+                unsigned long long key = encodeKey(img, scale, profile.jpeg_quality);
+                if(encoded.find(key) != encoded.end()) continue;
+                encoded[key] = NULL; // the map does not change while the tasks run
+                encodes.add(boost::bind(encodeTask, &image_msg, &arpBuffer[img], scale, profile.jpeg_quality, img, &encoded[key], &encoded_us[key]));
             }
-            else{
-                 /* panramic image is BGR not BGRA, last image is the panoramic*/
-                buffer[i] = compressImageToZmqMsg(&pb_msg, &arpBuffer[i], i, TJPF_RGB);
-            }  
         }
-		
-        _TIME
-        status = "compresseionThread serialise and send";
+        encodes.run();
+        encodes.wait();
+
+        for(unsigned int profile_nr = 0; profile_nr < outputs->size(); ++profile_nr){
+            if(!outputs->active(profile_nr, pb_msg.id())) continue;
+            const OutputProfile& profile = outputs->profiles[profile_nr];
+
+	        status = "compresseionThread compress jpg " + profile.name;
+            ladybug5_network::pbMessage header(pb_msg);
+            header.clear_images();
+            std::vector<zmq::message_t*> images;
+            ladybug5_network::pbMessageExtension compress_trace; // appended to the header, merged with the trace of the capture
+
+            for(int img = 0; img < numImages && img < pb_msg.images_size(); ++img){
+                const ladybug5_network::pbImage& image_msg = pb_msg.images(img);
+                unsigned int image_bit = image_msg.type() == ladybug5_network::LADYBUG_PANORAMIC ? PROFILE_PANORAMIC : image_msg.type();
+                if(!profile.wants_image(image_bit)) continue;
+
+                unsigned int scale = image_bit == PROFILE_PANORAMIC ? profile.scale : profile.scale * shed_scale;
+                unsigned long long key = encodeKey(img, scale, profile.jpeg_quality);
+                ladybug5_network::pbTraceStage* stage = compress_trace.mutable_trace()->add_stages();
+                stage->set_stage(ladybug5_network::TRACE_COMPRESS);
+                stage->set_time_us(encoded_us[key]);
+                stage->set_image(header.images_size());
+
+                ladybug5_network::pbImage* out = header.add_images();
+                out->CopyFrom(image_msg);
+                out->set_width(image_msg.width() / scale);
+                out->set_height(image_msg.height() / scale);
+                images.push_back(encoded[key]);
+            }
+            if(images.empty()) continue;
+            _TIME
+
+            status = "compresseionThread serialise and send";
+            Span send_span("serialize and send");
+            Parts frame; // latest only: the slot of the profile replaces the route
+            if(mailboxes != NULL){
+                frame.push_back(new zmq::message_t());
+                pb_serialize(frame.back(), &header, &compress_trace);
+            }else{
+                /* first part tells the sendingThread the profile */
+                zmq::message_t route(sizeof(profile_nr));
+                memcpy(route.data(), &profile_nr, sizeof(profile_nr));
+                socket_out.send(route, ZMQ_SNDMORE);
+
+                pb_send(&socket_out, &header, &compress_trace, ZMQ_SNDMORE);
+            }
 
-        pb_send(&socket_out, &pb_msg, ZMQ_SNDMORE);
+            for(size_t img = 0; img < images.size(); ++img){
+                ladybug5_network::ImageType type = header.images(img).type();
+                if(image_counters.find(type) == image_counters.end()){
+                    image_counters[type] = Metrics::instance().counter("bytes." + enumToString(type));
+                }
+                Metrics::instance().count(image_counters[type], images[img]->size());
 
-        for(int i=0; i < numImages; ++i){
-            socket_out.send(buffer[i], i == numImages-1 ? 0 : ZMQ_SNDMORE);
+                if(mailboxes != NULL){
+                    frame.push_back(new zmq::message_t());
+                    frame.back()->copy(images[img]); // shares the buffer
+                }else{
+                    zmq::message_t part;
+                    part.copy(images[img]); // shares the buffer
+                    socket_out.send(part, img == images.size()-1 ? 0 : ZMQ_SNDMORE);
+                }
+            }
+            if(mailboxes != NULL){
+                mailboxes->compressed->put(profile_nr, frame, pb_msg.id());
+            }
         }
 
+        for(std::map<unsigned long long, zmq::message_t*>::iterator it = encoded.begin(); it != encoded.end(); ++it){
+            delete it->second;
+        }
 		pb_msg.Clear();
+        pb_extension.Clear();
         _TIME
 	}
 }
-
@@ -3,11 +3,24 @@
 
 int thread_ladybug()
 {
+    Subscriptions subscribers; // direct output to ROS_MASTER
+    Outputs* outputs = NULL; // compressed output, shared with the compression and sending threads
+    Mailboxes* latest_only = NULL; // NULL: zmq queues between the stages
+    bool paused = false;
+    unsigned int frames_grabbed = Metrics::instance().counter("frames.grabbed");
+    unsigned int frames_skipped = Metrics::instance().counter("frames.skipped");
+    unsigned int frames_sent = Metrics::instance().counter("frames.sent");
+    unsigned int frames_paused = Metrics::instance().counter("frames.paused");
+    unsigned int frames_delivered = Metrics::instance().counter("frames.delivered");
+    unsigned int bytes_sent = Metrics::instance().counter("bytes.sent");
+    unsigned int drops_budget = Metrics::instance().counter("drops.budget");
 _RESTART:
 	zmq::context_t zmq_context(2);
     boost::thread_group threads;
     zmq::socket_t* socket = NULL;
-	double t_now = clock();	
+    CalibrationChannel* calibration = NULL;
+    SensorPublisher* sensors = NULL;
+	double t_now = monotonic_us();	
 	unsigned int uiRawCols = 0;
 	unsigned int uiRawRows = 0;
     LadybugError error;
@@ -22,6 +35,18 @@ _RESTART:
         if(lady == NULL){
             lady = new Ladybug();
         }
+        if(lady->config->cfg_allocations){
+            Allocations::enabled = true;
+            Metrics::enabled = true;
+        }
+        Metrics::instance().start_reporting(lady->config->cfg_metrics_interval);
+        MemoryBudget::instance().configure((unsigned long long)lady->config->cfg_memory_budget << 20, lady->config->cfg_shedding_policy, lady->config->cfg_admission_wait);
+        LoadShedder::instance().configure(lady->config->cfg_shed_target_lag, lady->config->cfg_shed_essential, lady->config->cfg_shed_scale);
+        ThreadAffinity::instance().configure(lady->config->cfg_thread_cores, lady->config->cfg_thread_priority, lady->config->cfg_reserve_cores);
+        ThreadAffinity::instance().apply(&zmq_context); // before the first socket
+        ThreadAffinity::instance().apply_current(THREAD_CAPTURE);
+        Spans::instance().start(lady->config->cfg_spans, lady->config->cfg_span_events);
+        Spans::instance().name_thread("capture");
     
 
     std::string status;
@@ -45,37 +70,62 @@ _RESTART:
 
     { 
         std::string connection;
-        int socket_type = ZMQ_PUB;
+        int socket_type = ZMQ_XPUB;
         bool zmq_bind = false;
+        bool use_profiles = false;
 
         if( lady->config->cfg_transfer_compressed && (lady->config->cfg_ladybug_colorProcessing || lady->config->cfg_panoramic)){
             connection = zmq_uncompressed;
             socket_type = ZMQ_PUSH;
             zmq_bind = true;
-            
-            for(unsigned int i=0; i < boost::thread::hardware_concurrency(); ++i){
-        	   threads.create_thread(std::bind(compressionThread, &zmq_context, i)); //worker thread (jpg-compression)
+            use_profiles = true;
+            if(outputs == NULL){
+                outputs = new Outputs(lady->config->cfg_output_profiles);
+            }
+            if(latest_only == NULL && lady->config->cfg_latest_only){
+                latest_only = new Mailboxes();
+                latest_only->uncompressed = new Mailbox();
+                latest_only->compressed = new Mailbox(outputs->size());
             }
-            threads.create_thread(std::bind(sendingThread, &zmq_context));
+            
+            /* the encoders are the workers of the TaskScheduler, the pool decides how many of them take tasks */
+            unsigned int task_threads = lady->config->cfg_task_threads > 0 ? lady->config->cfg_task_threads : ThreadAffinity::instance().core_count(THREAD_COMPRESSION);
+            unsigned int workers = lady->config->cfg_compression_threads > 0 ? lady->config->cfg_compression_threads : task_threads;
+            TaskScheduler::instance().start(task_threads);
+            CompressionPool::instance().configure(lady->config->cfg_min_compression_threads, workers, lady->config->cfg_compression_autotune);
+            zmq::context_t* p_zmqcontext = &zmq_context;
+            CompressionPool::instance().start([&threads, p_zmqcontext, outputs, latest_only](unsigned int generation){
+        	   ThreadAffinity::instance().apply(threads.create_thread(std::bind(compressionThread, p_zmqcontext, generation, outputs, latest_only)), THREAD_COMPRESSION); // dispatches the jpg-compression of the frames
+            });
+            ThreadAffinity::instance().apply(threads.create_thread(std::bind(sendingThread, &zmq_context, outputs, (int)lady->config->cfg_hwm, latest_only)), THREAD_SENDING);
         }else{
             connection = lady->config->cfg_ros_master.c_str();
         }
 
         status = "connect with zmq to " + connection;
 
-	    socket = new zmq::socket_t(zmq_context, socket_type);
-	    int val = 6; //buffer size
-	    socket->setsockopt(ZMQ_RCVHWM, &val, sizeof(val));  //prevent buffer get overfilled
-	    socket->setsockopt(ZMQ_SNDHWM, &val, sizeof(val));  //prevent buffer get overfilled
-        
-        if(zmq_bind){
-            socket->bind(connection.c_str());
+	    int val = lady->config->cfg_hwm; //buffer size
+        if(socket_type == ZMQ_XPUB){
+            subscribers.clear();
+            socket = create_xpub(&zmq_context, connection, val, zmq_bind);
+            monitor_socket(&zmq_context, socket, "ros_master");
         }else{
-            socket->connect(connection.c_str());
+	        socket = new zmq::socket_t(zmq_context, socket_type);
+	        socket->setsockopt(ZMQ_RCVHWM, &val, sizeof(val));  //prevent buffer get overfilled
+	        socket->setsockopt(ZMQ_SNDHWM, &val, sizeof(val));  //prevent buffer get overfilled
+        
+            if(zmq_bind){
+                socket->bind(connection.c_str());
+            }else{
+                socket->connect(connection.c_str());
+            }
         }
 	    _TIME
 
 	    ladybug5_network::pbMessage message;
+        ladybug5_network::pbMessageExtension header_extension;
+        ladybug5_network::pbTrace* trace = header_extension.mutable_trace();
+        CycleTimeMapping cycle_time;
         ladybug5_network::LadybugTimeStamp msg_timestamp;
 
         ladybug5_network::pbFloatTriblet gyro;
@@ -107,26 +157,114 @@ _RESTART:
             _TIME
         }
 
+        /* The calibration is latched on its own channel, the frames only carry the hash */
+        status = "publish calibration on " + lady->config->cfg_calibration;
+        {
+            ladybug5_network::pbCalibration calibration_msg;
+            calibration_msg.set_serial_number(std::to_string(lady->caminfo.serialBase));
+            for( unsigned int uiCamera = 0; uiCamera < LADYBUG_NUM_CAMERAS; uiCamera++ ){
+                add_camera_calibration(&calibration_msg, uiCamera, position[uiCamera], disortion[uiCamera]);
+            }
+            calibration = new CalibrationChannel(&zmq_context, lady->config->cfg_calibration);
+            header_extension.set_calibration_hash(calibration->set(calibration_msg));
+        }
+        if(!lady->config->cfg_sensors.empty()){
+            sensors = new SensorPublisher(&zmq_context, lady->config->cfg_sensors, std::to_string(lady->caminfo.serialBase));
+        }
+        if(!lady->config->cfg_stats.empty()){
+            threads.create_thread(std::bind(statsThread, &zmq_context, lady->config->cfg_stats, lady->config->cfg_stats_interval, std::to_string(lady->caminfo.serialBase)));
+        }
+        _TIME
+
+        if(!filestream){
+            cycle_time.sync(lady->context);
+        }
+
         unsigned int nr = 0;
-        double loopstart = t_now = clock();		
+        double loopstart = t_now = monotonic_us();		
        
         printf("Running...\n");
 
 	    while(!done)
 	    {
 		    try{
-			    loopstart = t_now = clock();
+			    loopstart = t_now = monotonic_us();
 			    t_now = loopstart;
 
 			    // Grab an image from the camera
 			    std::string status = "grab image";
+                calibration->update();
+
+                /* Without subscribers the images are only grabbed to keep the camera running */
+                unsigned int wanted = PROFILE_ALL_IMAGES;
+                if(socket_type == ZMQ_XPUB){
+                    subscribers.update(socket);
+                }
+                bool subscribed = use_profiles ? outputs->has_subscribers() : subscribers.has_subscribers();
+                if(use_profiles){
+                    wanted = outputs->wanted_images(nr); // 0 if no profile wants this frame (RateDivisor)
+                }
+                if(paused != !subscribed){
+                    paused = !paused;
+                    printf(paused ? "No subscribers, pausing...\n" : "Subscriber connected, resuming...\n");
+                }
+                if(!lady->config->cfg_panoramic){
+                    wanted &= ~PROFILE_PANORAMIC;
+                }
+                unsigned int scale = 1; // downscale of the camera images by the load shedding
+                if(!paused){
+                    wanted = LoadShedder::instance().apply(wanted, &scale);
+                }
+                bool panoramic = (wanted & PROFILE_PANORAMIC) != 0;
 
 			    /* Get ladybugImage */
+                Span grab_span("grab");
                 error = lady->grabImage(&image);
                 
 			    _HANDLE_ERROR
+                grab_span.end();
+                trace->Clear();
+                trace->set_grab_us(monotonic_us());
+                trace_stage(trace, ladybug5_network::TRACE_GRAB);
+                Metrics::instance().count(frames_grabbed);
+                CompressionPool::instance().report_frame();
+                if(sensors != NULL){
+                    sensors->publish(image, nr); // ahead of the image parts, also while paused
+                }
 			    _TIME
 
+                /* admission: the frame only enters the pipeline if its raw data fits in the memory budget */
+                bool admitted = true;
+                if(!paused && wanted != 0){
+                    bool processing = lady->config->cfg_ladybug_colorProcessing || lady->config->cfg_panoramic;
+                    unsigned long long frame_bytes = processing ? (unsigned long long)lady->getBuffer()->size * LADYBUG_NUM_CAMERAS : image.uiDataSizeBytes;
+                    if(panoramic){
+                        frame_bytes += (unsigned long long)lady->config->cfg_pano_width * lady->config->cfg_pano_hight * 3;
+                    }
+                    admitted = MemoryBudget::instance().admit(frame_bytes);
+                    if(!admitted){
+                        Metrics::instance().count(drops_budget);
+                    }
+                }
+                if(paused || wanted == 0 || !admitted){
+                    Metrics::instance().count(frames_skipped);
+                    if(paused) Metrics::instance().count(frames_paused);
+                    if(paused && filestream){
+                        Sleep(lady->getCycleTime());
+                    }
+                    ++nr;
+                    continue;
+                }
+                if(!filestream && nr % 1000 == 0){
+                    cycle_time.sync(lady->context); // follow the drift of the clocks
+                }
+                trace->set_cycle_offset_us(cycle_time.update(image.timeStamp, trace->grab_us()));
+                if(scale > 1){
+                    header_extension.set_scale(scale);
+                }else{
+                    header_extension.clear_scale();
+                }
+
                 /* Create and fill protobuf message */
                 message.set_name("windows");
 			    message.set_camera("ladybug5");
@@ -164,14 +302,13 @@ _RESTART:
 
                 for( unsigned int uiCamera = 0; uiCamera < LADYBUG_NUM_CAMERAS; uiCamera++ )
 		        {
+                    if(!(wanted & (1 << uiCamera))) continue; // shed or not subscribed
 			        ladybug5_network::pbImage* image_msg = 0;
 			        image_msg = message.add_images();
 			        image_msg->set_type((ladybug5_network::ImageType) ( 1 << uiCamera));
 			        image_msg->set_name(enumToString(image_msg->type()));
 			        image_msg->set_height(uiRawRows);
                     image_msg->set_width(uiRawCols);
-                    image_msg->set_allocated_distortion(new ladybug5_network::pbDisortion(disortion[uiCamera]));
-                    image_msg->set_allocated_position(new ladybug5_network::pbPosition(position[uiCamera]));
                     if(separatedColors && !lady->config->cfg_ladybug_colorProcessing && !lady->config->cfg_panoramic){
                         image_msg->set_packages(3);
                     }else{
@@ -179,8 +316,8 @@ _RESTART:
                     }
                 }
 
-                /* Add panoramic image to pb message */
-                if(lady->config->cfg_panoramic){  
+                /* Add panoramic image to pb message, only rendered if a profile wants it */
+                if(panoramic){  
                     ladybug5_network::pbImage* image_msg = 0;
 			        image_msg = message.add_images();
                     image_msg->set_type(ladybug5_network::LADYBUG_PANORAMIC);
@@ -190,49 +327,80 @@ _RESTART:
                     image_msg->set_packages(1);
                 }
 
-                pb_send(socket, &message, ZMQ_SNDMORE);
+                trace_stage(trace, ladybug5_network::TRACE_HEADER);
 
                 if(lady->config->cfg_ladybug_colorProcessing || lady->config->cfg_panoramic)
                 {                    
-                    int flag = ZMQ_SNDMORE;
+                    /* the header goes first but carries the trace of the render, the images wait for it */
+                    zmq::message_t raw_images[LADYBUG_NUM_CAMERAS + 1];
+                    unsigned int nr_images = 0;
 				    status = "Adding images with processing";
 				    for( unsigned int uiCamera = 0; uiCamera < LADYBUG_NUM_CAMERAS; uiCamera++ )
 				    {
-                        zmq::message_t raw_image(lady->getBuffer()->size);
-                        memcpy(raw_image.data(), lady->getBuffer()->getBuffer(uiCamera), lady->getBuffer()->size);
-                           
-                        if( !lady->config->cfg_panoramic && uiCamera == LADYBUG_NUM_CAMERAS-1 ){
-                            flag = 0;
-                        }
-                        socket->send(raw_image, flag ); // send BGRU images
+                        if(!(wanted & (1 << uiCamera))) continue; // shed camera
+                        MemoryBudget::instance().message(&raw_images[nr_images], lady->getBuffer()->size);
+                        memcpy(raw_images[nr_images].data(), lady->getBuffer()->getBuffer(uiCamera), lady->getBuffer()->size);
+                        ++nr_images;
 				    }
 				    _TIME
 
-                    if(lady->config->cfg_panoramic){
+                    if(panoramic){
 				        status = "create panorame in graphics card";
 				        // Stitch the images (inside the graphics card) and retrieve the output to the user's memory
 				        LadybugProcessedImage processedImage;
                         error = lady->grabProcessedImage(&processedImage, LADYBUG_PANORAMIC);
 				        _HANDLE_ERROR
+                        trace_stage(trace, ladybug5_network::TRACE_RENDER);
 				        _TIME
 			
 				        status = "Add image to message"; 
                         unsigned int size = processedImage.uiCols*processedImage.uiRows*3;
-                        zmq::message_t raw_image(size);
-                        memcpy(raw_image.data(), processedImage.pData, size);                    
-                        socket->send(raw_image, 0 ); // panoramic is the last image
+                        MemoryBudget::instance().message(&raw_images[nr_images], size);
+                        memcpy(raw_images[nr_images].data(), processedImage.pData, size); // panoramic is the last image
+                        ++nr_images;
                         _TIME
 			        }
 			        status = "send img over network";
-                    
+                    Span send_span("send");
+                    trace_stage(trace, ladybug5_network::TRACE_ENQUEUE);
+                    if(use_profiles && latest_only != NULL){
+                        Parts frame; // replaces a frame the compressionThreads did not take yet
+                        frame.push_back(new zmq::message_t());
+                        pb_serialize(frame.back(), &message, &header_extension);
+                        for(unsigned int i = 0; i < nr_images; ++i){
+                            frame.push_back(new zmq::message_t());
+                            frame.back()->move(&raw_images[i]);
+                        }
+                        latest_only->uncompressed->put(0, frame, message.id());
+                    }else{
+                        pb_send(socket, &message, &header_extension, ZMQ_SNDMORE);
+                        for(unsigned int i = 0; i < nr_images; ++i){
+                            if(!use_profiles){
+                                Metrics::instance().count(bytes_sent, raw_images[i].size());
+                            }
+                            socket->send(raw_images[i], i == nr_images-1 ? 0 : ZMQ_SNDMORE ); // send BGRU images
+                        }
+                    }
+                    if(!use_profiles){
+                        Metrics::instance().count(frames_sent); // the sendingThread counts the compressed frames
+                        Metrics::instance().count(frames_delivered);
+                    }
                     _TIME
                 }else{ //No post processing, no panoramic picture
+                    Span send_span("send");
+                    trace_stage(trace, ladybug5_network::TRACE_ENQUEUE);
+                    pb_send(socket, &message, &header_extension, ZMQ_SNDMORE);
                     
                     status = "send image " + std::to_string(nr);
                     int flag = ZMQ_SNDMORE;
+                    unsigned int last_camera = 0;
+                    for( unsigned int uiCamera = 0; uiCamera < LADYBUG_NUM_CAMERAS; uiCamera++ ){
+                        if(wanted & (1 << uiCamera)) last_camera = uiCamera;
+                    }
 
                     for( unsigned int uiCamera = 0; uiCamera < LADYBUG_NUM_CAMERAS; uiCamera++ )
                     {
+                        if(!(wanted & (1 << uiCamera))) continue; // shed camera
                         unsigned int index = uiCamera*4;
                         //send images 
                      
@@ -245,24 +413,28 @@ _RESTART:
                         extractImageToMsg(&image, index+green_offset,   &g_data, g_size);
                         extractImageToMsg(&image, index+red_offset,     &r_data, r_size);
                             
-                        if( uiCamera == LADYBUG_NUM_CAMERAS-1 ){
+                        if( uiCamera == last_camera ){
                             flag = 0;
                         }
 
                         if(separatedColors){
 
                             //RGB expected at reciever
-                            zmq::message_t R(r_size);
+                            zmq::message_t R;
+                            MemoryBudget::instance().message(&R, r_size);
                             memcpy(R.data(), r_data, r_size);
                             socket->send(R, ZMQ_SNDMORE ); // Red = Index + 3
 
-                            zmq::message_t G(g_size);
+                            zmq::message_t G;
+                            MemoryBudget::instance().message(&G, g_size);
                             memcpy(G.data(), g_data, g_size);
                             socket->send(G, ZMQ_SNDMORE ); // Green = Index + 1 || 2
 
-                            zmq::message_t B(b_size);     // Blue = Index 0
+                            zmq::message_t B;
+                            MemoryBudget::instance().message(&B, b_size);     // Blue = Index 0
                             memcpy(B.data(), b_data, b_size);
                             socket->send(B, flag );
+                            Metrics::instance().count(bytes_sent, r_size + g_size + b_size);
 
                         }else{ /* RGGB RAW */
                             assert(r_size == g_size);
@@ -275,6 +447,8 @@ _RESTART:
                             throw new std::exception("RGB8 uncompressed not supported");
                         }          
                     }
+                    Metrics::instance().count(frames_sent);
+                    Metrics::instance().count(frames_delivered);
                 }
                 message.Clear();
                 msg_timestamp.Clear();
@@ -301,10 +475,18 @@ _RESTART:
 _EXIT:
 	google::protobuf::ShutdownProtobufLibrary();
     if(socket != NULL){
+        unmonitor_socket(socket);
         socket->close();
         delete socket;
     }
+    if(calibration != NULL){
+        delete calibration;
+    }
+    if(sensors != NULL){
+        delete sensors;
+    }
 	
+    CompressionPool::instance().stop();
     if(done){
        Sleep(5000);
        threads.interrupt_all();
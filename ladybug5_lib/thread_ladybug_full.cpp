@@ -1,13 +1,47 @@
 #include "thread_functions.h"
 #include "timing.h"
 
-int thread_ladybug_full(zmq::context_t* zmq_context)
+int thread_ladybug_full(zmq::context_t* zmq_context, Standby* standby)
 {
-_RESTART:
+    Subscriptions subscribers; // direct output to ROS_MASTER
+    Outputs outputs(cfg_output_profiles); // compressed output, shared with the compression and sending threads, survives restarts like the threads
+    Mailbox uncompressed_mailbox;
+    Mailbox compressed_mailbox(outputs.size());
+    Mailboxes mailboxes = { &uncompressed_mailbox, &compressed_mailbox };
+    Mailboxes* latest_only = cfg_latest_only ? &mailboxes : NULL; // NULL: zmq queues between the stages
+    bool paused = false;
+    if(cfg_allocations){
+        Allocations::enabled = true;
+        Metrics::enabled = true;
+    }
+    Metrics::instance().start_reporting(cfg_metrics_interval);
+    Spans::instance().start(cfg_spans, cfg_span_events);
+    Spans::instance().name_thread("capture");
+    unsigned int frames_grabbed = Metrics::instance().counter("frames.grabbed");
+    unsigned int frames_skipped = Metrics::instance().counter("frames.skipped");
+    unsigned int frames_sent = Metrics::instance().counter("frames.sent");
+    unsigned int frames_paused = Metrics::instance().counter("frames.paused");
+    unsigned int frames_delivered = Metrics::instance().counter("frames.delivered");
+    unsigned int frame_latency = Metrics::instance().stage(HEALTH_LATENCY_STAGE);
+    unsigned int bytes_sent = Metrics::instance().counter("bytes.sent");
+    unsigned int drops_pool = Metrics::instance().counter("drops.pool");
+    unsigned int drops_budget = Metrics::instance().counter("drops.budget");
+    MemoryBudget::instance().configure((unsigned long long)cfg_memory_budget << 20, cfg_shedding_policy, cfg_admission_wait);
+    LoadShedder::instance().configure(cfg_shed_target_lag, cfg_shed_essential, cfg_shed_scale);
+    ThreadAffinity::instance().configure(cfg_thread_cores, cfg_thread_priority, cfg_reserve_cores);
+    ThreadAffinity::instance().apply_current(THREAD_CAPTURE);
+    Recovery recovery(cfg_grab_retries, cfg_max_backoff);
+    /* Kept when the context is rebuilt, only the Ladybug context depends on the camera */
     boost::thread_group threads;
+    bool threads_started = false;
     zmq::socket_t* socket = NULL;
     zmq::socket_t* socket_watchdog = NULL;
-	double t_now = clock();	
+    CalibrationChannel* calibration = NULL;
+    SensorPublisher* sensors = NULL;
+    FirstFrameClock first_frame;
+_RESTART:
+    first_frame.start(threads_started);
+	double t_now = monotonic_us();	
 	unsigned int uiRawCols = 0;
 	unsigned int uiRawRows = 0;
     LadybugError error;
@@ -24,22 +58,77 @@ _RESTART:
     //create watchdog
     //-----------------------------------------------
     int val_watchdog = 1;
-    socket_watchdog = new zmq::socket_t(*zmq_context, ZMQ_PUSH);
-	socket_watchdog->setsockopt(ZMQ_RCVHWM, &val_watchdog, sizeof(val_watchdog));  //prevent buffer get overfilled
-	socket_watchdog->setsockopt(ZMQ_SNDHWM, &val_watchdog, sizeof(val_watchdog));
-    socket_watchdog->connect("inproc://watchdog");
+    if(socket_watchdog == NULL){
+        socket_watchdog = new zmq::socket_t(*zmq_context, ZMQ_PUSH);
+	    socket_watchdog->setsockopt(ZMQ_RCVHWM, &val_watchdog, sizeof(val_watchdog));  //prevent buffer get overfilled
+	    socket_watchdog->setsockopt(ZMQ_SNDHWM, &val_watchdog, sizeof(val_watchdog));
+        socket_watchdog->connect(WATCHDOG_ENDPOINT);
+    }
     zmq::message_t msg_watchdog;
-    socket_watchdog->send(msg_watchdog);
+    watchdog_starting(socket_watchdog); // no heartbeats while the camera starts
+
+    bool processing = cfg_postprocessing || cfg_panoramic;
 
     //-----------------------------------------------
-    // only on for if processing is enabled
+    // output, none of it needs the camera: a standby has it ready before the promotion
     //-----------------------------------------------
-    unsigned int arpBufferSize = 0;
-	unsigned char* arpBuffers[ LADYBUG_NUM_CAMERAS ];
-    for( unsigned int uiCamera = 0; uiCamera < LADYBUG_NUM_CAMERAS; uiCamera++ )
-	{
-		arpBuffers[ uiCamera ] = NULL;
-	}
+    std::string connection;
+    int socket_type = ZMQ_XPUB;
+    bool zmq_bind = false;
+    bool use_profiles = false;
+
+    if( cfg_transfer_compressed && (cfg_postprocessing || cfg_panoramic)){
+        connection = zmq_uncompressed;
+        socket_type = ZMQ_PUSH;
+        zmq_bind = true;
+        use_profiles = true;
+        
+        if(!threads_started){
+            /* the encoders are the workers of the TaskScheduler, the pool decides how many of them take tasks */
+            unsigned int task_threads = cfg_task_threads > 0 ? cfg_task_threads : ThreadAffinity::instance().core_count(THREAD_COMPRESSION);
+            unsigned int workers = cfg_compression_threads > 0 ? cfg_compression_threads : task_threads;
+            TaskScheduler::instance().start(task_threads);
+            CompressionPool::instance().configure(cfg_min_compression_threads, workers, cfg_compression_autotune);
+            CompressionPool::instance().start([&threads, zmq_context, &outputs, latest_only](unsigned int generation){
+    	       ThreadAffinity::instance().apply(threads.create_thread(std::bind(compressionThread, zmq_context, generation, &outputs, latest_only)), THREAD_COMPRESSION); // dispatches the jpg-compression of the frames
+            });
+            ThreadAffinity::instance().apply(threads.create_thread(std::bind(sendingThread, zmq_context, &outputs, (int)cfg_hwm, latest_only)), THREAD_SENDING);
+        }
+    }else{
+        connection = cfg_ros_master.c_str();
+    }
+
+    status = "connect with zmq to " + connection;
+
+    int val = cfg_hwm; //buffer size
+    /* The first time and after a failure of the socket, the rest of the loop stays */
+    auto open_socket = [&](){
+        if(socket_type == ZMQ_XPUB){
+            subscribers.clear();
+            socket = create_xpub(zmq_context, connection, val, zmq_bind);
+            monitor_socket(zmq_context, socket, "ros_master");
+        }else{
+            socket = new zmq::socket_t(*zmq_context, socket_type);
+            socket->setsockopt(ZMQ_RCVHWM, &val, sizeof(val));  //prevent buffer get overfilled
+            socket->setsockopt(ZMQ_SNDHWM, &val, sizeof(val));  //prevent buffer get overfilled
+    
+            if(zmq_bind){
+                socket->bind(connection.c_str());
+            }else{
+                socket->connect(connection.c_str());
+            }
+        }
+    };
+    if(socket == NULL){
+        open_socket();
+    }
+    if(calibration == NULL){
+        calibration = new CalibrationChannel(zmq_context, cfg_calibration);
+    }
+    if(!cfg_sensors.empty() && sensors == NULL){
+        sensors = new SensorPublisher(zmq_context, cfg_sensors, ""); // the serial is set with the camera
+    }
+    _TIME
 
     //-----------------------------------------------
     // only for filestream mode
@@ -60,6 +149,17 @@ _RESTART:
 	error = ladybugCreateContext( &context );
 	_HANDLE_ERROR
 	_TIME
+    if(standby != NULL){ // everything up to here is warm, the active instance still has the camera
+        unsigned int last_cols, last_rows;
+        if(processing && prepareAlphaMasksCached(cfg_processing_cache, cfg_ladybug_colorProcessing, cfg_pano_width, cfg_pano_hight, &last_cols, &last_rows)){
+            FramePool::instance().configure(last_cols * last_rows * 4, cfg_inflight_frames, cfg_huge_pages); // the size of the last camera, kept if it is the same
+        }
+        standby->wait();
+        delete standby;
+        standby = NULL;
+        first_frame.takeover();
+        t_now = monotonic_us();
+    }
 	status = "Initialize the camera";
 
     if( !filestream ){ // filestream is empty start live cam
@@ -122,7 +222,7 @@ _RESTART:
     }
 	
 	// Set the size of the image to be processed
-    if(cfg_postprocessing || cfg_panoramic){
+    if(processing){
         status = "inspect image size";
         if (cfg_ladybug_colorProcessing == LADYBUG_DOWNSAMPLE4 || 
 	        cfg_ladybug_colorProcessing == LADYBUG_MONO)
@@ -136,11 +236,17 @@ _RESTART:
         // Initialize alpha mask size - this can take a long time if the
 	    // masks are not present in the current directory.
 	    status = "Initializing alpha masks (this may take some time)...";
-	    error = ladybugInitializeAlphaMasks( context, uiRawCols, uiRawRows );
+        unsigned int serial = filestream ? streamHeadInfo.serialBase : 0;
+        LadybugCameraInfo cache_info;
+        if(!filestream && ladybugGetCameraInfo(context, &cache_info) == LADYBUG_OK){
+            serial = cache_info.serialBase;
+        }
+	    /* BGRU planes for ladybugConvertImage, kept over restarts. Mapping the pages does not need the context, it runs while the masks load */
+	    boost::thread pool_setup(boost::bind(&FramePool::configure, &FramePool::instance(), uiRawCols * uiRawRows * 4, cfg_inflight_frames, cfg_huge_pages));
+	    error = initializeAlphaMasksCached( context, cfg_processing_cache, serial, uiRawCols, uiRawRows, cfg_ladybug_colorProcessing, cfg_pano_width, cfg_pano_hight );
+	    pool_setup.join();
 	    _HANDLE_ERROR
 
-	    arpBufferSize = initBuffers(arpBuffers, LADYBUG_NUM_CAMERAS, uiRawCols, uiRawRows, 4);
-
     }else if(separatedColors){
         uiRawCols = image.uiFullCols / 2;
 	    uiRawRows = image.uiFullRows / 2;
@@ -152,38 +258,10 @@ _RESTART:
 	_TIME
 
     { 
-        std::string connection;
-        int socket_type = ZMQ_PUB;
-        bool zmq_bind = false;
-
-        if( cfg_transfer_compressed && (cfg_postprocessing || cfg_panoramic)){
-            connection = zmq_uncompressed;
-            socket_type = ZMQ_PUSH;
-            zmq_bind = true;
-            
-            for(unsigned int i=0; i < boost::thread::hardware_concurrency(); ++i){
-        	   threads.create_thread(std::bind(compressionThread, zmq_context, i)); //worker thread (jpg-compression)
-            }
-            threads.create_thread(std::bind(sendingThread, zmq_context));
-        }else{
-            connection = cfg_ros_master.c_str();
-        }
-
-        status = "connect with zmq to " + connection;
-
-	    socket = new zmq::socket_t(*zmq_context, socket_type);
-	    int val = 6; //buffer size
-	    socket->setsockopt(ZMQ_RCVHWM, &val, sizeof(val));  //prevent buffer get overfilled
-	    socket->setsockopt(ZMQ_SNDHWM, &val, sizeof(val));  //prevent buffer get overfilled
-        
-        if(zmq_bind){
-            socket->bind(connection.c_str());
-        }else{
-            socket->connect(connection.c_str());
-        }
-	    _TIME
-
 	    ladybug5_network::pbMessage message;
+        ladybug5_network::pbMessageExtension header_extension;
+        ladybug5_network::pbTrace* trace = header_extension.mutable_trace();
+        CycleTimeMapping cycle_time;
         ladybug5_network::LadybugTimeStamp msg_timestamp;
 
         ladybug5_network::pbFloatTriblet gyro;
@@ -227,30 +305,158 @@ _RESTART:
             _TIME
         }
 
+        /* The calibration is latched on its own channel, the frames only carry the hash */
+        status = "publish calibration on " + cfg_calibration;
+        {
+            ladybug5_network::pbCalibration calibration_msg;
+            calibration_msg.set_serial_number(std::to_string(info.serialBase));
+            for( unsigned int uiCamera = 0; uiCamera < LADYBUG_NUM_CAMERAS; uiCamera++ ){
+                add_camera_calibration(&calibration_msg, uiCamera, position[uiCamera], disortion[uiCamera]);
+            }
+            header_extension.set_calibration_hash(calibration->set(calibration_msg));
+        }
+        if(sensors != NULL){
+            sensors->set_serial_number(std::to_string(info.serialBase));
+        }
+        if(!cfg_stats.empty() && !threads_started){
+            threads.create_thread(std::bind(statsThread, zmq_context, cfg_stats, cfg_stats_interval, std::to_string(info.serialBase)));
+        }
+        threads_started = true;
+        _TIME
+
+        if(!filestream){
+            cycle_time.sync(context);
+        }
+
         unsigned int nr = 0;
-        double loopstart = t_now = clock();		
+        double loopstart = t_now = monotonic_us();		
        
         printf("Running...\n");
 
 	    while(!done)
 	    {
 		    try{
-			    loopstart = t_now = clock();
+			    loopstart = t_now = monotonic_us();
 			    t_now = loopstart;
 
 
 			    // Grab an image from the camera
 			    std::string status = "grab image";
+                /* BGRU planes of this frame, the frame goes back to the pool when the last plane is sent or dropped */
+                zmq::message_t raw_images[LADYBUG_NUM_CAMERAS + 1];
+                unsigned char* arpBuffers[LADYBUG_NUM_CAMERAS];
+                calibration->update();
+
+                /* Without subscribers the images are only grabbed to keep the camera running */
+                unsigned int wanted = PROFILE_ALL_IMAGES;
+                if(socket_type == ZMQ_XPUB){
+                    subscribers.update(socket);
+                }
+                bool subscribed = use_profiles ? outputs.has_subscribers() : subscribers.has_subscribers();
+                if(use_profiles){
+                    wanted = outputs.wanted_images(nr); // 0 if no profile wants this frame (RateDivisor)
+                }
+                if(paused != !subscribed){
+                    paused = !paused;
+                    printf(paused ? "No subscribers, pausing...\n" : "Subscriber connected, resuming...\n");
+                }
+                if(!cfg_panoramic){
+                    wanted &= ~PROFILE_PANORAMIC;
+                }
+                unsigned int scale = 1; // downscale of the camera images by the load shedding
+                if(!paused){
+                    wanted = LoadShedder::instance().apply(wanted, &scale);
+                }
+                bool panoramic = (wanted & PROFILE_PANORAMIC) != 0;
 
 			    /* Get ladybugImage */
+                Span grab_span("grab");
                 if( filestream ){
                     error = ladybugReadImageFromStream( streamContext, &image);
                 }else{
                     error = ladybugGrabImage(context, &image); 
                 }
-			    _HANDLE_ERROR
+                if(error != LADYBUG_OK){
+                    printf("Error! While %s. Ladybug library reported %s\n", status.c_str(), ::ladybugErrorToString(error));
+                    RecoveryTier tier = filestream ? RECOVER_CONTEXT : recovery.escalate(error);
+                    if(tier == RECOVER_RETRY){
+                        recovery.begin(RECOVER_RETRY);
+                        socket_watchdog->send(msg_watchdog,ZMQ_NOBLOCK);
+                        continue;
+                    }
+                    if(tier == RECOVER_CAMERA){
+                        recovery.begin(RECOVER_CAMERA);
+                        status = "restart the camera";
+                        watchdog_starting(socket_watchdog);
+                        unsigned int backoff = recovery.backoff_ms();
+                        if(backoff > 0){
+                            printf("Waiting %u ms...\n", backoff);
+                            Sleep(backoff);
+                        }
+                        error = restartLadybug(context);
+                        if(error == LADYBUG_OK){
+                            cycle_time.sync(context);
+                            socket_watchdog->send(msg_watchdog,ZMQ_NOBLOCK);
+                            continue;
+                        }
+                    }
+                    goto _EXIT; // rebuild the context
+                }
+                recovery.recovered();
+                grab_span.end();
+                trace->Clear();
+                trace->set_grab_us(monotonic_us());
+                trace_stage(trace, ladybug5_network::TRACE_GRAB);
+                Metrics::instance().count(frames_grabbed);
+                CompressionPool::instance().report_frame();
+                if(sensors != NULL){
+                    sensors->publish(image, nr); // ahead of the image parts, also while paused
+                }
 			    _TIME
 
+                /* admission: the frame only enters the pipeline if its raw data fits in the memory budget */
+                bool admitted = true;
+                bool buffered = false;
+                if(!paused && wanted != 0){
+                    unsigned long long frame_bytes = processing ? (unsigned long long)FramePool::instance().plane_size() * LADYBUG_NUM_CAMERAS : image.uiDataSizeBytes;
+                    if(panoramic){
+                        frame_bytes += (unsigned long long)cfg_pano_width * cfg_pano_hight * 3;
+                    }
+                    admitted = MemoryBudget::instance().admit(frame_bytes);
+                    if(!admitted){
+                        Metrics::instance().count(drops_budget);
+                    }else if(processing){
+                        buffered = FramePool::instance().acquire(raw_images, arpBuffers);
+                        if(!buffered){
+                            Metrics::instance().count(drops_pool); // all frames in flight, the consumers are behind
+                        }
+                    }
+                }
+                if(paused || wanted == 0 || !admitted || (processing && !buffered)){
+                    Metrics::instance().count(frames_skipped);
+                    if(paused) Metrics::instance().count(frames_paused);
+                    if(filestream){
+                        nr = (nr + 1) % stream_image_count;
+                        ladybugGoToImage( streamContext, nr);
+                        if(paused){
+                            Sleep(sleepTime); // the stream plays at its frame rate, as for the subscribers
+                        }
+                    }else{
+                        ++nr;
+                    }
+                    socket_watchdog->send(msg_watchdog,ZMQ_NOBLOCK);
+                    continue;
+                }
+                if(!filestream && nr % 1000 == 0){
+                    cycle_time.sync(context); // follow the drift of the clocks
+                }
+                trace->set_cycle_offset_us(cycle_time.update(image.timeStamp, trace->grab_us()));
+                if(scale > 1){
+                    header_extension.set_scale(scale);
+                }else{
+                    header_extension.clear_scale();
+                }
+
                 /* Create and fill protobuf message */
                 message.set_name("windows");
 			    message.set_camera("ladybug5");
@@ -288,14 +494,13 @@ _RESTART:
 
                 for( unsigned int uiCamera = 0; uiCamera < LADYBUG_NUM_CAMERAS; uiCamera++ )
 		        {
+                    if(!(wanted & (1 << uiCamera))) continue; // shed or not subscribed
 			        ladybug5_network::pbImage* image_msg = 0;
 			        image_msg = message.add_images();
 			        image_msg->set_type((ladybug5_network::ImageType) ( 1 << uiCamera));
 			        image_msg->set_name(enumToString(image_msg->type()));
 			        image_msg->set_height(uiRawRows);
                     image_msg->set_width(uiRawCols);
-                    image_msg->set_allocated_distortion(new ladybug5_network::pbDisortion(disortion[uiCamera]));
-                    image_msg->set_allocated_position(new ladybug5_network::pbPosition(position[uiCamera]));
                     image_msg->set_packages(1);
 
                     if( !cfg_postprocessing && !cfg_panoramic){
@@ -317,8 +522,8 @@ _RESTART:
 					}
                 }
 
-                /* Add panoramic image to pb message */
-                if(cfg_panoramic){  
+                /* Add panoramic image to pb message, only rendered if a profile wants it */
+                if(panoramic){  
                     ladybug5_network::pbImage* image_msg = 0;
 			        image_msg = message.add_images();
                     image_msg->set_type(ladybug5_network::LADYBUG_PANORAMIC);
@@ -331,62 +536,96 @@ _RESTART:
 					}
                 }
 
-                pb_send(socket, &message, ZMQ_SNDMORE);
+                trace_stage(trace, ladybug5_network::TRACE_HEADER);
 
-                if(cfg_postprocessing || cfg_panoramic)
+                if(processing)
                 {
 			        status = "Convert images to 6 BGRU buffers";
 			        // Convert the image to 6 BGRU buffers
+                    Span convert_span("convert");
 			        error = ladybugConvertImage(context, &image, arpBuffers);
 			        _HANDLE_ERROR
+                    convert_span.end();
+                    trace_stage(trace, ladybug5_network::TRACE_CONVERT);
 			        _TIME
                     
-                    int flag = ZMQ_SNDMORE;
-				    status = "Adding images with processing";
-				    for( unsigned int uiCamera = 0; uiCamera < LADYBUG_NUM_CAMERAS; uiCamera++ )
-				    {
-					    zmq::message_t raw_image(arpBufferSize);
-                        memcpy(raw_image.data(), arpBuffers[uiCamera], arpBufferSize);
-                           
-                        if( !cfg_panoramic && uiCamera == LADYBUG_NUM_CAMERAS-1 ){
-                            flag = 0;
-                        }
-                        socket->send(raw_image, flag ); // send BGRU images
-				    }
-				    _TIME
+                    /* the header goes first but carries the trace of convert and render, the images wait for it */
+                    unsigned int nr_images = LADYBUG_NUM_CAMERAS; // converted in place, raw_images are the planes
 
-                    if(cfg_panoramic){
+                    if(panoramic){
                      
 				        status = "Send RGB buffers to graphics card";
 				        // Send the RGB buffers to the graphics card
+                        Span textures_span("ladybugUpdateTextures");
 				        error = ladybugUpdateTextures(context, LADYBUG_NUM_CAMERAS, NULL);
 				        _HANDLE_ERROR
+                        textures_span.end();
 				        _TIME
 
 				        status = "create panorame in graphics card";
 				        // Stitch the images (inside the graphics card) and retrieve the output to the user's memory
 				        LadybugProcessedImage processedImage;
+                        Span render_span("render");
 				        error = ladybugRenderOffScreenImage(context, LADYBUG_PANORAMIC, LADYBUG_BGR, &processedImage);
 				        _HANDLE_ERROR
+                        render_span.end();
+                        trace_stage(trace, ladybug5_network::TRACE_RENDER);
 				        _TIME
 			
 				        status = "Add image to message"; 
                         unsigned int size = processedImage.uiCols*processedImage.uiRows*3;
-                        zmq::message_t raw_image(size);
-                        memcpy(raw_image.data(), processedImage.pData, size);                    
-                        socket->send(raw_image, 0 ); // panoramic is the last image
+                        MemoryBudget::instance().message(&raw_images[nr_images], size);
+                        memcpy(raw_images[nr_images].data(), processedImage.pData, size); // panoramic is the last image
+                        ++nr_images;
                         _TIME
 			        }
 			        status = "send img over network";
-                    
+                    Span send_span("send");
+                    trace_stage(trace, ladybug5_network::TRACE_ENQUEUE);
+                    std::vector<zmq::message_t*> parts; // in the order of the header images
+                    for(unsigned int i = 0; i < nr_images; ++i){
+                        if(i < LADYBUG_NUM_CAMERAS && !(wanted & (1 << i))) continue; // the plane goes back with the frame
+                        parts.push_back(&raw_images[i]);
+                    }
+                    if(use_profiles && latest_only != NULL){
+                        Parts frame; // replaces a frame the compressionThreads did not take yet
+                        frame.push_back(new zmq::message_t());
+                        pb_serialize(frame.back(), &message, &header_extension);
+                        for(size_t i = 0; i < parts.size(); ++i){
+                            frame.push_back(new zmq::message_t());
+                            frame.back()->move(parts[i]);
+                        }
+                        latest_only->uncompressed->put(0, frame, message.id());
+                    }else{
+                        pb_send(socket, &message, &header_extension, ZMQ_SNDMORE);
+                        for(size_t i = 0; i < parts.size(); ++i){
+                            if(!use_profiles){
+                                Metrics::instance().count(bytes_sent, parts[i]->size());
+                            }
+                            socket->send(*parts[i], i == parts.size()-1 ? 0 : ZMQ_SNDMORE ); // send BGRU images
+                        }
+                    }
+                    if(!use_profiles){
+                        Metrics::instance().count(frames_sent); // the sendingThread counts the compressed frames
+                        Metrics::instance().count(frames_delivered);
+                        Metrics::instance().record(frame_latency, monotonic_us() - trace->grab_us());
+                    }
                     _TIME
                 }else{ //No post processing, no panoramic picture
+                    Span send_span("send");
+                    trace_stage(trace, ladybug5_network::TRACE_ENQUEUE);
+                    pb_send(socket, &message, &header_extension, ZMQ_SNDMORE);
                     
                     status = "send image " + std::to_string(nr);
                     int flag = ZMQ_SNDMORE;
+                    unsigned int last_camera = 0;
+                    for( unsigned int uiCamera = 0; uiCamera < LADYBUG_NUM_CAMERAS; uiCamera++ ){
+                        if(wanted & (1 << uiCamera)) last_camera = uiCamera;
+                    }
 
                     for( unsigned int uiCamera = 0; uiCamera < LADYBUG_NUM_CAMERAS; uiCamera++ )
                     {
+                        if(!(wanted & (1 << uiCamera))) continue; // shed camera
                         unsigned int index = uiCamera*4;
                         //send images 
                      
@@ -399,24 +638,28 @@ _RESTART:
                         extractImageToMsg(&image, index+green_offset,   &g_data, g_size);
                         extractImageToMsg(&image, index+red_offset,     &r_data, r_size);
                             
-                        if( uiCamera == LADYBUG_NUM_CAMERAS-1 ){
+                        if( uiCamera == last_camera ){
                             flag = 0;
                         }
 
                         if(separatedColors){
 
                             //RGB expected at reciever
-                            zmq::message_t R(r_size);
+                            zmq::message_t R;
+                            MemoryBudget::instance().message(&R, r_size);
                             memcpy(R.data(), r_data, r_size);
                             socket->send(R, ZMQ_SNDMORE ); // Red = Index + 3
 
-                            zmq::message_t G(g_size);
+                            zmq::message_t G;
+                            MemoryBudget::instance().message(&G, g_size);
                             memcpy(G.data(), g_data, g_size);
                             socket->send(G, ZMQ_SNDMORE ); // Green = Index + 1 || 2
 
-                            zmq::message_t B(b_size);     // Blue = Index 0
+                            zmq::message_t B;
+                            MemoryBudget::instance().message(&B, b_size);     // Blue = Index 0
                             memcpy(B.data(), b_data, b_size);
                             socket->send(B, flag );
+                            Metrics::instance().count(bytes_sent, r_size + g_size + b_size);
 
                         }else{ /* RGGB RAW */
                             assert(r_size == g_size);
@@ -429,7 +672,11 @@ _RESTART:
                             throw new std::exception("RGB8 uncompressed not supported");
                         }          
                     }
+                    Metrics::instance().count(frames_sent);
+                    Metrics::instance().count(frames_delivered);
+                    Metrics::instance().record(frame_latency, monotonic_us() - trace->grab_us());
                 }
+                first_frame.sent();
                 message.Clear();
                 msg_timestamp.Clear();
                 ++nr;
@@ -449,6 +696,24 @@ _RESTART:
 
                 _TIME
                 socket_watchdog->send(msg_watchdog,ZMQ_NOBLOCK); // Loop done
+		    }
+		    catch(zmq::error_t& e){
+                /* the output socket failed, the camera is fine. The inproc queue to the compressionThreads can not be rebuilt alone */
+			    printf("Socket error %s, reconnecting\n", e.what());
+                if(socket_type != ZMQ_XPUB){
+                    goto _EXIT;
+                }
+                recovery.begin(RECOVER_SOCKET);
+                unmonitor_socket(socket);
+                socket->close();
+                delete socket;
+                socket = NULL;
+                try{
+                    open_socket();
+                }catch(zmq::error_t& e){
+                    printf("Reconnect failed: %s\n", e.what());
+                    goto _EXIT; // the next attempt after the rebuild
+                }
 		    }
 		    catch(std::exception e){
 			    printf("Exception, trying to recover\n");
@@ -462,6 +727,7 @@ _EXIT:
 	//
 	// clean up
 	//
+    Spans::instance().dump(); // the spans up to the failure
 	ladybugStop( context );
 	ladybugDestroyContext( &context );
     if(filestream)
@@ -469,27 +735,33 @@ _EXIT:
         ladybugDestroyStreamContext (&streamContext);
     }
 
-	google::protobuf::ShutdownProtobufLibrary();
-    if(socket != NULL){
-        socket->close();
-        delete socket;
-    }
-	
-	for( int uiCamera = 0; uiCamera < LADYBUG_NUM_CAMERAS; uiCamera++ ){
-		if ( arpBuffers[ uiCamera ] != NULL )
-		{
-			delete  [] arpBuffers[ uiCamera ];
-		}
-	}
     if(done){
-       Sleep(5000);
-       threads.interrupt_all();
-       Sleep(2000);
-       return 1;
+	    google::protobuf::ShutdownProtobufLibrary();
+        if(socket != NULL){
+            unmonitor_socket(socket);
+            socket->close();
+            delete socket;
+        }
+        if(calibration != NULL){
+            delete calibration;
+        }
+        if(sensors != NULL){
+            delete sensors;
+        }
+        CompressionPool::instance().stop();
+        Sleep(5000);
+        threads.interrupt_all();
+        Sleep(2000);
+        return 1;
+    }
+
+    /* Rebuild only the context: the threads, the sockets and the frame buffers stay, the alpha masks come from disk */
+    watchdog_starting(socket_watchdog);
+    recovery.begin(RECOVER_CONTEXT);
+    unsigned int backoff = recovery.backoff_ms();
+    if(backoff > 0){
+        printf("\nWaiting %u ms...\n", backoff);
+        Sleep(backoff);
     }
-    printf("\nWating 5 sec...\n");
-    Sleep(5000);
-    threads.interrupt_all();
-    
 	goto _RESTART;
 }
\ No newline at end of file
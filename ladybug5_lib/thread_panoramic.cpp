@@ -1,22 +1,39 @@
 #include "thread_functions.h"
 #include "timing.h"
 
-int thread_panoramic(zmq::context_t* zmq_context)
+int thread_panoramic(zmq::context_t* zmq_context, Standby* standby)
 {
-_RESTART:
-    boost::thread_group threads;
+    Subscriptions subscribers;
+    bool paused = false;
+    Metrics::instance().start_reporting(cfg_metrics_interval);
+    Recovery recovery(cfg_grab_retries, cfg_max_backoff);
+    unsigned int frames_grabbed = Metrics::instance().counter("frames.grabbed");
+    unsigned int frames_skipped = Metrics::instance().counter("frames.skipped");
+    unsigned int frames_sent = Metrics::instance().counter("frames.sent");
+    unsigned int frames_paused = Metrics::instance().counter("frames.paused");
+    unsigned int frames_delivered = Metrics::instance().counter("frames.delivered");
+    unsigned int frame_latency = Metrics::instance().stage(HEALTH_LATENCY_STAGE);
+    /* Kept when the context is rebuilt */
     zmq::socket_t* socket = NULL;
     zmq::socket_t* socket_watchdog = NULL;
-	double t_now = clock();	
+    FirstFrameClock first_frame;
+_RESTART:
+    first_frame.start(socket_watchdog != NULL);
+    boost::thread_group threads;
+	double t_now = monotonic_us();	
 	unsigned int uiRawCols = 0;
 	unsigned int uiRawRows = 0;
     LadybugError error;
     LadybugImage image;
     LadybugContext context;
+    LadybugContext convert_context; /* the context of the convert stage, a second one for filestreams */
+    RenderBackend* backend = NULL;
+    RenderPipeline* pipeline = NULL;
     std::string status;
 	
 
 	bool filestream = cfg_fileStream.size() > 0;
+    bool mock = cfg_render_backend == "mock"; // no graphics card needed
     bool done = false;
  
     bool separatedColors = false;
@@ -27,12 +44,28 @@ _RESTART:
     //create watchdog
     //-----------------------------------------------
     int val_watchdog = 1;
-    socket_watchdog = new zmq::socket_t(*zmq_context, ZMQ_PUSH);
-	socket_watchdog->setsockopt(ZMQ_RCVHWM, &val_watchdog, sizeof(val_watchdog));  //prevent buffer get overfilled
-	socket_watchdog->setsockopt(ZMQ_SNDHWM, &val_watchdog, sizeof(val_watchdog));
-    socket_watchdog->connect("inproc://watchdog");
+    if(socket_watchdog == NULL){
+        socket_watchdog = new zmq::socket_t(*zmq_context, ZMQ_PUSH);
+	    socket_watchdog->setsockopt(ZMQ_RCVHWM, &val_watchdog, sizeof(val_watchdog));  //prevent buffer get overfilled
+	    socket_watchdog->setsockopt(ZMQ_SNDHWM, &val_watchdog, sizeof(val_watchdog));
+        socket_watchdog->connect(WATCHDOG_ENDPOINT);
+    }
     zmq::message_t msg_watchdog;
-    socket_watchdog->send(msg_watchdog);
+    watchdog_starting(socket_watchdog); // no heartbeats while the camera starts
+
+    //-----------------------------------------------
+    // output, it does not need the camera: a standby has it ready before the promotion
+    //-----------------------------------------------
+    std::string connection = cfg_ros_master.c_str();
+    bool zmq_bind = false;
+    status = "connect with zmq to " + connection;
+
+    int val = 6; //buffer size
+    if(socket == NULL){ // the first time and after a failure of the socket
+        subscribers.clear();
+        socket = create_xpub(zmq_context, connection, val, zmq_bind);
+    }
+    _TIME
 
     //-----------------------------------------------
     // only for filestream mode
@@ -51,8 +84,20 @@ _RESTART:
 
 	// create ladybug context
 	error = ladybugCreateContext( &context );
+	convert_context = context;
 	_HANDLE_ERROR
 	_TIME
+    if(standby != NULL){ // everything up to here is warm, the active instance still has the camera
+        unsigned int last_cols, last_rows;
+        if(!mock){
+            prepareAlphaMasksCached(cfg_processing_cache, cfg_ladybug_colorProcessing, cfg_pano_width, cfg_pano_hight, &last_cols, &last_rows);
+        }
+        standby->wait();
+        delete standby;
+        standby = NULL;
+        first_frame.takeover();
+        t_now = monotonic_us();
+    }
 	status = "Initialize the camera";
 
     if( !filestream ){ // filestream is empty start live cam
@@ -102,19 +147,22 @@ _RESTART:
         //
         error = ladybugLoadConfig( context, stream_configfile.c_str() );
         _HANDLE_ERROR
-      }
 
-	
-	LadybugImageRenderingInfo graphics_info;
-
-	ladybugGetImageRenderingInfo  ( context, &graphics_info); 
-	printf("Graphic info: %s\nRenderbuffer size: %i maxTextureSize %i\nMax viewport: width %i height %i\nmemory size %i\n", graphics_info.pszAdapterString, 
-		graphics_info.uiMaxRenderbufferSize, graphics_info.uiMaxTextureSize, graphics_info.uiMaxViewPortWidth, graphics_info.uiMaxViewPortWidth,graphics_info.uiMemorySize);
-
-	status = "configure for panoramic stitching";
-	error = configureLadybugForPanoramic(context);
-	_HANDLE_ERROR
-	_TIME
+        /*
+        * The convert stage gets its own context with the same calibration, it
+        * converts the next frame while the render stage uses context.
+        * A live camera has only the grabbing context, there the stages take turns.
+        */
+        if(!mock && cfg_pipeline_depth > 1){
+            status = "create the context of the convert stage";
+            error = ladybugCreateContext( &convert_context );
+            _HANDLE_ERROR
+            error = ladybugLoadConfig( convert_context, stream_configfile.c_str() );
+            _HANDLE_ERROR
+            error = ladybugSetColorProcessingMethod( convert_context, cfg_ladybug_colorProcessing );
+            _HANDLE_ERROR
+        }
+      }
 
     separatedColors = isColorSeparated(&image);
 	if(separatedColors || !cfg_transfer_compressed){
@@ -136,33 +184,33 @@ _RESTART:
     // Initialize alpha mask size - this can take a long time if the
 	// masks are not present in the current directory.
 	status = "Initializing alpha masks (this may take some time)...";
-	error = ladybugInitializeAlphaMasks( context, uiRawCols, uiRawRows );
-	_HANDLE_ERROR
-
+    if(!mock){
+        unsigned int serial = filestream ? streamHeadInfo.serialBase : 0;
+        LadybugCameraInfo cache_info;
+        if(!filestream && ladybugGetCameraInfo(context, &cache_info) == LADYBUG_OK){
+            serial = cache_info.serialBase;
+        }
+	    error = initializeAlphaMasksCached( context, cfg_processing_cache, serial, uiRawCols, uiRawRows, cfg_ladybug_colorProcessing, cfg_pano_width, cfg_pano_hight );
+	    _HANDLE_ERROR
+    }
 	_TIME
 
-    { 
-        std::string connection;
-		int socket_type = ZMQ_PUB;
-        bool zmq_bind = false;
-
-       
-       connection = cfg_ros_master.c_str();
-        status = "connect with zmq to " + connection;
-
-	    socket = new zmq::socket_t(*zmq_context, socket_type);
-	    int val = 6; //buffer size
-	    socket->setsockopt(ZMQ_RCVHWM, &val, sizeof(val));  //prevent buffer get overfilled
-	    socket->setsockopt(ZMQ_SNDHWM, &val, sizeof(val));  //prevent buffer get overfilled
-        
-        if(zmq_bind){
-            socket->bind(connection.c_str());
-        }else{
-            socket->connect(connection.c_str());
-        }
-	    _TIME
+    if(mock){
+        backend = new MockRenderBackend(cfg_pano_width, cfg_pano_hight, uiRawCols * uiRawRows * 4);
+    }else{
+        backend = new LadybugRenderBackend(context, convert_context);
+    }
+    status = "configure for panoramic stitching";
+    pipeline = new RenderPipeline(backend, uiRawCols * uiRawRows * 4, cfg_pipeline_depth, cfg_transfer_compressed); // configures on the render thread
+    error = pipeline->started();
+    _HANDLE_ERROR
+    _TIME
 
+    { 
 	    ladybug5_network::pbMessage message;
+        ladybug5_network::pbMessage finished_message;
+        zmq::message_t finished_pano;
+        std::deque<unsigned long long> grab_times; // of the frames in the pipeline, it finishes them in order
         ladybug5_network::LadybugTimeStamp msg_timestamp;
 
         ladybug5_network::pbFloatTriblet gyro;
@@ -207,29 +255,94 @@ _RESTART:
         }
 
         unsigned int nr = 0;
-        double loopstart = t_now = clock();		
+        double loopstart = t_now = monotonic_us();		
        
         printf("Running...\n");
 
 	    while(!done)
 	    {
 		    try{
-			    loopstart = t_now = clock();
+			    loopstart = t_now = monotonic_us();
 			    t_now = loopstart;
 
 
 			    // Grab an image from the camera
 			    std::string status = "grab image";
 
+                /* Send what the pipeline finished meanwhile */
+                while(pipeline->finished(&finished_message, &finished_pano, &error, 0)){
+                    unsigned long long grab_us = grab_times.front();
+                    grab_times.pop_front();
+                    status = "render panoramic image";
+                    _HANDLE_ERROR
+                    pb_send(socket, &finished_message, ZMQ_SNDMORE);
+                    socket->send(finished_pano, 0); // panoramic is the last image
+                    Metrics::instance().count(frames_sent);
+                    Metrics::instance().count(frames_delivered);
+                    Metrics::instance().record(frame_latency, monotonic_us() - grab_us);
+                    first_frame.sent();
+                }
+
+                /* Without subscribers the images are only grabbed to keep the camera running, no stitching */
+                subscribers.update(socket);
+                if(paused != !subscribers.has_subscribers()){
+                    paused = !paused;
+                    printf(paused ? "No subscribers, pausing...\n" : "Subscriber connected, resuming...\n");
+                }
+                if(paused && filestream){
+                    Metrics::instance().count(frames_skipped);
+                    Metrics::instance().count(frames_paused);
+                    Sleep(sleepTime);
+                    socket_watchdog->send(msg_watchdog,ZMQ_NOBLOCK);
+                    continue;
+                }
+
 			    /* Get ladybugImage */
                 if( filestream ){
                     error = ladybugReadImageFromStream( streamContext, &image);
                 }else{
                     error = ladybugGrabImage(context, &image); 
                 }
-			    _HANDLE_ERROR
+                if(error != LADYBUG_OK){
+                    printf("Error! While %s. Ladybug library reported %s\n", status.c_str(), ::ladybugErrorToString(error));
+                    RecoveryTier tier = filestream ? RECOVER_CONTEXT : recovery.escalate(error);
+                    if(tier == RECOVER_RETRY){
+                        recovery.begin(RECOVER_RETRY);
+                        socket_watchdog->send(msg_watchdog,ZMQ_NOBLOCK);
+                        continue;
+                    }
+                    if(tier == RECOVER_CAMERA){
+                        recovery.begin(RECOVER_CAMERA);
+                        status = "restart the camera";
+                        watchdog_starting(socket_watchdog);
+                        /* the render thread must be done with the context, a context is used by one thread at a time */
+                        pipeline->drain();
+                        grab_times.clear();
+                        unsigned int backoff = recovery.backoff_ms();
+                        if(backoff > 0){
+                            printf("Waiting %u ms...\n", backoff);
+                            Sleep(backoff);
+                        }
+                        error = restartLadybug(context);
+                        if(error == LADYBUG_OK){
+                            socket_watchdog->send(msg_watchdog,ZMQ_NOBLOCK);
+                            continue;
+                        }
+                    }
+                    goto _EXIT; // rebuild the context
+                }
+                recovery.recovered();
+                unsigned long long grab_us = monotonic_us();
+                Metrics::instance().count(frames_grabbed);
 			    _TIME
 
+                if(paused){
+                    Metrics::instance().count(frames_skipped);
+                    Metrics::instance().count(frames_paused);
+                    socket_watchdog->send(msg_watchdog,ZMQ_NOBLOCK);
+                    continue;
+                }
+
                 /* Create and fill protobuf message */
 				prefill_sensordata(message, image);
 
@@ -255,66 +368,29 @@ _RESTART:
 				//image_msg->set_depth(getDataBitDepth(&image));
 
 
-                pb_send(socket, &message, ZMQ_SNDMORE);
+                /*
+                * Convert this frame while the previous ones are rendered and encoded.
+                * With every slot in flight the oldest frame is waited for and sent first.
+                */
+                while(pipeline->finished(&finished_message, &finished_pano, &error, pipeline->full() ? -1 : 0)){
+                    unsigned long long grab_us = grab_times.front();
+                    grab_times.pop_front();
+                    status = "render panoramic image";
+                    _HANDLE_ERROR
+                    pb_send(socket, &finished_message, ZMQ_SNDMORE);
+                    socket->send(finished_pano, 0); // panoramic is the last image
+                    Metrics::instance().count(frames_sent);
+                    Metrics::instance().count(frames_delivered);
+                    Metrics::instance().record(frame_latency, monotonic_us() - grab_us);
+                    first_frame.sent();
+                }
 
-               
 			    status = "Convert images to 6 BGRU buffers";
-			    // Convert the image to 6 BGRU buffers
-			    error = ladybugConvertImage(context, &image, NULL);
+                error = pipeline->submit(&image, message);
 			    _HANDLE_ERROR
-			    _TIME
-                    
-                int flag = ZMQ_SNDMORE;
-				
-                     
-				status = "Send RGB buffers to graphics card";
-				// Send the RGB buffers to the graphics card
-				error = ladybugUpdateTextures(context, LADYBUG_NUM_CAMERAS, NULL);
-				_HANDLE_ERROR
-				_TIME
-
-				status = "create panorame in graphics card";
-				// Stitch the images (inside the graphics card) and retrieve the output to the user's memory
-				LadybugProcessedImage processedImage;
-				error = ladybugRenderOffScreenImage(context, LADYBUG_PANORAMIC, LADYBUG_BGR, &processedImage);
-				_HANDLE_ERROR
-				_TIME
-			
-				status = "Add panoramic image to message"; 
-				unsigned char* image_data = 0;
-				unsigned long  image_size = 0;
-				
-				if(cfg_transfer_compressed){
-					//encode to jpg
-					tjhandle _jpegCompressor = tjInitCompress();
-					tjCompress2(_jpegCompressor, 
-						processedImage.pData, 
-						processedImage.uiCols, 
-						0, 
-						processedImage.uiRows, 
-						TJPF_BGR,
-						&image_data, 
-						&image_size, 
-						TJSAMP_420, 
-						99,
-						TJFLAG_FASTDCT);
-					tjDestroy(_jpegCompressor);	
-
-					zmq::message_t raw_image(image_size);
-					memcpy(raw_image.data(), image_data, image_size);
-					socket->send(raw_image, 0 ); // panoramic is the last image
-
-					tjFree(image_data);
-				}else{
-					image_data = processedImage.pData;
-					image_size = processedImage.uiCols*processedImage.uiRows*3;
-					zmq::message_t raw_image(image_size);
-					memcpy(raw_image.data(), image_data, image_size);
-					socket->send(raw_image, 0 ); // panoramic is the last image
-				}
-			   
+                grab_times.push_back(grab_us);
                 _TIME
-                
+
                 message.Clear();
                 msg_timestamp.Clear();
                 ++nr;
@@ -334,6 +410,20 @@ _RESTART:
 
                 _TIME
                 socket_watchdog->send(msg_watchdog,ZMQ_NOBLOCK); // Loop done
+		    }
+		    catch(zmq::error_t& e){
+			    printf("Socket error %s, reconnecting\n", e.what());
+                recovery.begin(RECOVER_SOCKET);
+                socket->close();
+                delete socket;
+                socket = NULL;
+                try{
+                    subscribers.clear();
+	                socket = create_xpub(zmq_context, connection, val, zmq_bind);
+                }catch(zmq::error_t& e){
+                    printf("Reconnect failed: %s\n", e.what());
+                    goto _EXIT; // the next attempt after the rebuild
+                }
 		    }
 		    catch(std::exception e){
 			    printf("Exception, trying to recover\n");
@@ -347,27 +437,40 @@ _EXIT:
 	//
 	// clean up
 	//
+    delete pipeline; // waits for the frame in the render stage
+    pipeline = NULL;
+    delete backend;
+    backend = NULL;
 	ladybugStop( context );
+    if(convert_context != context){
+        ladybugDestroyContext( &convert_context );
+    }
 	ladybugDestroyContext( &context );
     if(filestream)
     {
         ladybugDestroyStreamContext (&streamContext);
     }
 
-	google::protobuf::ShutdownProtobufLibrary();
-    if(socket != NULL){
-        socket->close();
-        delete socket;
-    }
-	
     if(done){
+	   google::protobuf::ShutdownProtobufLibrary();
+       if(socket != NULL){
+           socket->close();
+           delete socket;
+       }
        Sleep(5000);
        threads.interrupt_all();
        Sleep(2000);
        return 1;
     }
-    printf("\nWating 5 sec...\n");
-    Sleep(5000);
+
+    /* Rebuild only the context, the socket stays and the alpha masks come from disk */
+    watchdog_starting(socket_watchdog);
+    recovery.begin(RECOVER_CONTEXT);
+    unsigned int backoff = recovery.backoff_ms();
+    if(backoff > 0){
+        printf("\nWaiting %u ms...\n", backoff);
+        Sleep(backoff);
+    }
     threads.interrupt_all();
     
 	goto _RESTART;
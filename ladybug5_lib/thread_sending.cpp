@@ -1,38 +1,121 @@
 #include "thread_functions.h"
 #include "timing.h"
 
-void sendingThread(zmq::context_t* p_zmqcontext){
+/* Forwards one part of a compressed frame, the header gets the send stage of the trace. Returns the grab time of the header, 0 for the other parts */
+static unsigned long long forward_part(zmq::socket_t* socket_out, zmq::message_t* part, bool header, bool more, unsigned int bytes_sent){
+	unsigned long long grab_us = 0;
+	if(header){
+		ladybug5_network::pbMessageExtension extension; // the downstream lag for the load shedding at the head
+		if(extension.ParseFromArray(part->data(), part->size()) && extension.has_trace() && extension.trace().grab_us() > 0){
+			static const unsigned int frame_latency = Metrics::instance().stage(HEALTH_LATENCY_STAGE);
+			grab_us = extension.trace().grab_us();
+			unsigned long long lag_us = monotonic_us() - grab_us;
+			LoadShedder::instance().report_lag(lag_us);
+			Metrics::instance().record(frame_latency, lag_us);
+		}
+		append_trace_stage(part, ladybug5_network::TRACE_SEND);
+	}else{
+		Metrics::instance().count(bytes_sent, part->size());
+	}
+#ifdef _DEBUG
+	std::cout << "SendingThread: Recieved message with size:" << part->size() << std::endl;
+#endif
+	socket_out->send(*part, more? ZMQ_SNDMORE: 0);
+	return grab_us;
+}
+
+void sendingThread(zmq::context_t* p_zmqcontext, Outputs* outputs, int hwm, Mailboxes* mailboxes){
     std::string status = "Sendin Thread: init";
-    double t_now = clock();	
-	int val = 6; //buffer size
+    double t_now = monotonic_us();
+    unsigned int frames_sent = Metrics::instance().counter("frames.sent");
+    unsigned int bytes_sent = Metrics::instance().counter("bytes.sent");
+    unsigned int frames_delivered = Metrics::instance().counter("frames.delivered");
+    unsigned long long delivered_grab_us = 0; // every profile forwards the grabbed frame, it is delivered once
+    Spans::instance().name_thread("sending");
+	int val = hwm; //buffer size
 
-    printf("%s connecting to %s\n", status.c_str(), cfg_ros_master.c_str());
-	
-	zmq::socket_t socket_in(*p_zmqcontext, ZMQ_PULL);    
+	zmq::socket_t socket_in(*p_zmqcontext, ZMQ_PULL);
 	socket_in.setsockopt(ZMQ_RCVHWM, &val, sizeof(val));  //prevent buffer get overfilled
 	socket_in.setsockopt(ZMQ_SNDHWM, &val, sizeof(val));  //prevent buffer get overfilled
 	socket_in.bind(zmq_compressed);
 
-	zmq::socket_t socket_out(*p_zmqcontext, ZMQ_PUB);
-    socket_out.setsockopt(ZMQ_RCVHWM, &val, sizeof(val));  //prevent buffer get overfilled
-	socket_out.setsockopt(ZMQ_SNDHWM, &val, sizeof(val));  //prevent buffer get overfilled
-	socket_out.connect(cfg_ros_master.c_str());
+	/* one XPUB per output profile to see the subscriptions, the capture thread pauses the processing without subscribers */
+	std::vector<zmq::socket_t*> sockets_out;
+	std::vector<zmq::pollitem_t> items;
+	zmq::pollitem_t item_in = { socket_in, 0, ZMQ_POLLIN, 0 };
+	items.push_back(item_in);
+	for(unsigned int i = 0; i < outputs->size(); ++i){
+		printf("%s profile %s connecting to %s\n", status.c_str(), outputs->profiles[i].name.c_str(), outputs->profiles[i].endpoint.c_str());
+		sockets_out.push_back(create_xpub(p_zmqcontext, outputs->profiles[i].endpoint, val));
+		monitor_socket(p_zmqcontext, sockets_out[i], "output." + outputs->profiles[i].name);
+		zmq::pollitem_t item_out = { *sockets_out[i], 0, ZMQ_POLLIN, 0 };
+		items.push_back(item_out);
+	}
     _TIME
-    
+
     int more;
     size_t more_size = sizeof (more);
-	
+
     while(true){
-        status = "SendingThread: Recived message";
-		zmq::message_t in1;
-        socket_in.recv(&in1);
-        socket_in.getsockopt(ZMQ_RCVMORE, &more, &more_size);
-#ifdef _DEBUG
-        std::cout << "SendingThread: Recieved message with size:" << in1.size() << std::endl;
-#endif
-        _TIME
-        status = "SendingThread: Send message";
-        socket_out.send(in1, more? ZMQ_SNDMORE: 0);  
-        _TIME
+		/* latest only: the subscriptions are checked between the frames of the mailbox */
+		zmq::poll(&items[0], items.size(), mailboxes != NULL ? 0 : -1);
+
+		for(unsigned int i = 0; i < sockets_out.size(); ++i){
+			if(items[i + 1].revents & ZMQ_POLLIN){
+				outputs->subscribers(i)->update(sockets_out[i]);
+			}
+		}
+
+		if(items[0].revents & ZMQ_POLLIN){
+			status = "SendingThread: Recived message";
+			Span send_span("forward");
+			/* first part is the profile index from the compressionThread */
+			zmq::message_t route;
+			socket_in.recv(&route);
+			unsigned int profile = 0;
+			if(route.size() == sizeof(profile)){
+				memcpy(&profile, route.data(), sizeof(profile));
+			}
+			zmq::socket_t* socket_out = sockets_out.at(profile < sockets_out.size() ? profile : 0);
+
+			bool header = true;
+			unsigned long long grab_us = 0;
+			do{
+				zmq::message_t in1;
+				socket_in.recv(&in1);
+				socket_in.getsockopt(ZMQ_RCVMORE, &more, &more_size);
+				unsigned long long part_grab_us = forward_part(socket_out, &in1, header, more != 0, bytes_sent);
+				if(header) grab_us = part_grab_us;
+				header = false;
+			}
+			while(more);
+			Metrics::instance().count(frames_sent);
+			if(grab_us > delivered_grab_us){
+				delivered_grab_us = grab_us;
+				Metrics::instance().count(frames_delivered);
+			}
+			status = "SendingThread: Send message";
+			_TIME
+		}
+
+		Parts frame;
+		unsigned int profile = 0;
+		if(mailboxes != NULL && mailboxes->compressed->take(frame, &profile, 10)){
+			status = "SendingThread: Took frame";
+			Span send_span("forward");
+			zmq::socket_t* socket_out = sockets_out.at(profile < sockets_out.size() ? profile : 0);
+			unsigned long long grab_us = 0;
+			for(size_t part = 0; part < frame.size(); ++part){
+				unsigned long long part_grab_us = forward_part(socket_out, frame[part], part == 0, part + 1 < frame.size(), bytes_sent);
+				if(part == 0) grab_us = part_grab_us;
+			}
+			free_parts(frame);
+			Metrics::instance().count(frames_sent);
+			if(grab_us > delivered_grab_us){
+				delivered_grab_us = grab_us;
+				Metrics::instance().count(frames_delivered);
+			}
+			_TIME
+		}
 	}
-}
\ No newline at end of file
+}
@@ -0,0 +1,34 @@
+#include "thread_functions.h"
+#include "timing.h"
+
+void statsThread(zmq::context_t* p_zmqcontext, std::string connection, unsigned int interval_ms, std::string serial_number){
+    std::string status = "StatsThread: init";
+    Metrics::enabled = true;
+
+    printf("%s publishing to %s every %u ms\n", status.c_str(), connection.c_str(), interval_ms);
+	zmq::socket_t socket(*p_zmqcontext, ZMQ_PUB);
+	int val = 2; //buffer size
+	socket.setsockopt(ZMQ_SNDHWM, &val, sizeof(val));
+	socket.connect(connection.c_str());
+
+	SocketMonitors monitors(p_zmqcontext);
+	MetricsSnapshot last = Metrics::instance().snapshot();
+	ladybug5_network::pbStats stats;
+
+	while(true){
+		boost::this_thread::sleep(boost::posix_time::milliseconds(interval_ms)); // interruption point on restart
+		monitors.update();
+
+		MetricsSnapshot now = Metrics::instance().snapshot();
+		stats.Clear();
+		stats.set_serial_number(serial_number);
+		fill_stats(&stats, now, last);
+		last = now;
+
+		std::string serialized;
+		stats.SerializeToString(&serialized);
+		zmq::message_t msg(serialized.size());
+		memcpy(msg.data(), serialized.c_str(), serialized.size());
+		socket.send(msg, ZMQ_NOBLOCK);
+	}
+}
@@ -1,14 +1,58 @@
 #include "timing.h"
+#include "allocations.h"
+#include <boost/chrono.hpp>
 
-double time_diff(std::string status, double start, std::string name){
-	double t_now = clock();
-#ifndef _DEBUG
-	printf("%f\n", (t_now-start)/CLOCKS_PER_SEC);
-#endif
+double time_diff(unsigned int stage, const std::string& status, double start){
+	double t_now = (double)monotonic_us();
+	unsigned long long allocations = 0, allocated_bytes = 0;
+	if(Allocations::enabled.load(boost::memory_order_relaxed)){
+		Allocations::since_last(allocations, allocated_bytes);
+	}
+	Metrics::instance().record(stage, (unsigned long long)(t_now - start), allocations, allocated_bytes);
 #ifdef _DEBUG
-    printf("%f\t %s\t to pass %s\n", (t_now-start)/CLOCKS_PER_SEC,  name.c_str(), status.c_str());
+    printf("%f\t to pass %s\n", (t_now-start)/1000000.0, status.c_str());
 #endif // !debug
-
-  
 	return t_now;
+}
+
+unsigned long long monotonic_us(){
+	return boost::chrono::duration_cast<boost::chrono::microseconds>(boost::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+
+static const char* first_frame_events[] = { "boot", "restart", "takeover" };
+
+FirstFrameClock::FirstFrameClock(){
+	start_us = monotonic_us();
+	waiting = false;
+	event = AFTER_BOOT;
+	for(unsigned int i = 0; i < EVENTS; ++i){
+		stages[i] = Metrics::instance().stage(std::string("first frame after ") + first_frame_events[i]);
+	}
+}
+
+void
+FirstFrameClock::start(bool restart){
+	start(restart ? AFTER_RESTART : AFTER_BOOT);
+}
+
+void
+FirstFrameClock::takeover(){
+	start(AFTER_TAKEOVER);
+}
+
+void
+FirstFrameClock::start(Event event){
+	start_us = monotonic_us();
+	waiting = true;
+	this->event = event;
+}
+
+void
+FirstFrameClock::sent(){
+	if(!waiting) return;
+	waiting = false;
+	unsigned long long elapsed_us = monotonic_us() - start_us;
+	Metrics::instance().record(stages[event], elapsed_us);
+	printf("First frame %.0f ms after the %s\n", elapsed_us / 1000.0, first_frame_events[event]);
 }
\ No newline at end of file
@@ -0,0 +1,94 @@
+#include "trace.h"
+#include "timing.h"
+#include "allocations.h"
+
+#define CYCLE_WRAP_US 128000000ULL  /* ulCycleSeconds runs 0..127 */
+
+void trace_stage(ladybug5_network::pbTrace* trace, ladybug5_network::TraceStage stage, int image){
+    ladybug5_network::pbTraceStage* entry = trace->add_stages();
+    entry->set_stage(stage);
+    entry->set_time_us(monotonic_us());
+    if(image >= 0){
+        entry->set_image(image);
+    }
+}
+
+void append_trace_stage(zmq::message_t* header, ladybug5_network::TraceStage stage){
+    ladybug5_network::pbMessageExtension extension;
+    trace_stage(extension.mutable_trace(), stage);
+    std::string serialized;
+    extension.SerializeToString(&serialized);
+
+    zmq::message_t appended(header->size() + serialized.size());
+    Allocations::zmq_message(appended.size());
+    memcpy(appended.data(), header->data(), header->size());
+    memcpy((char*)appended.data() + header->size(), serialized.c_str(), serialized.size());
+    header->move(&appended);
+}
+
+CycleTimeMapping::CycleTimeMapping(){
+    reset();
+}
+
+unsigned long long
+CycleTimeMapping::unwrap(const LadybugTimestamp& timestamp){
+    /* 8000 cycles of 125 us per second, 3072 offset ticks per cycle */
+    unsigned long long cycle_us = timestamp.ulCycleSeconds * 1000000ULL
+        + timestamp.ulCycleCount * 125ULL
+        + timestamp.ulCycleOffset * 125ULL / 3072;
+
+    if(last_cycle_us > cycle_us + CYCLE_WRAP_US / 2){
+        wraps += CYCLE_WRAP_US;
+    }
+    else if(cycle_us > last_cycle_us + CYCLE_WRAP_US / 2 && wraps >= CYCLE_WRAP_US){
+        return cycle_us + wraps - CYCLE_WRAP_US; /* older than the last wrap */
+    }
+    last_cycle_us = cycle_us;
+    return cycle_us + wraps;
+}
+
+LadybugError
+CycleTimeMapping::sync(LadybugContext context){
+    LadybugTimestamp timestamp;
+    unsigned long long before = monotonic_us();
+    LadybugError error = ladybugGetCycleTime(context, &timestamp);
+    unsigned long long after = monotonic_us();
+    if(error != LADYBUG_OK){
+        return error;
+    }
+    _offset = (long long)((before + after) / 2) - (long long)unwrap(timestamp);
+    valid = true;
+    synced = true;
+    return error;
+}
+
+long long
+CycleTimeMapping::update(const LadybugTimestamp& timestamp, unsigned long long host_us){
+    unsigned long long cycle_us = unwrap(timestamp);
+    if(synced){
+        return _offset;
+    }
+
+    long long diff = (long long)host_us - (long long)cycle_us;
+    if(!valid || diff < _offset){
+        _offset = diff;
+    }else{
+        _offset += (diff - _offset) / 1000; /* follow the drift between the clocks slowly */
+    }
+    valid = true;
+    return _offset;
+}
+
+long long
+CycleTimeMapping::offset(){
+    return _offset;
+}
+
+void
+CycleTimeMapping::reset(){
+    valid = false;
+    synced = false;
+    _offset = 0;
+    wraps = 0;
+    last_cycle_us = 0;
+}
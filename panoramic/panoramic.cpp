@@ -13,13 +13,10 @@ int main(int argc, char* argv[])
     std::cout << std::endl << "Number of Cores: " << boost::thread::hardware_concurrency() << std::endl;  
     //Sleep(5000);
     zmq::context_t* zmq_context = new zmq::context_t(2);
-    zmq::socket_t* socket_watchdog = NULL;
-    socket_watchdog = new zmq::socket_t(*zmq_context, ZMQ_PULL);
-    int val = 1;
-	socket_watchdog->setsockopt(ZMQ_RCVHWM, &val, sizeof(val));  //prevent buffer get overfilled
-	socket_watchdog->setsockopt(ZMQ_SNDHWM, &val, sizeof(val));
-    socket_watchdog->bind("inproc://watchdog");
-    thread_panoramic(zmq_context);
+    /* The loop runs here, the heartbeats go to the watchdog service from a thread of their own */
+    ProcessWatchdog watchdog(zmq_context, cfg_watchdog_service, cfg_heartbeat_timeout, cfg_health_interval);
+    boost::thread heartbeats(boost::bind(&ProcessWatchdog::run, &watchdog));
+    thread_panoramic(zmq_context, Standby::create(zmq_context, cfg_watchdog_service));
 
 
 	std::printf("<PRESS ANY KEY TO EXIT>");
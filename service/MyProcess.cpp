@@ -6,6 +6,9 @@ using namespace System::ComponentModel;
 
 
 MyProcess::MyProcess(){
+	id_thread = 0;
+	id_process = 0;
+	process = NULL;
 }
 
 MyProcess::MyProcess(std::string executable, std::string arguments)
@@ -32,6 +35,7 @@ MyProcess::MyProcess(std::string executable, std::string arguments)
 	PathRemoveExtension(name);
 	id_thread = 0;
 	id_process = 0;
+	process = NULL;
 
 	printf("Process: %s\npath: %s, args: %s\npath: %s, args: %s.\n", 
 			name, 
@@ -42,6 +46,9 @@ MyProcess::MyProcess(std::string executable, std::string arguments)
 bool 
 MyProcess::is_alive()
 {
+	if(process != NULL){
+		return WaitForSingleObject(process, 0) == WAIT_TIMEOUT;
+	}
 	HANDLE processH = OpenProcess(SYNCHRONIZE, FALSE, id_process);
 	DWORD ret = WaitForSingleObject(processH, 0);
 	CloseHandle(processH);
@@ -84,14 +91,19 @@ MyProcess::is_running()
 }
 
 bool
-MyProcess::start()
+MyProcess::start(std::string standby)
 {
-	printf("Starting process: %s, args: %s.\n", path, args);
+	printf("Starting process: %s, args: %s%s.\n", path, args, standby.empty() ? "" : " as standby");
 
 	PROCESS_INFORMATION pi = {0};
 	STARTUPINFO startup_info = {0};
 
-	if ( !CreateProcess(path, args, 0, FALSE, 0, 0, 0, 0, &startup_info, &pi) )
+	// the child inherits the environment of the service
+	if(!standby.empty()) SetEnvironmentVariable(STANDBY_ENVIRONMENT, standby.c_str());
+	BOOL created = CreateProcess(path, args, 0, FALSE, 0, 0, 0, 0, &startup_info, &pi);
+	if(!standby.empty()) SetEnvironmentVariable(STANDBY_ENVIRONMENT, NULL);
+
+	if ( !created )
 	{
 		printf("CreateProcess failed ( %s ).\n", GetLastError() );
 	
@@ -99,15 +111,46 @@ MyProcess::start()
 	}
 	else
 	{
+		close();
 		id_thread = pi.dwThreadId;
 		id_process = pi.dwProcessId;
-
-		WaitForSingleObject(pi.hProcess, 5 * 1000);
+		process = pi.hProcess; // kept, the watchdog waits on it for the exit
 		
-		CloseHandle(pi.hProcess);
 		CloseHandle(pi.hThread);
 		
-		return is_alive();
+		return true;
+	}
+}
+
+bool
+MyProcess::kill()
+{
+	if(process == NULL) return stop();
+	printf("Killing process: %s\n", path);
+	bool killed = TerminateProcess(process, 1) != 0;
+	WaitForSingleObject(process, 1000); // the handle is signaled when the process is gone
+	close();
+	return killed;
+}
+
+HANDLE
+MyProcess::handle()
+{
+	return process;
+}
+
+DWORD
+MyProcess::id()
+{
+	return id_process;
+}
+
+void
+MyProcess::close()
+{
+	if(process != NULL){
+		CloseHandle(process);
+		process = NULL;
 	}
 }
 
@@ -122,6 +165,15 @@ MyProcess::stop()
 	{
 		printf("\nRequest to terminate process has been sent to %s!\n", file);
 	}
+	if(process != NULL){
+		// returns as soon as it exited. Only this instance, a warm standby runs the same executable
+		if(WaitForSingleObject(process, 1000) == WAIT_TIMEOUT && TerminateProcess(process, 0)){
+			printf("Process terminated!\n");
+			WaitForSingleObject(process, 1000);
+		}
+		close();
+		return true;
+	}
 	Sleep(1000);
 
 	// Get all instances of the process running on the local computer. 
@@ -3,6 +3,7 @@
 #include <WinSock2.h>
 #include <Windows.h>
 #include <Shlwapi.h>
+#include "process_watchdog.h"
 
 class MyProcess
 {
@@ -11,16 +12,25 @@ public:
 	MyProcess(std::string executable, std::string arguments="");
 	~MyProcess();
 
-	bool start();
+	/* standby: the promote endpoint of a warm standby instance (STANDBY_ENVIRONMENT), empty for a normal start */
+	bool start(std::string standby="");
+	/* The started process only, other instances by name if it was not started here */
 	bool stop();
+	/* Terminates the started process at once, for a process that stopped responding */
+	bool kill();
 	bool find();
 	bool is_running();
 	bool is_alive();
+	/* The started process, signaled when it exits. NULL before start */
+	HANDLE handle();
+	DWORD id();
 private:
+	void close();
 	TCHAR* path;
 	TCHAR* name;
 	TCHAR* args;
 	DWORD id_process;
 	DWORD id_thread;
+	HANDLE process;
 };
 
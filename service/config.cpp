@@ -52,6 +52,11 @@ Config::get(std::string key){
 	return pt.get<std::string>(key); 
 }
 
+std::string
+Config::get(std::string key, std::string default_value){
+	return pt.get<std::string>(key, default_value); 
+}
+
 std::string
 Config::get_sub_key(std::string key, std::string sub_key){
 	return key + "." + sub_key;
@@ -69,11 +74,31 @@ Config::create_default(){
 	
 	put("watchdog.socket","tcp://*:28883");
 	put("watchdog.autostart","jpg_raw");	
+	put("watchdog.heartbeat","tcp://*:28884");
+	put("watchdog.heartbeat_timeout","400");
+	put("watchdog.promote","tcp://127.0.0.1:28886");
+	put("watchdog.slo_window","10000");
 
 	put_path("jpg_raw","..\\bin\\grabber_x64_Release.exe");
 	put_path("panoramic","..\\bin\\panoramic_x64_Release.exe");
 	put_path("calibration","..\\bin\\export_distCoeffs_x64_Release.exe");
 	put_path("full_processing","..\\bin\\full_processing_x64_Release.exe");
+	put("jpg_raw.STANDBY","1");
+	put("panoramic.STANDBY","1");
+	put("full_processing.STANDBY","1");
+	put("jpg_raw.MIN_FPS","4");
+	put("panoramic.MIN_FPS","4");
+	put("panoramic.DEGRADE","jpg_raw");
+	put("full_processing.MIN_FPS","4");
+	put("full_processing.DEGRADE","jpg_raw");
+
+	put_path("fake_process","..\\bin\\fake_process_x64_Release.exe");
+	put_args("fake_process","..\\fake_process\\scenarios\\slow.ini");
+	put("fake_process.STANDBY","1");
+	put("fake_process.MIN_FPS","5");
+	put("fake_process.MAX_P99_MS","100");
+	put("fake_process.MAX_RSS_MB","512");
+	put("fake_process.MAX_DROP_RATE","0.1");
 
 	put_path("debug_jpg_raw","..\\bin\\grabber_x64_Debug.exe");
 	put_path("debug_panoramic","..\\bin\\panoramic_x64_Debug.exe");
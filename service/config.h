@@ -19,6 +19,8 @@ public:
 	std::string get_path(std::string key);
 	std::string get_args(std::string key);
 	std::string get(std::string key);
+	/* default_value if the key is missing, e.g. in an older ini file */
+	std::string get(std::string key, std::string default_value);
 
 	boost::property_tree::ptree pt;
 	std::string config_file;
@@ -0,0 +1,59 @@
+#include "health_check.h"
+#include <sstream>
+
+HealthCheck::HealthCheck()
+{
+	min_fps = 0;
+	max_p99_ms = 0;
+	max_rss_mb = 0;
+	max_drop_rate = 0;
+	window_ms = 10000;
+	violated_since = 0;
+}
+
+void
+HealthCheck::load(Config& config, std::string key){
+	min_fps = atof(config.get(key + ".MIN_FPS", "0").c_str());
+	max_p99_ms = atof(config.get(key + ".MAX_P99_MS", "0").c_str());
+	max_rss_mb = atof(config.get(key + ".MAX_RSS_MB", "0").c_str());
+	max_drop_rate = atof(config.get(key + ".MAX_DROP_RATE", "0").c_str());
+	degrade = config.get(key + ".DEGRADE", "");
+	window_ms = atoi(config.get("watchdog.slo_window", "10000").c_str());
+	reset();
+}
+
+void
+HealthCheck::reset(){
+	violated_since = 0;
+}
+
+bool
+HealthCheck::check(const HealthMessage& health, ULONGLONG now){
+	std::string violated = violation(health);
+	if(violated.empty()){
+		if(violated_since != 0) printf("SLOs met again.\n");
+		violated_since = 0;
+		return false;
+	}
+	if(violated_since == 0){
+		printf("SLO violated: %s\n", violated.c_str());
+		violated_since = now;
+	}
+	return now - violated_since >= window_ms;
+}
+
+std::string
+HealthCheck::violation(const HealthMessage& health){
+	std::stringstream text;
+	double rss_mb = health.rss_bytes / (1024.0 * 1024.0);
+	if(min_fps > 0 && health.fps < min_fps){
+		text << health.fps << " fps, MIN_FPS " << min_fps;
+	}else if(max_p99_ms > 0 && health.p99_latency_us / 1000.0 > max_p99_ms){
+		text << "p99 " << health.p99_latency_us / 1000.0 << " ms, MAX_P99_MS " << max_p99_ms;
+	}else if(max_rss_mb > 0 && rss_mb > max_rss_mb){
+		text << "rss " << rss_mb << " MB, MAX_RSS_MB " << max_rss_mb;
+	}else if(max_drop_rate > 0 && health.drop_rate > max_drop_rate){
+		text << "drop rate " << health.drop_rate << ", MAX_DROP_RATE " << max_drop_rate;
+	}
+	return text.str();
+}
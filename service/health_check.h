@@ -0,0 +1,39 @@
+#pragma once
+#include "stdafx.h"
+#include <Windows.h>
+#include "config.h"
+#include "process_watchdog.h"
+
+/*
+* The SLOs of a program, from its section in watchdog.ini. Every key is
+* optional, a missing one is not checked:
+*   MIN_FPS        grabbed frames delivered (or paused) per second
+*   MAX_P99_MS     p99 grab to send latency
+*   MAX_RSS_MB     resident memory
+*   MAX_DROP_RATE  dropped / grabbed frames, 0..1
+*   DEGRADE        the program of a lighter profile, empty: restart
+* The program fails when its HealthMessages violate one for
+* watchdog.slo_window ms without a break, one good report starts over.
+*/
+class HealthCheck
+{
+public:
+	HealthCheck();
+	void load(Config& config, std::string key);
+	/* A new process, the window starts over */
+	void reset();
+	/* true when the SLOs are violated for the whole window */
+	bool check(const HealthMessage& health, ULONGLONG now);
+	/* The program to switch to on a failure, empty: restart it */
+	std::string degrade;
+private:
+	/* The first violated SLO, empty if all are met */
+	std::string violation(const HealthMessage& health);
+
+	double min_fps;
+	double max_p99_ms;
+	double max_rss_mb;
+	double max_drop_rate;
+	unsigned int window_ms;
+	ULONGLONG violated_since;	/* 0: the SLOs are met */
+};
@@ -5,29 +5,256 @@ Watchdog_service::Watchdog_service(void)
 {
 	key_autostart = "watchdog.autostart";
 	key_ip = "watchdog.socket";
+	key_heartbeat = "watchdog.heartbeat";
+	key_heartbeat_timeout = "watchdog.heartbeat_timeout";
+	key_promote = "watchdog.promote";
+	exit_wait = NULL;
+	standby_wait = NULL;
+	supervised = false;
+	last_heartbeat = 0;
+	last_start = 0;
+	standby_reported = false;
+	standby_subscribed = false;
+	last_standby_start = 0;
+	slo_failed = false;
 
 	config.load("watchdog.ini");
-	std::string key = config.get(key_autostart);
-	std::string path = config.get_path(key);
+	active_key = config.get(key_autostart);
+	active = create_process(active_key);
+	standby = create_process(active_key);
+	health.load(config, active_key);
+
+	zmq_service.init(config.get(key_ip).c_str(), ZMQ_REP);
+
+	heartbeat_timeout = atoi(config.get(key_heartbeat_timeout, "400").c_str());
+	int val = 1;
+	heartbeats = new zmq::socket_t(events_context, ZMQ_PULL);
+	heartbeats->setsockopt(ZMQ_RCVHWM, &val, sizeof(val));
+	heartbeats->bind(config.get(key_heartbeat, "tcp://*:28884").c_str());
+	exits = new zmq::socket_t(events_context, ZMQ_PULL);
+	exits->bind("inproc://process_exit");
+	promote = new zmq::socket_t(events_context, ZMQ_XPUB);
+	promote->bind(config.get(key_promote, DEFAULT_PROMOTE).c_str());
+}
 
+MyProcess
+Watchdog_service::create_process(std::string key){
+	std::string path = config.get_path(key);
 	try{
 		std::string args = config.get_args(key);
-		active = MyProcess(path, args);
+		return MyProcess(path, args);
 	}catch(std::exception e)
 	{
-		active = MyProcess(path);
+		return MyProcess(path);
 	}
-
-	zmq_service.init(config.get(key_ip).c_str(), ZMQ_REP);
 }
 
 void
 Watchdog_service::loop(){
 	while(true)
 	{
-		handle_zmq();
+		zmq::pollitem_t items[] = {
+			{ *zmq_service.socket(), 0, ZMQ_POLLIN, 0 },
+			{ *heartbeats, 0, ZMQ_POLLIN, 0 },
+			{ *exits, 0, ZMQ_POLLIN, 0 },
+			{ *promote, 0, ZMQ_POLLIN, 0 }
+		};
+		zmq::poll(&items[0], 4, poll_timeout());
+		if(items[0].revents & ZMQ_POLLIN) handle_zmq();
+		if(items[1].revents & ZMQ_POLLIN) handle_heartbeats();
+		if(items[2].revents & ZMQ_POLLIN) handle_exits();
+		if(items[3].revents & ZMQ_POLLIN) handle_subscriptions();
 		check_processes();
-		Sleep(2000);
+	}
+}
+
+long
+Watchdog_service::poll_timeout(){
+	ULONGLONG now = GetTickCount64();
+	long timeout = -1;
+	if(supervised){
+		ULONGLONG deadline = last_heartbeat + heartbeat_timeout;
+		timeout = deadline > now ? (long)(deadline - now) : 0;
+	}
+	if(!active.is_alive()){
+		ULONGLONG next_start = last_start + RESTART_INTERVAL; // the start failed or it died right away
+		long wait = next_start > now ? (long)(next_start - now) : 0;
+		if(timeout < 0 || wait < timeout) timeout = wait;
+	}
+	if(standby_enabled() && !standby.is_alive()){
+		ULONGLONG next_start = last_standby_start + RESTART_INTERVAL;
+		long wait = next_start > now ? (long)(next_start - now) : 0;
+		if(timeout < 0 || wait < timeout) timeout = wait;
+	}
+	return timeout;
+}
+
+void
+Watchdog_service::handle_heartbeats(){
+	zmq::message_t msg;
+	while(heartbeats->recv(&msg, ZMQ_NOBLOCK)){
+		if(msg.size() == sizeof(HealthMessage)){
+			HealthMessage report;
+			memcpy(&report, msg.data(), sizeof(report));
+			// only while it runs, the first report covers its start
+			if(report.process_id == active.id() && supervised && health.check(report, GetTickCount64())){
+				slo_failed = true;
+			}
+			continue;
+		}
+		if(msg.size() != sizeof(HeartbeatMessage)) continue;
+		HeartbeatMessage heartbeat;
+		memcpy(&heartbeat, msg.data(), sizeof(heartbeat));
+		if(heartbeat.process_id == standby.id() && heartbeat.state == HEARTBEAT_STANDBY){
+			if(!standby_reported && standby_subscribed) printf("Standby %lu ready.\n", standby.id());
+			standby_reported = true;
+			continue;
+		}
+		if(heartbeat.process_id != active.id()) continue; // from a process that was replaced
+		if(heartbeat.state == HEARTBEAT_STANDBY){
+			send_promote(active.id()); // promoted, the message did not arrive yet. Its deadline runs
+			continue;
+		}
+		supervised = heartbeat.state == HEARTBEAT_RUNNING;
+		last_heartbeat = GetTickCount64();
+	}
+}
+
+void
+Watchdog_service::handle_subscriptions(){
+	zmq::message_t msg;
+	while(promote->recv(&msg, ZMQ_NOBLOCK)){
+		if(msg.size() != 1 + sizeof(DWORD)) continue;
+		const char* data = (const char*)msg.data();
+		DWORD id;
+		memcpy(&id, data + 1, sizeof(id));
+		if(data[0] == 1 && id == standby.id() && id != 0){ // 1: subscribe, 0: unsubscribe
+			if(!standby_subscribed && standby_reported) printf("Standby %lu ready.\n", id);
+			standby_subscribed = true;
+		}
+	}
+}
+
+void
+Watchdog_service::handle_exits(){
+	zmq::message_t msg;
+	while(exits->recv(&msg, ZMQ_NOBLOCK)){} // check_processes sees the exit
+}
+
+VOID CALLBACK
+Watchdog_service::process_exited(PVOID service, BOOLEAN timed_out){
+	/* a thread of the Windows wait pool, the sockets of the loop are not used here */
+	Watchdog_service* watchdog = (Watchdog_service*)service;
+	zmq::socket_t notify(watchdog->events_context, ZMQ_PUSH);
+	notify.connect("inproc://process_exit");
+	zmq::message_t msg;
+	notify.send(msg);
+}
+
+void
+Watchdog_service::watch(MyProcess& process, HANDLE* wait){
+	if(process.handle() == NULL) return;
+	if(!RegisterWaitForSingleObject(wait, process.handle(), process_exited, this, INFINITE, WT_EXECUTEONLYONCE)){
+		printf("Exit notification failed ( %d ), only heartbeats are watched.\n", GetLastError());
+		*wait = NULL;
+	}
+}
+
+void
+Watchdog_service::unwatch(HANDLE* wait){
+	if(*wait != NULL){
+		UnregisterWaitEx(*wait, INVALID_HANDLE_VALUE); // waits for a running callback
+		*wait = NULL;
+	}
+}
+
+void
+Watchdog_service::start_active(){
+	unwatch(&exit_wait);
+	supervised = false;
+	slo_failed = false;
+	health.reset();
+	last_start = GetTickCount64();
+	if(active.start()){
+		watch(active, &exit_wait);
+	}
+}
+
+bool
+Watchdog_service::standby_enabled(){
+	return config.get(active_key + ".STANDBY", "0") == "1";
+}
+
+bool
+Watchdog_service::standby_ready(){
+	return standby_reported && standby_subscribed && standby.is_alive();
+}
+
+void
+Watchdog_service::start_standby(){
+	unwatch(&standby_wait);
+	standby_reported = false;
+	standby_subscribed = false;
+	last_standby_start = GetTickCount64();
+	if(standby.start(config.get(key_promote, DEFAULT_PROMOTE))){
+		watch(standby, &standby_wait);
+	}
+}
+
+void
+Watchdog_service::stop_standby(){
+	unwatch(&standby_wait);
+	if(standby.handle() != NULL) standby.kill();
+	standby = create_process(active_key);
+	standby_reported = false;
+	standby_subscribed = false;
+	last_standby_start = 0;
+}
+
+void
+Watchdog_service::send_promote(DWORD process_id){
+	zmq::message_t msg(sizeof(process_id));
+	memcpy(msg.data(), &process_id, sizeof(process_id)); // the topic the standby subscribed to
+	promote->send(msg, ZMQ_NOBLOCK);
+}
+
+void
+Watchdog_service::promote_standby(){
+	printf("Promoting standby %lu.\n", standby.id());
+	unwatch(&exit_wait);
+	unwatch(&standby_wait);
+	send_promote(standby.id());
+	active = standby;
+	watch(active, &exit_wait);
+
+	/* it acknowledges with HEARTBEAT_STARTING, the deadline runs until then */
+	ULONGLONG now = GetTickCount64();
+	supervised = true;
+	last_heartbeat = now;
+	last_start = now;
+	slo_failed = false;
+	health.reset();
+
+	standby = create_process(active_key);
+	standby_reported = false;
+	standby_subscribed = false;
+	last_standby_start = now; // the next standby starts after the camera was handed over
+}
+
+void
+Watchdog_service::switch_program(std::string key){
+	active_key = key;
+	active = create_process(key);
+	stop_standby(); // of the previous program
+	health.load(config, key);
+}
+
+void
+Watchdog_service::replace_active(){
+	if(standby_ready()){
+		promote_standby();
+	}else{
+		start_active();
 	}
 }
 
@@ -37,7 +264,7 @@ Watchdog_service::handle_zmq(){
 	{
 		ladybug5_network::pb_start_msg pb_msg;
 
-		//Check for new messages
+		//Check for new messages, loop polled the socket
 		if(zmq_service.receive(pb_msg, ZMQ_NOBLOCK) == false) return; // No message to handle if != 0
 		
 		//Got a message to handle
@@ -58,8 +285,34 @@ Watchdog_service::handle_zmq(){
 
 void 
 Watchdog_service::check_processes(){
-
-	if(	!active.is_alive()) active.start();
+	ULONGLONG now = GetTickCount64();
+	if(supervised && now - last_heartbeat > heartbeat_timeout){
+		printf("No heartbeat for %llu ms, replacing the process.\n", now - last_heartbeat);
+		unwatch(&exit_wait);
+		active.kill();
+		replace_active();
+		return;
+	}
+	if(slo_failed){
+		unwatch(&exit_wait);
+		active.kill();
+		if(health.degrade.empty() || health.degrade == active_key){
+			printf("SLOs violated for the window, replacing the process.\n");
+			replace_active();
+		}else{
+			printf("SLOs violated for the window, degrading to %s.\n", health.degrade.c_str());
+			switch_program(health.degrade);
+			start_active();
+		}
+		return;
+	}
+	// a ready standby takes over at once, a fresh start waits for the restart interval
+	if(	!active.is_alive() && (standby_ready() || now - last_start >= RESTART_INTERVAL)){
+		replace_active();
+	}
+	if(standby_enabled() && !standby.is_alive() && now - last_standby_start >= RESTART_INTERVAL){
+		start_standby();
+	}
 
 		//iterate over propperty tree and close all other services...
 		/*boost::property_tree::ptree::const_iterator end = config.pt.end();
@@ -99,8 +352,16 @@ Watchdog_service::handle_message(ladybug5_network::pb_start_msg &message){
 		std::string info_txt = "Started: \""+ message.name() + "\" successfully.";
 		reply_msg.set_info(info_txt);
 
+		//the running program again: its standby takes over
+		bool takeover = message_name == active_key && standby_ready();
+
 		//stop active process
-		active.stop();
+		unwatch(&exit_wait);
+		if(takeover){
+			active.kill(); // the camera is released at once
+		}else{
+			active.stop();
+		}
 
 		//update config to autostart it next time
 		config.put(key_autostart, message_name);
@@ -113,21 +374,29 @@ Watchdog_service::handle_message(ladybug5_network::pb_start_msg &message){
 		}			
 		//activate new process
 		std::string key = config.get(key_autostart);
-
-		try{
-			std::string args = config.get_args(key);
-			active = MyProcess(path, args);
-		}catch(std::exception e)
-		{
-			active = MyProcess(path);
+		if(takeover){
+			promote_standby();
+			health.load(config, active_key); // reloaded with the request
+		}else{
+			switch_program(key);
 		}
 
 		//send back reply
 		zmq_service.send(reply_msg, ZMQ_NOBLOCK);
+		if(!takeover) start_active();
 	}
 }
 
 Watchdog_service::~Watchdog_service(){
 	//stop active process
+	unwatch(&exit_wait);
 	active.stop();
+	unwatch(&standby_wait);
+	if(standby.handle() != NULL) standby.kill();
+	promote->close();
+	delete promote;
+	heartbeats->close();
+	delete heartbeats;
+	exits->close();
+	delete exits;
 }
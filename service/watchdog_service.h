@@ -2,7 +2,30 @@
 #include "zmq_service.h"
 #include "MyProcess.h"
 #include "config.h"
+#include "process_watchdog.h"
+#include "health_check.h"
 
+/* A process that dies within this time after its start is started again after it, not at once */
+#define RESTART_INTERVAL 1000 // ms
+#define DEFAULT_PROMOTE "tcp://127.0.0.1:28886"
+
+/*
+* Keeps the autostart process running. Sleeps in zmq::poll until a
+* request, a heartbeat of the process or its exit arrives: the exit is
+* signaled by Windows (RegisterWaitForSingleObject) on inproc://process_exit.
+* After its first heartbeat the process has to beat every
+* watchdog.heartbeat_timeout ms, else it is killed and started again.
+* HEARTBEAT_STARTING holds the deadline until the next heartbeat.
+* With STANDBY=1 in the section of the program a second instance is
+* started as warm standby: SDK and sockets initialized, the camera left
+* to the active one. It is ready when it reports HEARTBEAT_STANDBY and
+* subscribed to its id on watchdog.promote. A failed active process, or a
+* request for the running program, is replaced by promoting the standby;
+* the fresh start remains the fallback.
+* The health reports of the active process are checked against the SLOs
+* of its program (HealthCheck): a sustained violation replaces it like a
+* missed heartbeat, or switches to its DEGRADE program.
+*/
 class Watchdog_service
 {
 public:
@@ -14,8 +37,54 @@ public:
 private:
 	std::string key_autostart;
 	std::string key_ip;
+	std::string key_heartbeat;
+	std::string key_heartbeat_timeout;
+	std::string key_promote;
 	Config config;
 	MyProcess active;
+	MyProcess standby;
+	std::string active_key;
 	Zmq_service zmq_service;
 	void handle_message(ladybug5_network::pb_start_msg &message);
+
+	MyProcess create_process(std::string key);
+	void start_active();
+	/* The exit of process is signaled on inproc://process_exit */
+	void watch(MyProcess& process, HANDLE* wait);
+	void unwatch(HANDLE* wait);
+
+	bool standby_enabled();
+	bool standby_ready();
+	void start_standby();
+	/* Kills the standby, the next one is of active_key */
+	void stop_standby();
+	void promote_standby();
+	void send_promote(DWORD process_id);
+	/* Promotes the standby if it is ready, else starts the active process */
+	void replace_active();
+	/* Runs key instead of the active program, without saving it as autostart */
+	void switch_program(std::string key);
+	void handle_subscriptions();
+
+	void handle_heartbeats();
+	void handle_exits();
+	/* ms until the next deadline, -1 none */
+	long poll_timeout();
+	static VOID CALLBACK process_exited(PVOID service, BOOLEAN timed_out);
+
+	zmq::context_t events_context;	/* heartbeats and exit notifications */
+	zmq::socket_t* heartbeats;
+	zmq::socket_t* exits;
+	zmq::socket_t* promote;			/* XPUB, the standby subscribes to its process id */
+	HANDLE exit_wait;				/* registered wait on the active process */
+	HANDLE standby_wait;			/* registered wait on the standby */
+	unsigned int heartbeat_timeout;
+	bool supervised;				/* the active process beats, its deadline runs */
+	ULONGLONG last_heartbeat;
+	ULONGLONG last_start;
+	bool standby_reported;			/* HEARTBEAT_STANDBY arrived */
+	bool standby_subscribed;		/* its promote subscription arrived */
+	ULONGLONG last_standby_start;
+	HealthCheck health;
+	bool slo_failed;				/* check_processes replaces the active process */
 };
\ No newline at end of file
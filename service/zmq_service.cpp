@@ -181,6 +181,11 @@ Zmq_service::init(std::string socket, int type)
 	}
 }
 
+zmq::socket_t*
+Zmq_service::socket(){
+	return zmq_socket;
+}
+
 void
 Zmq_service::reset_state(){
 
@@ -34,6 +34,8 @@ public:
 	bool receive(zmq::message_t &msg, int flag = 0);
 
 	void reset_state();
+	/* For zmq::poll together with other sockets */
+	zmq::socket_t* socket();
 
 	~Zmq_service(void);
 private:
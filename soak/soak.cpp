@@ -0,0 +1,249 @@
+// soak.cpp : Runs the full capture pipeline (thread_ladybug_full) on a .pgr
+// stream with local receivers in one process and reports sustained fps,
+// latency, drops, CPU per thread and memory over long runs.
+//
+//   soak_x64_Release.exe scenarios\compressed.ini
+//
+// The scenario is merged over config.ini like the other tools, the outputs
+// must point to a local address (tcp://127.0.0.1:...) because the receivers
+// bind them in place of the ROS node.
+
+#include "timing.h"
+#include "client.h"
+#include <windows.h>
+#include <tlhelp32.h>
+#include <psapi.h>
+#include <map>
+#include <set>
+#include <algorithm>
+#include <boost/property_tree/ini_parser.hpp>
+
+const char* PATH_SOAK_DURATION = "Soak.Duration";
+const char* PATH_SOAK_REPORT = "Soak.Report";
+const char* PATH_SOAK_MAX_RSS_GROWTH = "Soak.MaxRssGrowth";
+
+/* Written by one receiver thread, read by the report */
+struct ReceiverStats{
+    ReceiverStats() : frames(0), bytes(0), drops(0){}
+    std::string endpoint;
+    Histogram latency;
+    boost::atomic<unsigned long long> frames;
+    boost::atomic<unsigned long long> bytes;
+    boost::atomic<unsigned long long> drops;
+};
+
+/* Stands in for the ROS node: binds the output, latency is measured against the grab time in the frame trace */
+void receiverThread(zmq::context_t* zmq_context, ReceiverStats* stats){
+    zmq::socket_t socket(*zmq_context, ZMQ_SUB);
+    socket.setsockopt(ZMQ_SUBSCRIBE, "", 0);
+    socket.bind(stats->endpoint.c_str());
+
+    ladybug5_network::pbMessage header;
+    ladybug5_network::pbMessageExtension extension;
+    bool first = true;
+    unsigned int last_id = 0;
+    int more;
+    size_t more_size = sizeof(more);
+
+    while(true){
+        zmq::message_t msg;
+        socket.recv(&msg);
+        header.ParseFromArray(msg.data(), msg.size());
+        extension.ParseFromArray(msg.data(), msg.size()); // the extension is appended to the header
+        unsigned long long bytes = msg.size();
+        socket.getsockopt(ZMQ_RCVMORE, &more, &more_size);
+        while(more){
+            zmq::message_t part;
+            socket.recv(&part);
+            bytes += part.size();
+            socket.getsockopt(ZMQ_RCVMORE, &more, &more_size);
+        }
+        unsigned long long now = monotonic_us();
+
+        if(extension.has_trace() && extension.trace().grab_us() > 0){
+            stats->latency.record(now - extension.trace().grab_us());
+        }
+        /* ids are consecutive, the stream starts over at the end (RateDivisor must be 1) */
+        if(!first && header.id() > last_id + 1){
+            stats->drops.store(stats->drops.load() + header.id() - last_id - 1);
+        }
+        first = false;
+        last_id = header.id();
+        stats->frames.store(stats->frames.load() + 1);
+        stats->bytes.store(stats->bytes.load() + bytes);
+    }
+}
+
+static unsigned long long filetime_us(const FILETIME& time){
+    ULARGE_INTEGER value;
+    value.LowPart = time.dwLowDateTime;
+    value.HighPart = time.dwHighDateTime;
+    return value.QuadPart / 10;
+}
+
+/* kernel + user time of every thread of this process */
+static void thread_times(std::map<DWORD, unsigned long long>& times){
+    times.clear();
+    HANDLE snapshot = CreateToolhelp32Snapshot(TH32CS_SNAPTHREAD, 0);
+    if(snapshot == INVALID_HANDLE_VALUE) return;
+    THREADENTRY32 entry;
+    entry.dwSize = sizeof(entry);
+    DWORD pid = GetCurrentProcessId();
+    if(Thread32First(snapshot, &entry)){
+        do{
+            if(entry.th32OwnerProcessID != pid) continue;
+            HANDLE thread = OpenThread(THREAD_QUERY_INFORMATION, FALSE, entry.th32ThreadID);
+            if(thread == NULL) continue;
+            FILETIME creation, exit, kernel, user;
+            if(GetThreadTimes(thread, &creation, &exit, &kernel, &user)){
+                times[entry.th32ThreadID] = filetime_us(kernel) + filetime_us(user);
+            }
+            CloseHandle(thread);
+        }while(Thread32Next(snapshot, &entry));
+    }
+    CloseHandle(snapshot);
+}
+
+static double rss_mb(){
+    PROCESS_MEMORY_COUNTERS memory;
+    if(!GetProcessMemoryInfo(GetCurrentProcess(), &memory, sizeof(memory))) return 0;
+    return memory.WorkingSetSize / (1024.0 * 1024.0);
+}
+
+static HistogramSnapshot latency(std::vector<ReceiverStats*>& receivers){
+    HistogramSnapshot snapshot;
+    for(size_t i = 0; i < receivers.size(); ++i){
+        snapshot.add(receivers[i]->latency);
+    }
+    return snapshot;
+}
+
+static void print_line(const char* label, double seconds, unsigned long long frames, unsigned long long drops, unsigned long long bytes, const HistogramSnapshot& h, double rss, double rss_start){
+    printf("%-8s %7.0fs %6.1f fps  latency p50 %6.1f p99 %6.1f p999 %6.1f max %6.1f ms  drops %5.2f%%  %6.1f MB/s  rss %7.1f MB (%+.1f)\n",
+        label, seconds, seconds > 0 ? frames / seconds : 0.0,
+        h.percentile(50) / 1000.0, h.percentile(99) / 1000.0, h.percentile(99.9) / 1000.0, h.max / 1000.0,
+        frames + drops > 0 ? 100.0 * drops / (frames + drops) : 0.0,
+        seconds > 0 ? bytes / seconds / (1024.0 * 1024.0) : 0.0, rss, rss - rss_start);
+}
+
+int main(int argc, char* argv[])
+{
+    SetThreadExecutionState(ES_CONTINUOUS | ES_SYSTEM_REQUIRED | ES_AWAYMODE_REQUIRED);
+    GOOGLE_PROTOBUF_VERIFY_VERSION;
+    initConfig(argc, argv);
+
+    boost::property_tree::ptree pt;
+    try{
+        boost::property_tree::ini_parser::read_ini(argc > 1 ? argv[1] : cfg_configFile.c_str(), pt);
+    }catch(std::exception){
+        printf("No [Soak] settings, using the defaults\n");
+    }
+    unsigned int duration = pt.get<unsigned int>(PATH_SOAK_DURATION, 3600); /* seconds, 0 runs until closed */
+    unsigned int report = pt.get<unsigned int>(PATH_SOAK_REPORT, 10);
+    double max_rss_growth = pt.get<double>(PATH_SOAK_MAX_RSS_GROWTH, 0); /* MB, 0 disables the check */
+    if(report == 0) report = 10;
+
+    if(cfg_fileStream.empty()){
+        printf("Warning: no Input.Filestream, soaking the live camera\n");
+    }
+
+    zmq::context_t* zmq_context = new zmq::context_t(2);
+    zmq::socket_t socket_watchdog(*zmq_context, ZMQ_PULL);
+    int val = 1;
+    socket_watchdog.setsockopt(ZMQ_RCVHWM, &val, sizeof(val));
+    socket_watchdog.bind("inproc://watchdog");
+
+    /* one receiver per output endpoint, ROS_MASTER for the uncompressed path */
+    std::set<std::string> endpoints;
+    endpoints.insert(cfg_ros_master);
+    for(size_t i = 0; i < cfg_output_profiles.size(); ++i){
+        endpoints.insert(cfg_output_profiles[i].endpoint);
+    }
+    std::vector<ReceiverStats*> receivers;
+    boost::thread_group threads;
+    for(std::set<std::string>::iterator it = endpoints.begin(); it != endpoints.end(); ++it){
+        ReceiverStats* stats = new ReceiverStats();
+        stats->endpoint = *it;
+        receivers.push_back(stats);
+        printf("Receiver on %s\n", it->c_str());
+        threads.create_thread(std::bind(receiverThread, zmq_context, stats));
+    }
+    Sleep(500); // bound before the pipeline connects
+    threads.create_thread(std::bind(thread_ladybug_full, zmq_context));
+
+    double rss_start = rss_mb();
+    unsigned long long start = monotonic_us();
+    unsigned long long last = start;
+    unsigned long long last_frames = 0, last_bytes = 0, last_drops = 0;
+    HistogramSnapshot last_latency;
+    std::map<DWORD, unsigned long long> last_times;
+    thread_times(last_times);
+
+    while(duration == 0 || monotonic_us() - start < duration * 1000000ULL){
+        Sleep(report * 1000);
+        zmq::message_t heartbeat;
+        while(socket_watchdog.recv(&heartbeat, ZMQ_NOBLOCK)); // not watched here, only drained
+
+        unsigned long long now = monotonic_us();
+        double seconds = (now - last) / 1000000.0;
+        unsigned long long frames = 0, bytes = 0, drops = 0;
+        for(size_t i = 0; i < receivers.size(); ++i){
+            frames += receivers[i]->frames.load();
+            bytes += receivers[i]->bytes.load();
+            drops += receivers[i]->drops.load();
+        }
+        HistogramSnapshot total = latency(receivers);
+        HistogramSnapshot interval = total;
+        interval.subtract(last_latency);
+
+        char label[32];
+        sprintf(label, "%llus", (now - start) / 1000000);
+        print_line(label, seconds, frames - last_frames, drops - last_drops, bytes - last_bytes, interval, rss_mb(), rss_start);
+
+        /* CPU of the threads that were busy in this interval, busiest first */
+        std::map<DWORD, unsigned long long> times;
+        thread_times(times);
+        std::vector<std::pair<double, DWORD> > busy;
+        for(std::map<DWORD, unsigned long long>::iterator it = times.begin(); it != times.end(); ++it){
+            unsigned long long before = last_times.count(it->first) ? last_times[it->first] : 0;
+            double percent = 100.0 * (it->second - before) / (now - last);
+            if(percent >= 1.0) busy.push_back(std::make_pair(percent, it->first));
+        }
+        std::sort(busy.rbegin(), busy.rend());
+        printf("         cpu");
+        for(size_t i = 0; i < busy.size(); ++i){
+            printf("  %lu:%.0f%%", busy[i].second, busy[i].first);
+        }
+        printf("\n");
+
+        last = now;
+        last_frames = frames;
+        last_bytes = bytes;
+        last_drops = drops;
+        last_latency = total;
+        last_times = times;
+    }
+
+    /* whole run */
+    unsigned long long frames = 0, bytes = 0, drops = 0;
+    for(size_t i = 0; i < receivers.size(); ++i){
+        frames += receivers[i]->frames.load();
+        bytes += receivers[i]->bytes.load();
+        drops += receivers[i]->drops.load();
+    }
+    printf("\n");
+    print_line("total", (monotonic_us() - start) / 1000000.0, frames, drops, bytes, latency(receivers), rss_mb(), rss_start);
+    Metrics::instance().snapshot().print();
+
+    double rss_growth = rss_mb() - rss_start;
+    if(max_rss_growth > 0 && rss_growth > max_rss_growth){
+        printf("FAILED: memory grew by %.1f MB, allowed are %.1f MB\n", rss_growth, max_rss_growth);
+        ExitProcess(1); // the pipeline threads do not stop
+    }
+    if(frames == 0){
+        printf("FAILED: no frames received\n");
+        ExitProcess(1);
+    }
+    printf("PASSED\n");
+    ExitProcess(0);
+}